@@ -1,26 +1,55 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
 #include <fcntl.h>
+#include <sched.h>
+#include <time.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <linux/mempolicy.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
 #include "./b-tree-impl.h"
 
-const uint32_t PAGE_SIZE = 4096;
-const int NODE_ORDER = 3;
+/*
+ * The page size is chosen at build time with -DPAGE_SIZE_KB=<4|8|16|64>
+ */
+#ifndef PAGE_SIZE_KB
+#define PAGE_SIZE_KB 4
+#endif
+_Static_assert(PAGE_SIZE_KB == 4 || PAGE_SIZE_KB == 8 || PAGE_SIZE_KB == 16 || PAGE_SIZE_KB == 64,
+    "PAGE_SIZE_KB must be one of 4, 8, 16 or 64");
+
+const uint32_t PAGE_SIZE = PAGE_SIZE_KB * 1024;
 
 typedef enum PageType {
     INTERNAL_NODE,
-    LEAF_NODE
+    LEAF_NODE,
+    FREE_PAGE,
+    BYTES_INTERNAL_NODE,
+    BYTES_LEAF_NODE,
+    OVERFLOW_PAGE
 } PageType;
 
 const char NODE_INITIALIZED = 'Y';
 
 /*
  * Common Node Header Layout
+ * The parent pointer is no longer maintained, writers find parents on the path of their descent instead
  */
 const uint32_t NODE_TYPE_SIZE = sizeof(uint32_t);
 const uint32_t NODE_TYPE_OFFSET = 0;
@@ -28,30 +57,37 @@ const uint32_t NODE_INITIALIZED_SIZE = sizeof(char);
 const uint32_t NODE_INITIALIZED_OFFSET = NODE_TYPE_SIZE;
 const uint32_t IS_ROOT_SIZE = sizeof(uint32_t);
 const uint32_t IS_ROOT_OFFSET = NODE_TYPE_SIZE + NODE_INITIALIZED_SIZE;
-const uintptr_t PARENT_POINTER_SIZE = sizeof(uintptr_t);
+const uint32_t PARENT_POINTER_SIZE = sizeof(uint32_t);
 const uint32_t PARENT_POINTER_OFFSET = IS_ROOT_OFFSET + IS_ROOT_SIZE;
 const uint16_t FREE_BLOCK_OFFSET_SIZE = sizeof(uint16_t);
 const uint32_t FREE_BLOCK_OFFSET_OFFSET = PARENT_POINTER_OFFSET + PARENT_POINTER_SIZE;
+const uint32_t NODE_LSN_SIZE = sizeof(uint64_t);
+const uint32_t NODE_LSN_OFFSET = FREE_BLOCK_OFFSET_OFFSET + FREE_BLOCK_OFFSET_SIZE;
 const uint32_t COMMON_NODE_HEADER_SIZE =
-    NODE_TYPE_SIZE + NODE_INITIALIZED_SIZE + IS_ROOT_SIZE + PARENT_POINTER_SIZE + FREE_BLOCK_OFFSET_SIZE;
+    NODE_TYPE_SIZE + NODE_INITIALIZED_SIZE + IS_ROOT_SIZE + PARENT_POINTER_SIZE + FREE_BLOCK_OFFSET_SIZE + NODE_LSN_SIZE;
 
 /**
  * @brief Internal Node Header Layout
  */
 const uint32_t INTERNAL_NODE_NUM_KEYS_SIZE = sizeof(uint32_t);
 const uint32_t INTERNAL_NODE_NUM_KEYS_OFFSET = COMMON_NODE_HEADER_SIZE;
-const uintptr_t INTERNAL_NODE_RIGHT_CHILD_POINTER_SIZE = sizeof(uintptr_t);
+const uint32_t INTERNAL_NODE_RIGHT_CHILD_POINTER_SIZE = sizeof(uint32_t);
 const uint32_t INTERNAL_NODE_RIGHT_CHILD_POINTER_OFFSET = INTERNAL_NODE_NUM_KEYS_OFFSET + INTERNAL_NODE_NUM_KEYS_SIZE;
 const uint32_t INTERNAL_NODE_HEADER_SIZE = COMMON_NODE_HEADER_SIZE + INTERNAL_NODE_NUM_KEYS_SIZE + INTERNAL_NODE_RIGHT_CHILD_POINTER_SIZE;
 
 /**
  * Internal Node Body Layout
+ * The keys are kept in one contiguous array so that they can be searched with vector compares, and the
+ * child pointers to the left of each key follow in a second array
  */
-const uintptr_t INTERNAL_NODE_CHILD_POINTER_SIZE = sizeof(uintptr_t);
-const uint32_t INTERNAL_NODE_CHILD_POINTER_OFFSET = 0;
 const uint32_t INTERNAL_NODE_KEY_SIZE = sizeof(uint32_t);
-const uint32_t INTERNAL_NODE_KEY_OFFSET = INTERNAL_NODE_CHILD_POINTER_OFFSET + INTERNAL_NODE_CHILD_POINTER_SIZE;
+const uint32_t INTERNAL_NODE_KEYS_OFFSET = (INTERNAL_NODE_HEADER_SIZE + sizeof(uint32_t) - 1) & ~(sizeof(uint32_t) - 1);
+const uint32_t INTERNAL_NODE_CHILD_POINTER_SIZE = sizeof(uint32_t);
 const uint32_t INTERNAL_NODE_CELL_SIZE = INTERNAL_NODE_CHILD_POINTER_SIZE + INTERNAL_NODE_KEY_SIZE;
+const uint32_t INTERNAL_NODE_MAX_KEYS = (PAGE_SIZE - INTERNAL_NODE_KEYS_OFFSET) / INTERNAL_NODE_CELL_SIZE;
+const uint32_t INTERNAL_NODE_CHILD_POINTERS_OFFSET = INTERNAL_NODE_KEYS_OFFSET + INTERNAL_NODE_MAX_KEYS * INTERNAL_NODE_KEY_SIZE;
+//  Nodes only underflow below a quarter full, so that a node that has just split does not merge again right away
+const uint32_t INTERNAL_NODE_MIN_KEYS = INTERNAL_NODE_MAX_KEYS / 4;
 
 
 /**
@@ -61,17 +97,120 @@ const uint32_t LEAF_NODE_NUM_CELLS_SIZE = sizeof(uint32_t);
 const uint32_t LEAF_NODE_NUM_CELLS_OFFSET = COMMON_NODE_HEADER_SIZE;
 const uint32_t LEAF_NODE_RIGHT_SIBLING_POINTER_SIZE = sizeof(uint32_t);
 const uint32_t LEAF_NODE_RIGHT_SIBLING_POINTER_OFFSET = LEAF_NODE_NUM_CELLS_OFFSET + LEAF_NODE_NUM_CELLS_SIZE;
-const uint32_t LEAF_NODE_HEADER_SIZE = COMMON_NODE_HEADER_SIZE + LEAF_NODE_NUM_CELLS_SIZE + LEAF_NODE_RIGHT_SIBLING_POINTER_SIZE;
+const uint32_t LEAF_NODE_LEFT_SIBLING_POINTER_SIZE = sizeof(uint32_t);
+const uint32_t LEAF_NODE_LEFT_SIBLING_POINTER_OFFSET = LEAF_NODE_RIGHT_SIBLING_POINTER_OFFSET + LEAF_NODE_RIGHT_SIBLING_POINTER_SIZE;
+const uint32_t LEAF_NODE_CELL_CONTENT_START_SIZE = sizeof(uint32_t);
+const uint32_t LEAF_NODE_CELL_CONTENT_START_OFFSET = LEAF_NODE_LEFT_SIBLING_POINTER_OFFSET + LEAF_NODE_LEFT_SIBLING_POINTER_SIZE;
+const uint32_t LEAF_NODE_HEADER_SIZE = COMMON_NODE_HEADER_SIZE + LEAF_NODE_NUM_CELLS_SIZE + LEAF_NODE_RIGHT_SIBLING_POINTER_SIZE +
+    LEAF_NODE_LEFT_SIBLING_POINTER_SIZE + LEAF_NODE_CELL_CONTENT_START_SIZE;
 
 /**
  * Leaf Node Body Layout
+ * The keys are kept in one contiguous array at the front of the page, followed by an array with the in-page
+ * offset of each key's value. Values are allocated from the back of the page towards the arrays, starting at
+ * the cell content start, and deleted values are kept in the free block list until they are reused or the
+ * node is compacted.
  */
 const uint32_t LEAF_NODE_KEY_SIZE = sizeof(uint32_t);
-const uint32_t LEAF_NODE_KEY_OFFSET = LEAF_NODE_HEADER_SIZE;
-const uintptr_t LEAF_NODE_KEY_POINTER_SIZE = sizeof(uintptr_t);
-const uint32_t LEAF_NODE_KEY_POINTER_OFFSET = LEAF_NODE_KEY_OFFSET + LEAF_NODE_KEY_SIZE;
+const uint32_t LEAF_NODE_KEYS_OFFSET = (LEAF_NODE_HEADER_SIZE + sizeof(uint32_t) - 1) & ~(sizeof(uint32_t) - 1);
+const uint32_t LEAF_NODE_VALUE_OFFSET_SIZE = sizeof(uint16_t);
+const uint32_t LEAF_NODE_CELL_SIZE = LEAF_NODE_KEY_SIZE + LEAF_NODE_VALUE_OFFSET_SIZE;
 const uint32_t LEAF_NODE_VALUE_SIZE = sizeof(uint32_t);
-const uint32_t LEAF_NODE_VALUE_OFFSET = PAGE_SIZE - LEAF_NODE_VALUE_SIZE;
+const uint32_t LEAF_NODE_MAX_CELLS = (PAGE_SIZE - LEAF_NODE_KEYS_OFFSET) / (LEAF_NODE_CELL_SIZE + LEAF_NODE_VALUE_SIZE);
+const uint32_t LEAF_NODE_VALUE_OFFSETS_OFFSET = LEAF_NODE_KEYS_OFFSET + LEAF_NODE_MAX_CELLS * LEAF_NODE_KEY_SIZE;
+const uint32_t LEAF_NODE_END_OF_CELLS = LEAF_NODE_VALUE_OFFSETS_OFFSET + LEAF_NODE_MAX_CELLS * LEAF_NODE_VALUE_OFFSET_SIZE;
+const uint32_t LEAF_NODE_MIN_CELLS = LEAF_NODE_MAX_CELLS / 4;
+
+/**
+ * Free Block Layout
+ * Every free block starts with the offset of the next free block and its own size. Free blocks are kept
+ * sorted by offset and an offset of 0 ends the list.
+ */
+const uint32_t FREE_BLOCK_NEXT_OFFSET_SIZE = sizeof(uint16_t);
+const uint32_t FREE_BLOCK_SIZE_SIZE = sizeof(uint16_t);
+const uint32_t FREE_BLOCK_HEADER_SIZE = FREE_BLOCK_NEXT_OFFSET_SIZE + FREE_BLOCK_SIZE_SIZE;
+
+/**
+ * Free Page Layout
+ * A page that no node uses anymore keeps the common node header, followed by the next page of the free list
+ */
+const uint32_t FREE_PAGE_NEXT_POINTER_SIZE = sizeof(uint32_t);
+const uint32_t FREE_PAGE_NEXT_POINTER_OFFSET = COMMON_NODE_HEADER_SIZE;
+
+/**
+ * Byte Tree Node Layout
+ * The byte tree keeps byte string keys and values of any size in slotted nodes. The in-page offsets of the cells
+ * follow the header in key order, and the cells are allocated from the back of the page towards them, the same
+ * way leaf values are, with freed cells kept on the free block list of the node.
+ * A leaf cell is the size of its value, the size of its key, the key and the value. A value larger than
+ * BYTES_MAX_INLINE_VALUE_SIZE is kept in a chain of overflow pages instead, and the cell only holds the first
+ * page of the chain, so that a lookup does not read a large value unless it asks for it.
+ * An internal cell is the child to the left of the key, the size of the key and the key. The rightmost child is
+ * kept in the header, where a leaf keeps its right sibling.
+ * The bytes that every key in the range of a node starts with are kept once, at the very end of the page, and the
+ * keys of the cells only hold what follows them.
+ */
+const uint32_t BYTES_NODE_NUM_CELLS_SIZE = sizeof(uint32_t);
+const uint32_t BYTES_NODE_NUM_CELLS_OFFSET = COMMON_NODE_HEADER_SIZE;
+const uint32_t BYTES_NODE_CELL_CONTENT_START_SIZE = sizeof(uint32_t);
+const uint32_t BYTES_NODE_CELL_CONTENT_START_OFFSET = BYTES_NODE_NUM_CELLS_OFFSET + BYTES_NODE_NUM_CELLS_SIZE;
+const uint32_t BYTES_NODE_RIGHT_POINTER_SIZE = sizeof(uint32_t);
+const uint32_t BYTES_NODE_RIGHT_POINTER_OFFSET = BYTES_NODE_CELL_CONTENT_START_OFFSET + BYTES_NODE_CELL_CONTENT_START_SIZE;
+const uint32_t BYTES_NODE_LEFT_SIBLING_POINTER_SIZE = sizeof(uint32_t);
+const uint32_t BYTES_NODE_LEFT_SIBLING_POINTER_OFFSET = BYTES_NODE_RIGHT_POINTER_OFFSET + BYTES_NODE_RIGHT_POINTER_SIZE;
+const uint32_t BYTES_NODE_PREFIX_SIZE_SIZE = sizeof(uint16_t);
+const uint32_t BYTES_NODE_PREFIX_SIZE_OFFSET = BYTES_NODE_LEFT_SIBLING_POINTER_OFFSET + BYTES_NODE_LEFT_SIBLING_POINTER_SIZE;
+const uint32_t BYTES_NODE_HEADER_SIZE = BYTES_NODE_PREFIX_SIZE_OFFSET + BYTES_NODE_PREFIX_SIZE_SIZE;
+const uint32_t BYTES_NODE_CELL_OFFSET_SIZE = sizeof(uint16_t);
+const uint32_t BYTES_NODE_CELL_OFFSETS_OFFSET = BYTES_NODE_HEADER_SIZE;
+
+const uint32_t BYTES_CELL_WORD_SIZE = sizeof(uint32_t);
+const uint32_t BYTES_CELL_WORD_OFFSET = 0;
+const uint32_t BYTES_CELL_KEY_SIZE_SIZE = sizeof(uint16_t);
+const uint32_t BYTES_CELL_KEY_SIZE_OFFSET = BYTES_CELL_WORD_OFFSET + BYTES_CELL_WORD_SIZE;
+const uint32_t BYTES_CELL_HEADER_SIZE = BYTES_CELL_WORD_SIZE + BYTES_CELL_KEY_SIZE_SIZE;
+const uint32_t BYTES_NODE_MAX_CELLS = (PAGE_SIZE - BYTES_NODE_CELL_OFFSETS_OFFSET) / (BYTES_NODE_CELL_OFFSET_SIZE + BYTES_CELL_HEADER_SIZE);
+//  Every node holds at least four of the largest cells, so that both halves of a split fit
+const uint32_t BYTES_MAX_KEY_SIZE = PAGE_SIZE / 16;
+const uint32_t BYTES_MAX_INLINE_VALUE_SIZE = PAGE_SIZE / 8;
+_Static_assert(sizeof(uint32_t) + sizeof(uint16_t) >= 2 * sizeof(uint16_t), "A freed cell must be able to hold a free block header");
+
+/**
+ * Overflow Page Layout
+ * An overflow page keeps the common node header, the next page of its chain and as much of the value as fits
+ */
+const uint32_t OVERFLOW_PAGE_NEXT_POINTER_SIZE = sizeof(uint32_t);
+const uint32_t OVERFLOW_PAGE_NEXT_POINTER_OFFSET = COMMON_NODE_HEADER_SIZE;
+const uint32_t OVERFLOW_PAGE_DATA_OFFSET = OVERFLOW_PAGE_NEXT_POINTER_OFFSET + OVERFLOW_PAGE_NEXT_POINTER_SIZE;
+const uint32_t OVERFLOW_PAGE_DATA_SIZE = PAGE_SIZE - OVERFLOW_PAGE_DATA_OFFSET;
+
+/**
+ * Meta Page Layout
+ * Page 0 of the file describes the file, and the tree starts out at page 1. The checksum covers the fields
+ * before it.
+ */
+const uint32_t META_PAGE_NUM = 0;
+const uint32_t META_MAGIC = 0x45525442;
+const uint32_t META_FORMAT_VERSION = 4;
+const uint32_t META_MAGIC_SIZE = sizeof(uint32_t);
+const uint32_t META_MAGIC_OFFSET = 0;
+const uint32_t META_FORMAT_VERSION_SIZE = sizeof(uint32_t);
+const uint32_t META_FORMAT_VERSION_OFFSET = META_MAGIC_OFFSET + META_MAGIC_SIZE;
+const uint32_t META_PAGE_SIZE_SIZE = sizeof(uint32_t);
+const uint32_t META_PAGE_SIZE_OFFSET = META_FORMAT_VERSION_OFFSET + META_FORMAT_VERSION_SIZE;
+const uint32_t META_ROOT_PAGE_NUM_SIZE = sizeof(uint32_t);
+const uint32_t META_ROOT_PAGE_NUM_OFFSET = META_PAGE_SIZE_OFFSET + META_PAGE_SIZE_SIZE;
+const uint32_t META_NUM_PAGES_SIZE = sizeof(uint32_t);
+const uint32_t META_NUM_PAGES_OFFSET = META_ROOT_PAGE_NUM_OFFSET + META_ROOT_PAGE_NUM_SIZE;
+const uint32_t META_FREE_LIST_HEAD_SIZE = sizeof(uint32_t);
+const uint32_t META_FREE_LIST_HEAD_OFFSET = META_NUM_PAGES_OFFSET + META_NUM_PAGES_SIZE;
+const uint32_t META_BYTES_ROOT_PAGE_NUM_SIZE = sizeof(uint32_t);
+const uint32_t META_BYTES_ROOT_PAGE_NUM_OFFSET = META_FREE_LIST_HEAD_OFFSET + META_FREE_LIST_HEAD_SIZE;
+const uint32_t META_UNLINKED_OVERFLOW_PAGE_NUM_SIZE = sizeof(uint32_t);
+const uint32_t META_UNLINKED_OVERFLOW_PAGE_NUM_OFFSET = META_BYTES_ROOT_PAGE_NUM_OFFSET + META_BYTES_ROOT_PAGE_NUM_SIZE;
+const uint32_t META_CHECKSUM_SIZE = sizeof(uint32_t);
+const uint32_t META_CHECKSUM_OFFSET = META_UNLINKED_OVERFLOW_PAGE_NUM_OFFSET + META_UNLINKED_OVERFLOW_PAGE_NUM_SIZE;
+_Static_assert(sizeof(uint32_t) >= 2 * sizeof(uint16_t), "A deleted value must be able to hold a free block header");
 
 /**
  * Common methods for all nodes
@@ -88,14 +227,64 @@ uint8_t* node_is_root(void* node) {
     return node + IS_ROOT_OFFSET;
 }
 
-void** node_parent_pointer(void* node) {
+uint32_t* node_parent_pointer(void* node) {
     return node + PARENT_POINTER_OFFSET;
 }
 
-uint32_t* node_free_block_offset(void* node) {
+uint16_t* node_free_block_offset(void* node) {
     return node + FREE_BLOCK_OFFSET_OFFSET;
 }
 
+/**
+ * @brief The LSN of the last logged change to the node
+ */
+uint64_t* node_lsn(void* node) {
+    return node + NODE_LSN_OFFSET;
+}
+
+uint32_t* free_page_next_pointer(void* page) {
+    return page + FREE_PAGE_NEXT_POINTER_OFFSET;
+}
+
+/**
+ * Meta page methods
+ */
+uint32_t* meta_magic(void* page) {
+    return page + META_MAGIC_OFFSET;
+}
+
+uint32_t* meta_format_version(void* page) {
+    return page + META_FORMAT_VERSION_OFFSET;
+}
+
+uint32_t* meta_page_size(void* page) {
+    return page + META_PAGE_SIZE_OFFSET;
+}
+
+uint32_t* meta_root_page_num(void* page) {
+    return page + META_ROOT_PAGE_NUM_OFFSET;
+}
+
+uint32_t* meta_num_pages(void* page) {
+    return page + META_NUM_PAGES_OFFSET;
+}
+
+uint32_t* meta_free_list_head(void* page) {
+    return page + META_FREE_LIST_HEAD_OFFSET;
+}
+
+uint32_t* meta_bytes_root_page_num(void* page) {
+    return page + META_BYTES_ROOT_PAGE_NUM_OFFSET;
+}
+
+uint32_t* meta_unlinked_overflow_page_num(void* page) {
+    return page + META_UNLINKED_OVERFLOW_PAGE_NUM_OFFSET;
+}
+
+uint32_t* meta_checksum(void* page) {
+    return page + META_CHECKSUM_OFFSET;
+}
+
 /**
  * Internal node methods
  */
@@ -103,16 +292,26 @@ uint32_t* internal_node_num_keys(void* node) {
     return node + INTERNAL_NODE_NUM_KEYS_OFFSET;
 }
 
-void** internal_node_right_child_pointer(void* node) {
+uint32_t* internal_node_right_child_pointer(void* node) {
     return node + INTERNAL_NODE_RIGHT_CHILD_POINTER_OFFSET;
 }
 
-void** internal_node_child_pointer(void* node, uint32_t child_num) {
-    return node + INTERNAL_NODE_HEADER_SIZE + child_num * INTERNAL_NODE_CELL_SIZE;
+uint32_t* internal_node_child_pointer(void* node, uint32_t child_num) {
+    return node + INTERNAL_NODE_CHILD_POINTERS_OFFSET + child_num * INTERNAL_NODE_CHILD_POINTER_SIZE;
 }
 
 uint32_t* internal_node_key(void* node, uint32_t key_num) {
-    return node + INTERNAL_NODE_HEADER_SIZE + (key_num * INTERNAL_NODE_CELL_SIZE) + INTERNAL_NODE_CHILD_POINTER_SIZE;
+    return node + INTERNAL_NODE_KEYS_OFFSET + key_num * INTERNAL_NODE_KEY_SIZE;
+}
+
+/**
+ * @brief Returns the child pointer that is followed for child_num, where child_num == num_keys is the right child
+ */
+uint32_t* internal_node_child_at(void* node, uint32_t child_num) {
+    if (child_num == *internal_node_num_keys(node)) {
+        return internal_node_right_child_pointer(node);
+    }
+    return internal_node_child_pointer(node, child_num);
 }
 
 /**
@@ -126,654 +325,6472 @@ uint32_t* leaf_node_right_sibling_pointer(void* node) {
     return node + LEAF_NODE_RIGHT_SIBLING_POINTER_OFFSET;
 }
 
+uint32_t* leaf_node_left_sibling_pointer(void* node) {
+    return node + LEAF_NODE_LEFT_SIBLING_POINTER_OFFSET;
+}
+
+uint32_t* leaf_node_cell_content_start(void* node) {
+    return node + LEAF_NODE_CELL_CONTENT_START_OFFSET;
+}
+
 uint32_t* leaf_node_key(void* node, uint32_t cell_num) {
-    return node + LEAF_NODE_HEADER_SIZE + cell_num * (LEAF_NODE_KEY_SIZE + LEAF_NODE_KEY_POINTER_SIZE);
+    return node + LEAF_NODE_KEYS_OFFSET + cell_num * LEAF_NODE_KEY_SIZE;
 }
 
-uintptr_t** leaf_node_key_pointer(void* node, uint32_t cell_num) {
-    return node + LEAF_NODE_HEADER_SIZE + cell_num * (LEAF_NODE_KEY_SIZE + LEAF_NODE_KEY_POINTER_SIZE) + LEAF_NODE_KEY_SIZE;
+uint16_t* leaf_node_value_offset(void* node, uint32_t cell_num) {
+    return node + LEAF_NODE_VALUE_OFFSETS_OFFSET + cell_num * LEAF_NODE_VALUE_OFFSET_SIZE;
 }
 
 uint32_t* leaf_node_value(void* node, uint32_t cell_num) {
-    uint32_t num_of_cells = *(uint32_t*)(leaf_node_num_cells(node));
-    if (num_of_cells == 0) {
-        return node + LEAF_NODE_VALUE_OFFSET;
-    }
-    void* start_point = node + LEAF_NODE_VALUE_OFFSET;
-    for (int i = 0; i < num_of_cells; i++) {
-        start_point -= LEAF_NODE_VALUE_SIZE;
-    }
-    return start_point;
+    return node + *leaf_node_value_offset(node, cell_num);
 }
 
+uint16_t* free_block_next_offset(void* node, uint16_t free_block_offset) {
+    return node + free_block_offset;
+}
 
-int check_type_of_node(void* node) {
-    uint8_t page_type = *node_type(node);
-    printf("Page type: %d\n", page_type);
-    switch(page_type) {
-        case INTERNAL_NODE:
-            printf("This is an internal node\n");
-            return 0;
-        case LEAF_NODE:
-            printf("This is a leaf node\n");
-            return 1;
-        default:
-            printf("This is an unknown node\n");
-            return -1;
-    }
+uint16_t* free_block_size(void* node, uint16_t free_block_offset) {
+    return node + free_block_offset + FREE_BLOCK_NEXT_OFFSET_SIZE;
 }
 
 /**
- * @brief This function is used to insert into the free block list
- * Starting at the page header, traverse the free block list, until the first empty one is found. 
- * Store the offset of the free block in the empty one.
- * 
- * @param node 
- * @param deleted_memory_address
- * @param deleted_memory_size 
+ * Byte tree node methods
+ * The cell accessors clamp what they read to the page, since readers look at nodes that may be changing and only
+ * validate them afterwards
  */
-void _insert_into_free_block_list(void* node, void* deleted_memory_address, uint16_t deleted_memory_size) {
-    printf("***\n");
-    printf("Deleting memory address %p of size %d\n", deleted_memory_address, deleted_memory_size);
-
-    //  If the free block list is empty, store the offset in the page header
-    printf("The deleted memory address is %p\n", deleted_memory_address);
-    uint16_t free_block_offset = *(uint16_t*)node_free_block_offset(node);
-    uint32_t offset_between_deleted_and_header = deleted_memory_address - node;
-    printf("The offset between the deleted memory address and the header is %d\n", offset_between_deleted_and_header);
-    if (free_block_offset == 0) {
-        printf("The free block offset is 0\n");
-        *(uint16_t*)node_free_block_offset(node) = offset_between_deleted_and_header;
-        printf("Done setting the free block address\n");
-        printf("***\n");
-        return;
-    }
-
-    //  If  the free block list is not empty, traverse the list until the first empty one is found, which is
-    //  past the address of offset
-    //  The new free block will be situated between the previous free block and the current free block
-    void* free_block = node + free_block_offset;
-    void* temp = node;
-    printf("Finding the next free block\n");
-    while(*(uint16_t*)free_block != 0 && free_block < deleted_memory_address) {
-        temp = free_block;
-        free_block = node + *(uint16_t*)free_block;
-    }
-
-    printf("The free block is %p\n", free_block);
-
-    printf("Updating the previous freeblock\n");
-    uint16_t offset_of_deleted_from_prev = (uint16_t)(deleted_memory_address - temp);
-    printf("Updating the previous freeblock with the offset to deleted memory: %d\n", offset_of_deleted_from_prev);
-    *(uint16_t*)temp = offset_of_deleted_from_prev;
-
-    printf("Setting the data for the new free block\n");
-    uint16_t offset_of_deleted_from_next = (uint16_t)(free_block - deleted_memory_address);
-    printf("Updating the new freeblock with the offset to the next free block: %d\n", offset_of_deleted_from_next);
-    uint16_t* deleted_memory_location = (uint16_t*)deleted_memory_address;
-    deleted_memory_location[0] = offset_of_deleted_from_next;
-    deleted_memory_location[1] = deleted_memory_size;
-    printf("Done deleting memory address %p of size %d\n", deleted_memory_address, deleted_memory_size);
-    printf("***\n");
-    return;
+uint32_t* bytes_node_num_cells(void* node) {
+    return node + BYTES_NODE_NUM_CELLS_OFFSET;
 }
 
-void delete(Pager* pager, uint32_t key) {
-    printf("****\n");
-    printf("Deleting key %d\n", key);
-
-    //  Check if the key exists first
-    if (search(pager, key) == -1) {
-        printf("The key does not exist\n");
-        return;
-    }
-
-    //  Get the root node
-    void* node = get_page(pager, pager->root_page_num);
-    printf("The root node is %p\n", node);
-
-    uint32_t key_index = binary_search_modify_pointer(&node, key);
-    printf("The key index is %d\n", key_index);
-
-    uint32_t num_cells = *(uint32_t*)leaf_node_num_cells(node);
-    printf("The number of cells in the node is %d\n", num_cells);
-
-    uint32_t key_at_index = *leaf_node_key(node, key_index);
-    printf("The key at index is %d\n", key_at_index);
-
-    uintptr_t** key_pointer_address = leaf_node_key_pointer(node, key_index);
-    printf("The key pointer is %p\n", key_pointer_address);
+uint32_t* bytes_node_cell_content_start(void* node) {
+    return node + BYTES_NODE_CELL_CONTENT_START_OFFSET;
+}
 
-    uintptr_t* value = *key_pointer_address;
-    printf("The value is %d\n", *(uint32_t*)value);
+/**
+ * @brief The right sibling of a leaf, or the rightmost child of an internal node
+ */
+uint32_t* bytes_node_right_pointer(void* node) {
+    return node + BYTES_NODE_RIGHT_POINTER_OFFSET;
+}
 
-    //  Shift the cells starting at one past the key pointer address to the left
-    //  This will erase the contents of the current key and key pointer
-    uint32_t num_of_cells_to_move = num_cells - key_index - 1;
-    uint32_t size_of_data_to_move = num_of_cells_to_move * (LEAF_NODE_KEY_SIZE + LEAF_NODE_KEY_POINTER_SIZE);
-    void* destination = leaf_node_key(node, key_index);
-    void* source = leaf_node_key(node, key_index + 1);
-    memmove(destination, source, size_of_data_to_move);
+uint32_t* bytes_node_left_sibling_pointer(void* node) {
+    return node + BYTES_NODE_LEFT_SIBLING_POINTER_OFFSET;
+}
 
-    //  Update the number of cells
-    *(uint32_t*)leaf_node_num_cells(node) = num_cells - 1;
+uint32_t bytes_node_prefix_size(void* node) {
+    uint32_t prefix_size = *(uint16_t*)(node + BYTES_NODE_PREFIX_SIZE_OFFSET);
+    return prefix_size < BYTES_MAX_KEY_SIZE ? prefix_size : BYTES_MAX_KEY_SIZE;
+}
 
-    //  Update the free block list with the address of the deleted value
-    _insert_into_free_block_list(node, value, LEAF_NODE_VALUE_SIZE);
-    printf("Done deleting key %d\n", key);
-    printf("****\n");
+void* bytes_node_prefix(void* node) {
+    return node + PAGE_SIZE - bytes_node_prefix_size(node);
 }
 
-void initialize_leaf_node(void* node) {
-    printf("Initializing the node as a leaf node\n");
-    *(uint32_t*)node = LEAF_NODE;
-    *(char*)node_initialized(node) = NODE_INITIALIZED;
-    *(uint32_t*)node_free_block_offset(node) = 0;
-    *(uint32_t*)leaf_node_num_cells(node) = 0;
-    printf("Done initializing the leaf node\n");
-    printf("***\n");
+uint16_t* bytes_node_cell_offset(void* node, uint32_t cell_num) {
+    return node + BYTES_NODE_CELL_OFFSETS_OFFSET + cell_num * BYTES_NODE_CELL_OFFSET_SIZE;
 }
 
-void initialize_internal_node(void* node) {
-    printf("Initializing the node as an internal node\n");
-    *(uint32_t*)node = INTERNAL_NODE;
-    *(char*)node_initialized(node) = NODE_INITIALIZED;
-    *(uint32_t*)node_free_block_offset(node) = 0;
-    *(uint32_t*)internal_node_num_keys(node) = 0;
-    printf("Done initializing the internal node\n");
+void* bytes_node_cell(void* node, uint32_t cell_num) {
+    uint16_t offset = *bytes_node_cell_offset(node, cell_num);
+    if (offset > PAGE_SIZE - BYTES_CELL_HEADER_SIZE) {
+        offset = PAGE_SIZE - BYTES_CELL_HEADER_SIZE;
+    }
+    return node + offset;
 }
 
-void split_internal_node(Pager* pager, void* node, void* sibling_node, uint32_t key, void* child_pointer) {
-    return;
+/**
+ * @brief The value size of a leaf cell, or the child to the left of the key of an internal cell
+ */
+uint32_t* bytes_cell_word(void* cell) {
+    return cell + BYTES_CELL_WORD_OFFSET;
 }
 
-void split_leaf_node(Pager* pager, void* node, void* sibling_node, uint32_t key, uint32_t value) {
-    printf("****\n");
-    printf("Splitting the leaf node\n");
+uint32_t bytes_cell_key_size(void* node, void* cell) {
+    uint32_t key_size = *(uint16_t*)(cell + BYTES_CELL_KEY_SIZE_OFFSET);
+    uint32_t room = node + PAGE_SIZE - (cell + BYTES_CELL_HEADER_SIZE);
+    return key_size < room ? key_size : room;
+}
 
-    printf("The new node is %p\n", sibling_node);
+void* bytes_cell_key(void* cell) {
+    return cell + BYTES_CELL_HEADER_SIZE;
+}
 
-    //  Initialize the new node
-    initialize_leaf_node(sibling_node);
+/**
+ * @brief The inline value of a leaf cell, or the first overflow page of a value that is too large to be inline
+ */
+void* bytes_cell_value(void* node, void* cell) {
+    void* value = cell + BYTES_CELL_HEADER_SIZE + bytes_cell_key_size(node, cell);
+    return value < node + PAGE_SIZE - sizeof(uint32_t) ? value : node + PAGE_SIZE - sizeof(uint32_t);
+}
 
-    //  Copy the second half of the keys and their corresponding values to the new node
-    uint32_t num_cells = *(uint32_t*)leaf_node_num_cells(node);
-    printf("The number of cells is %d\n", num_cells);
+uint32_t bytes_value_is_inline(uint32_t value_size) {
+    return value_size <= BYTES_MAX_INLINE_VALUE_SIZE;
+}
 
-    uint32_t start_index_of_cells_to_move = num_cells / 2;
-    printf("The number of cells to move is %d\n", num_cells - start_index_of_cells_to_move);
+uint32_t bytes_leaf_cell_size(uint32_t key_size, uint32_t value_size) {
+    return BYTES_CELL_HEADER_SIZE + key_size + (bytes_value_is_inline(value_size) ? value_size : sizeof(uint32_t));
+}
 
-    for (int i = start_index_of_cells_to_move; i < num_cells; i++) {
-        uint32_t key = *leaf_node_key(node, i);
-        uintptr_t** key_pointer_address = leaf_node_key_pointer(node, i);
-        uintptr_t* value = *key_pointer_address;
-        printf("Copying the key: %d\n", key);
-        printf("Copying the value: %d\n", *(uint32_t*)value);
-        _insert(pager, sibling_node, key, *(uint32_t*)value);
+uint32_t bytes_node_cell_size(void* node, void* cell) {
+    if (*node_type(node) == BYTES_INTERNAL_NODE) {
+        return BYTES_CELL_HEADER_SIZE + bytes_cell_key_size(node, cell);
     }
+    return bytes_leaf_cell_size(bytes_cell_key_size(node, cell), *bytes_cell_word(cell));
+}
 
-    //  Update the number of cells in the original node
-    *(uint32_t*)leaf_node_num_cells(node) = start_index_of_cells_to_move;
-
-    //  Update the number of cells in the new node
-    *(uint32_t*)leaf_node_num_cells(sibling_node) = num_cells - start_index_of_cells_to_move;
-
-    //  Insert the new key and value into one of the nodes
-    if (key <= *leaf_node_key(sibling_node, 0)) {
-        printf("Inserting the key %d into the original node\n", key);
-        _insert(pager, node, key, value);
-    } else {
-        printf("Inserting the key %d into the new node\n", key);
-        _insert(pager, sibling_node, key, value);
+/**
+ * @brief This method copies the whole key of a cell, the prefix of the node followed by the key of the cell
+ * 
+ * @param node 
+ * @param cell 
+ * @param key At least BYTES_MAX_KEY_SIZE bytes
+ * @return uint32_t The size of the key
+ */
+uint32_t bytes_node_copy_key(void* node, void* cell, uint8_t* key) {
+    uint32_t prefix_size = bytes_node_prefix_size(node);
+    uint32_t suffix_size = bytes_cell_key_size(node, cell);
+    if (suffix_size > BYTES_MAX_KEY_SIZE - prefix_size) {
+        suffix_size = BYTES_MAX_KEY_SIZE - prefix_size;
     }
-    return;
+    memcpy(key, bytes_node_prefix(node), prefix_size);
+    memcpy(key + prefix_size, bytes_cell_key(cell), suffix_size);
+    return prefix_size + suffix_size;
 }
 
-void _insert_key_value_pair_to_internal_node(void* node, uint32_t key, void* child_pointer) {
-    uint32_t num_keys = *(uint32_t*)internal_node_num_keys(node);
-    printf("The number of keys is %d\n", num_keys);
-
-    uint32_t key_index = binary_search(node, key);
-    printf("The key index is %d\n", key_index);
-
-    uint32_t* destination = internal_node_key(node, key_index);
-    uint32_t num_of_cells_to_move = num_keys - key_index;
-    printf("The number of cells to move is %d\n", num_of_cells_to_move);
-
-    uint64_t size_of_data_to_move = num_of_cells_to_move * (INTERNAL_NODE_KEY_SIZE + INTERNAL_NODE_CHILD_POINTER_SIZE);
-    printf("The size of data to move is: %llu\n", size_of_data_to_move);
-
-    printf("Moving %llu bytes from %p to %p\n", size_of_data_to_move, destination, destination + INTERNAL_NODE_KEY_SIZE + INTERNAL_NODE_CHILD_POINTER_SIZE);
-    memmove((void*)destination + INTERNAL_NODE_KEY_SIZE + INTERNAL_NODE_CHILD_POINTER_SIZE, destination, size_of_data_to_move);
-
-    //  Insert the new key and child pointer
-    *internal_node_key(node, key_index) = key;
-    void** current_child_pointer = internal_node_child_pointer(node, key_index);
-    *current_child_pointer = child_pointer;
-
-    //  Update the number of keys
-    *(uint32_t*)internal_node_num_keys(node) = num_keys + 1;
+/**
+ * @brief Returns the child that is followed for child_num, where child_num == num_cells is the rightmost child
+ */
+uint32_t* bytes_internal_node_child_at(void* node, uint32_t child_num) {
+    if (child_num >= *bytes_node_num_cells(node)) {
+        return bytes_node_right_pointer(node);
+    }
+    return bytes_cell_word(bytes_node_cell(node, child_num));
 }
 
-void _insert_key_value_pair_to_leaf_node(void* node, uint32_t key, uint32_t value) {
-    uint32_t num_cells = *(uint32_t*)leaf_node_num_cells(node);
-    printf("The number of cells is %d\n", num_cells);
-
-    uint32_t key_index = binary_search(node, key);
-    printf("The key index is %d\n", key_index);
-
-    uint32_t* destination = leaf_node_key(node, key_index);
-    uint32_t num_of_cells_to_move = num_cells - key_index;
-    printf("The number of cells to move is %d\n", num_of_cells_to_move);
-
-    uint64_t size_of_data_to_move = num_of_cells_to_move * (LEAF_NODE_KEY_SIZE + LEAF_NODE_KEY_POINTER_SIZE);
-    printf("The size of data to move is %llu\n", size_of_data_to_move);
-
-    printf("Moving %llu bytes of data from %p to %p\n", size_of_data_to_move, destination, destination + LEAF_NODE_KEY_SIZE + LEAF_NODE_KEY_POINTER_SIZE);
-    memmove((void*)destination + LEAF_NODE_KEY_SIZE + LEAF_NODE_KEY_POINTER_SIZE, destination, size_of_data_to_move);
-
-    *(uint32_t*)leaf_node_key(node, key_index) = key;
-    printf("Set the key as %d\n", key);
-
-    uint32_t* value_destination = leaf_node_value(node, key_index);
-    *(uint32_t*)value_destination = value;
-    printf("Set the value as %d\n", value);
-
-    uintptr_t** key_pointer_address = leaf_node_key_pointer(node, key_index);
-    *key_pointer_address = (uintptr_t*)value_destination;
+uint32_t* overflow_page_next_pointer(void* page) {
+    return page + OVERFLOW_PAGE_NEXT_POINTER_OFFSET;
+}
 
-    *(uint32_t*)leaf_node_num_cells(node) = num_cells + 1;
-    printf("\n");
-    return;
+void* overflow_page_data(void* page) {
+    return page + OVERFLOW_PAGE_DATA_OFFSET;
 }
 
-void _insert_into_internal(Pager* pager, void* node, uint32_t key, void* child_pointer) {
-    uint32_t num_keys = *(uint32_t*)internal_node_num_keys(node);
-    printf("The number of keys is %d\n", num_keys);
 
-    //  Check if the node needs to be split
-    if (num_keys < NODE_ORDER - 1) {
-        printf("The internal node does not need to be split\n");
-        _insert_key_value_pair_to_internal_node(node, key, child_pointer);
-        return;
+int check_type_of_node(void* node) {
+    uint8_t page_type = *node_type(node);
+    TRACE_DEBUG("Page type: %d\n", page_type);
+    switch(page_type) {
+        case INTERNAL_NODE:
+            TRACE_DEBUG("This is an internal node\n");
+            return 0;
+        case LEAF_NODE:
+            TRACE_DEBUG("This is a leaf node\n");
+            return 1;
+        default:
+            TRACE_DEBUG("This is an unknown node\n");
+            return -1;
     }
+}
 
-    //  The node needs to be split
-
-    //  Check if this node has a parent that has been initialized
-    void** parent_page = node_parent_pointer(node);
+/**
+ * @brief This function is used to insert into the free block list
+ * Starting at the page header, traverse the free block list until the first block past the deleted one is found,
+ * and link the deleted block in front of it. A block that touches its neighbours is merged with them.
+ * 
+ * @param node 
+ * @param deleted_offset
+ * @param deleted_memory_size 
+ */
+void _insert_into_free_block_list(void* node, uint16_t deleted_offset, uint16_t deleted_memory_size) {
+    TRACE_DEBUG("***\n");
+    TRACE_DEBUG("Freeing the block at offset %d of size %d\n", deleted_offset, deleted_memory_size);
 
-    //  Create a new root if the parent has not been initialized
-    if (*(char*)node_initialized(*parent_page) != NODE_INITIALIZED) {
-        void* new_root = get_page(pager, pager->num_pages);
-        *parent_page = new_root;
-        initialize_internal_node(*parent_page);
-        *(uint8_t*)node_is_root(parent_page) = 1;
-        set_root_page(pager, pager->num_pages - 1);
+    //  Find the free blocks on either side of the deleted block
+    uint16_t previous_offset = 0;
+    uint16_t next_offset = *node_free_block_offset(node);
+    while (next_offset != 0 && next_offset < deleted_offset) {
+        previous_offset = next_offset;
+        next_offset = *free_block_next_offset(node, next_offset);
     }
 
-    printf("The internal node needs to be split\n");
-    void* sibling_node = get_page(pager, pager->num_pages);
-    split_internal_node(pager, node, sibling_node, key, child_pointer);
-    if (key <= *internal_node_key(sibling_node, 0)) {
-        _insert(pager, node, key, child_pointer);
+    *free_block_next_offset(node, deleted_offset) = next_offset;
+    *free_block_size(node, deleted_offset) = deleted_memory_size;
+    if (previous_offset == 0) {
+        *node_free_block_offset(node) = deleted_offset;
     } else {
-        _insert(pager, sibling_node, key, child_pointer);
+        *free_block_next_offset(node, previous_offset) = deleted_offset;
     }
 
-    int key_to_promote = *internal_node_key(sibling_node, 0);
-    _insert(pager, parent_page, key_to_promote, sibling_node);
-    *node_parent_pointer(sibling_node) = parent_page;
-    *node_parent_pointer(node) = parent_page;
-
-    int parent_insertion_index = binary_search(parent_page, key_to_promote);
-    int parent_num_keys = *(uint32_t*)internal_node_num_keys(parent_page);
-    if (parent_insertion_index < parent_num_keys) {
-        void** parent_child_pointer = internal_node_child_pointer(parent_page, parent_insertion_index);
-        *parent_child_pointer = sibling_node;
-    } else {
-        void** parent_right_child_pointer = internal_node_right_child_pointer(parent_page);
-        *parent_right_child_pointer = sibling_node;
+    //  Merge with the next block and then with the previous block if they are adjacent
+    if (next_offset != 0 && deleted_offset + *free_block_size(node, deleted_offset) == next_offset) {
+        TRACE_DEBUG("Merging with the next free block at offset %d\n", next_offset);
+        *free_block_size(node, deleted_offset) += *free_block_size(node, next_offset);
+        *free_block_next_offset(node, deleted_offset) = *free_block_next_offset(node, next_offset);
     }
-
-    //  For an internal node, remove the node's right child pointer
-    void** right_child_pointer = internal_node_right_child_pointer(node);
-    *right_child_pointer = NULL;
+    if (previous_offset != 0 && previous_offset + *free_block_size(node, previous_offset) == deleted_offset) {
+        TRACE_DEBUG("Merging with the previous free block at offset %d\n", previous_offset);
+        *free_block_size(node, previous_offset) += *free_block_size(node, deleted_offset);
+        *free_block_next_offset(node, previous_offset) = *free_block_next_offset(node, deleted_offset);
+    }
+    TRACE_DEBUG("***\n");
     return;
 }
 
-void _insert_into_leaf(Pager* pager, void* node, uint32_t key, uint32_t value) {
-    uint32_t num_cells = *(uint32_t*)leaf_node_num_cells(node);
-    printf("The number of cells is %d\n", num_cells);
+/**
+ * @brief This method rewrites the values of a leaf node back to back at the end of the page
+ * Afterwards the free block list is empty and all free space sits between the cells and the cell content start
+ * 
+ * @param node 
+ */
+void compact_leaf_node(void* node) {
+    TRACE_DEBUG("Compacting the leaf node\n");
+    uint32_t num_cells = *leaf_node_num_cells(node);
+    uint32_t* values = malloc((num_cells + 1) * sizeof(uint32_t));
+    for (uint32_t i = 0; i < num_cells; i++) {
+        values[i] = *leaf_node_value(node, i);
+    }
 
-    //  Check if the node needs to be split
-    if (num_cells < NODE_ORDER) {
-        //  this leaf node does not need to be split
-        printf("The leaf node does not need to be split\n");
-        _insert_key_value_pair_to_leaf_node(node, key, value);
-        return;
+    uint32_t cell_content_start = PAGE_SIZE;
+    for (uint32_t i = 0; i < num_cells; i++) {
+        cell_content_start -= LEAF_NODE_VALUE_SIZE;
+        *leaf_node_value_offset(node, i) = cell_content_start;
+        *(uint32_t*)(node + cell_content_start) = values[i];
     }
+    *leaf_node_cell_content_start(node) = cell_content_start;
+    *node_free_block_offset(node) = 0;
+    free(values);
+}
 
-    //  The node needs to split
-    printf("The leaf node needs to be split\n");
+/**
+ * @brief This method takes a block of a node from its free block list, first fit
+ * 
+ * @param node 
+ * @param size 
+ * @return uint16_t The offset of the block, or 0 if no free block is large enough
+ */
+uint16_t allocate_from_free_block_list(void* node, uint16_t size) {
+    uint16_t previous_offset = 0;
+    uint16_t free_block = *node_free_block_offset(node);
+    while (free_block != 0) {
+        uint16_t block_size = *free_block_size(node, free_block);
+        if (block_size >= size) {
+            if (block_size - size >= FREE_BLOCK_HEADER_SIZE) {
+                //  Take the end of the block so that the rest of it stays where it is in the list
+                *free_block_size(node, free_block) = block_size - size;
+                return free_block + block_size - size;
+            }
+            //  Use the whole block. Any bytes left over are too small to track and come back on compaction
+            uint16_t next_offset = *free_block_next_offset(node, free_block);
+            if (previous_offset == 0) {
+                *node_free_block_offset(node) = next_offset;
+            } else {
+                *free_block_next_offset(node, previous_offset) = next_offset;
+            }
+            return free_block;
+        }
+        previous_offset = free_block;
+        free_block = *free_block_next_offset(node, free_block);
+    }
+    return 0;
+}
 
-    //  Check if this node has a parent that has been initialized
-    void** parent_page_pointer = node_parent_pointer(node);
+/**
+ * @brief This method allocates space for a value in a leaf node that is about to get one more cell
+ * The free block list is searched first fit. Otherwise the value is taken from the gap between the cells and
+ * the cell content start, compacting the node first if the free space is fragmented.
+ * 
+ * @param node 
+ * @param size 
+ * @return uint16_t The offset of the value
+ */
+uint16_t leaf_node_allocate_value(void* node, uint16_t size) {
+    uint16_t free_block = allocate_from_free_block_list(node, size);
+    if (free_block != 0) {
+        return free_block;
+    }
 
-    if (*parent_page_pointer == NULL || *(char*)node_initialized(*parent_page_pointer) != NODE_INITIALIZED) {
-        void* new_root = get_page(pager, pager->num_pages);
-        *parent_page_pointer = new_root;
-        initialize_internal_node(*parent_page_pointer);
-        *(uint8_t*)node_is_root(*parent_page_pointer) = 1;
-        set_root_page(pager, pager->num_pages - 1);
+    uint32_t end_of_cells = LEAF_NODE_END_OF_CELLS;
+    if (*leaf_node_cell_content_start(node) < end_of_cells + size) {
+        compact_leaf_node(node);
+    }
+    if (*leaf_node_cell_content_start(node) < end_of_cells + size) {
+        fprintf(stderr, "There is no room for a value of size %d in the leaf node\n", size);
+        exit(EXIT_FAILURE);
     }
+    *leaf_node_cell_content_start(node) -= size;
+    return *leaf_node_cell_content_start(node);
+}
 
-    void* sibling_node = get_page(pager, pager->num_pages);
-    split_leaf_node(pager, node, sibling_node, key, value);
+/**
+ * @brief This method removes the cell at key_index from a leaf node and frees its value
+ * 
+ * @param node 
+ * @param key_index 
+ */
+void _delete_key_from_leaf_node(void* node, uint32_t key_index) {
+    uint32_t num_cells = *(uint32_t*)leaf_node_num_cells(node);
+    uint16_t value_offset = *leaf_node_value_offset(node, key_index);
 
-    int key_to_promote = *leaf_node_key(sibling_node, 0);
-    _insert(pager, *parent_page_pointer, key_to_promote, node);
-    *node_parent_pointer(sibling_node) = *parent_page_pointer;
-    *node_parent_pointer(node) = *parent_page_pointer;
+    //  Shift the cells starting at one past the key index to the left
+    //  This will erase the contents of the current key and value offset
+    uint32_t num_of_cells_to_move = num_cells - key_index - 1;
+    memmove(leaf_node_key(node, key_index), leaf_node_key(node, key_index + 1), num_of_cells_to_move * LEAF_NODE_KEY_SIZE);
+    memmove(leaf_node_value_offset(node, key_index), leaf_node_value_offset(node, key_index + 1),
+        num_of_cells_to_move * LEAF_NODE_VALUE_OFFSET_SIZE);
 
-    int parent_insertion_index = binary_search(*parent_page_pointer, key_to_promote);
-    int parent_num_keys = *(uint32_t*)internal_node_num_keys(*parent_page_pointer);
-    if (parent_insertion_index < parent_num_keys) {
-        //  Set the left child pointer of the parent at  insertion index equal to the sibling node
-        *internal_node_child_pointer(*parent_page_pointer, parent_insertion_index) = sibling_node;
-    } else {
-        //  Set the right child pointer of the parent at insertion index equal to the sibling node
-        *internal_node_right_child_pointer(*parent_page_pointer) = sibling_node;
-    }
+    //  Update the number of cells
+    *(uint32_t*)leaf_node_num_cells(node) = num_cells - 1;
 
-    return;
+    //  Update the free block list with the offset of the deleted value
+    _insert_into_free_block_list(node, value_offset, LEAF_NODE_VALUE_SIZE);
 }
 
-void insert(Pager* pager, uint32_t key, uint32_t value) {
-    //  get the root node
-    void* node = get_page(pager, pager->root_page_num);
-    printf("The root node is at %p\n", node);
+/**
+ * Tree paths
+ * A writer records the nodes it descends through, so that a split or a merge finds the parent of a node and the
+ * index of the node in it without another descent. The nodes stay pinned until the path is released.
+ */
 
-    //  Check if the root node is initialized
+/**
+ * @brief This method descends from the root to the leaf that covers a key and records the path of the current
+ * operation on the way
+ * 
+ * @param pager 
+ * @param key 
+ * @param initialize_empty_root Whether an empty tree gets a root leaf
+ * @return void* The leaf, which may be an uninitialized root if the tree is empty
+ */
+void* descend_to_leaf(Pager* pager, uint32_t key, uint8_t initialize_empty_root) {
+    TreePath* path = &pager->path;
+    void* node = get_page(pager, pager->root_page_num);
+    path->nodes[0] = node;
+    path->child_indices[0] = 0;
+    path->depth = 1;
+    STATS_COUNT(node_visits, 1);
     if (*(char*)node_initialized(node) != NODE_INITIALIZED) {
-        initialize_leaf_node(node);
+        if (initialize_empty_root) {
+            latch_node(pager, node);
+            initialize_leaf_node(node);
+            *(uint8_t*)node_is_root(node) = 1;
+            mark_node_dirty(pager, node);
+        }
+        return node;
     }
 
-    _insert(pager, node, key, value);
-    return;
+    while (check_type_of_node(node) == INTERNAL_NODE) {
+        if (path->depth == MAX_TREE_HEIGHT) {
+            fprintf(stderr, "The tree is more than %d levels deep\n", MAX_TREE_HEIGHT);
+            exit(EXIT_FAILURE);
+        }
+        uint32_t child_index = binary_search(node, key);
+        node = get_child_node(pager, node, internal_node_child_at(node, child_index));
+        path->nodes[path->depth] = node;
+        path->child_indices[path->depth] = child_index;
+        path->depth++;
+        STATS_COUNT(node_visits, 1);
+    }
+    if (*leaf_node_right_sibling_pointer(node) == INVALID_PAGE_NUM) {
+        pager->append_leaf_page_num = get_node_page_num(pager, node);
+    }
+    return node;
 }
 
 /**
- * @brief This method will take a pointer to a page and a key and will return the index of the key in the page
- * It will also modify the pointer to the page to point to the correct child node
+ * @brief This method returns the rightmost leaf if a key is larger than every key in the tree and fits in the
+ * leaf without a split, so that appends skip the descent. The path of the operation is the leaf alone, which is
+ * enough since nothing above the leaf changes.
+ * The cached page is checked rather than kept up to date, since a page that is a leaf without a right sibling
+ * is the rightmost leaf, whatever happened to the page since it was cached.
  * 
- * @param node 
+ * @param pager 
  * @param key 
+ * @return void* The pinned leaf, or NULL if the key has to descend
+ */
+void* find_append_leaf(Pager* pager, uint32_t key) {
+    if (pager->append_leaf_page_num == INVALID_PAGE_NUM) {
+        return NULL;
+    }
+    void* node = get_page(pager, pager->append_leaf_page_num);
+    uint32_t num_cells = *leaf_node_num_cells(node);
+    if (*(char*)node_initialized(node) != NODE_INITIALIZED || check_type_of_node(node) != LEAF_NODE ||
+        *leaf_node_right_sibling_pointer(node) != INVALID_PAGE_NUM || num_cells == 0 ||
+        num_cells >= LEAF_NODE_MAX_CELLS || *leaf_node_key(node, num_cells - 1) >= key) {
+        unpin_node(pager, node);
+        return NULL;
+    }
+    pager->path.nodes[0] = node;
+    pager->path.child_indices[0] = 0;
+    pager->path.depth = 1;
+    STATS_COUNT(node_visits, 1);
+    STATS_ADD(pager, fast_appends, 1);
+    return node;
+}
+
+/**
+ * @brief This method finds the leaf to insert a key into, through the append fast path if it can
+ * 
+ * @param pager 
+ * @param key 
+ * @return void* 
+ */
+void* descend_to_leaf_for_insert(Pager* pager, uint32_t key) {
+    void* node = find_append_leaf(pager, key);
+    return node != NULL ? node : descend_to_leaf(pager, key, 1);
+}
+
+/**
+ * @brief This method unpins the nodes on the path of the current operation
+ * 
+ * @param pager 
+ */
+void release_path(Pager* pager) {
+    for (uint32_t i = 0; i < pager->path.depth; i++) {
+        unpin_node(pager, pager->path.nodes[i]);
+    }
+    pager->path.depth = 0;
+}
+
+/**
+ * @brief This method returns the level of a node on the path of the current operation, where the root is at 0
+ * 
+ * @param pager 
+ * @param node 
+ * @return uint32_t 
+ */
+uint32_t get_path_level(Pager* pager, void* node) {
+    for (uint32_t i = pager->path.depth; i-- > 0;) {
+        if (pager->path.nodes[i] == node) {
+            return i;
+        }
+    }
+    fprintf(stderr, "Page %d is not on the path of the operation\n", get_node_page_num(pager, node));
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * @brief This method returns the parent of a node that is not the root from the path of the current operation
+ * The parent stays pinned by the path
+ * 
+ * @param pager 
+ * @param node 
+ * @param child_index The index of the node in the parent
+ * @return void* 
+ */
+void* get_parent_node(Pager* pager, void* node, uint32_t* child_index) {
+    uint32_t level = get_path_level(pager, node);
+    if (level == 0) {
+        fprintf(stderr, "The root has no parent\n");
+        exit(EXIT_FAILURE);
+    }
+    *child_index = pager->path.child_indices[level];
+    return pager->path.nodes[level - 1];
+}
+
+/**
+ * @brief This method removes a key and the child to the right of it from an internal node
+ * 
+ * @param node 
+ * @param key_index 
+ */
+void _delete_key_from_internal_node(void* node, uint32_t key_index) {
+    uint32_t num_keys = *internal_node_num_keys(node);
+    if (key_index + 1 == num_keys) {
+        *internal_node_right_child_pointer(node) = *internal_node_child_pointer(node, key_index);
+    } else {
+        memmove(internal_node_child_pointer(node, key_index + 1), internal_node_child_pointer(node, key_index + 2),
+            (num_keys - key_index - 2) * INTERNAL_NODE_CHILD_POINTER_SIZE);
+    }
+    memmove(internal_node_key(node, key_index), internal_node_key(node, key_index + 1),
+        (num_keys - key_index - 1) * INTERNAL_NODE_KEY_SIZE);
+    *internal_node_num_keys(node) = num_keys - 1;
+}
+
+/**
+ * @brief This method points the swizzled children in a range of child indices of a node back at the node, after
+ * their pointers have moved there from a sibling
+ * 
+ * @param pager 
+ * @param node 
+ * @param first_child 
+ * @param last_child 
+ */
+void adopt_children(Pager* pager, void* node, uint32_t first_child, uint32_t last_child) {
+    for (uint32_t i = first_child; i <= last_child; i++) {
+        uint32_t child_pointer = *internal_node_child_at(node, i);
+        if (is_swizzled(child_pointer)) {
+            pager->frames[child_pointer & ~SWIZZLED_POINTER_FLAG].swizzled_parent = get_frame_index(pager, node);
+        }
+    }
+}
+
+/**
+ * @brief This method returns the pinned and latched sibling of a node that is used to rebalance it
+ * The left sibling under the same parent is preferred, and the leftmost child uses its right sibling
+ * 
+ * @param pager 
+ * @param parent_node 
+ * @param child_index The index of the node in the parent
+ * @param sibling_index The index of the sibling in the parent
+ * @return void* 
+ */
+void* get_sibling_for_rebalance(Pager* pager, void* parent_node, uint32_t child_index, uint32_t* sibling_index) {
+    //  Only the root may have a single child, and a root is never rebalanced against a sibling
+    if (*internal_node_num_keys(parent_node) == 0) {
+        fprintf(stderr, "Internal node %u has no keys, so its child has no sibling\n",
+            get_node_page_num(pager, parent_node));
+        exit(EXIT_FAILURE);
+    }
+    *sibling_index = child_index > 0 ? child_index - 1 : child_index + 1;
+    void* sibling_node = get_child_node(pager, parent_node, internal_node_child_at(parent_node, *sibling_index));
+    latch_node(pager, sibling_node);
+    return sibling_node;
+}
+
+/**
+ * @brief This method makes the only child of a root without keys the new root and frees the old root
+ * 
+ * @param pager 
+ * @param root_node 
+ */
+void collapse_root(Pager* pager, void* root_node) {
+    TRACE_DEBUG("Collapsing the root\n");
+    STATS_ADD(pager, root_collapses, 1);
+    uint32_t* child_pointer = internal_node_right_child_pointer(root_node);
+    void* child_node = get_child_node(pager, root_node, child_pointer);
+    latch_node(pager, child_node);
+    //  The child cannot point back at a root that is about to be freed
+    pthread_mutex_lock(&pager->latch);
+    pager->frames[get_frame_index(pager, child_node)].swizzled_parent = -1;
+    *child_pointer = get_node_page_num(pager, child_node);
+    pthread_mutex_unlock(&pager->latch);
+
+    *(uint8_t*)node_is_root(child_node) = 1;
+    mark_node_dirty(pager, child_node);
+    set_root_page(pager, get_node_page_num(pager, child_node));
+    unpin_node(pager, child_node);
+    free_page(pager, root_node);
+}
+
+/**
+ * @brief This method fixes an internal node after a separator was removed from it
+ * A root without keys is collapsed. Any other node with fewer than INTERNAL_NODE_MIN_KEYS keys rotates a key in
+ * from a sibling that can spare one, through the parent, or is merged with the sibling otherwise, which removes a
+ * separator from the parent in turn.
+ * 
+ * @param pager 
+ * @param node A latched node
+ */
+void rebalance_internal_node(Pager* pager, void* node) {
+    uint32_t num_keys = *internal_node_num_keys(node);
+    if (*(uint8_t*)node_is_root(node)) {
+        if (num_keys == 0) {
+            collapse_root(pager, node);
+        }
+        return;
+    }
+    if (num_keys >= INTERNAL_NODE_MIN_KEYS) {
+        return;
+    }
+
+    TRACE_DEBUG("Rebalancing the internal node\n");
+    uint32_t child_index;
+    void* parent_node = get_parent_node(pager, node, &child_index);
+    latch_node(pager, parent_node);
+    uint32_t sibling_index;
+    void* sibling_node = get_sibling_for_rebalance(pager, parent_node, child_index, &sibling_index);
+    uint32_t num_sibling_keys = *internal_node_num_keys(sibling_node);
+
+    if (num_sibling_keys > INTERNAL_NODE_MIN_KEYS) {
+        if (sibling_index < child_index) {
+            //  The separator comes down in front of the node and the last key of the sibling goes up
+            memmove(internal_node_key(node, 1), internal_node_key(node, 0), num_keys * INTERNAL_NODE_KEY_SIZE);
+            memmove(internal_node_child_pointer(node, 1), internal_node_child_pointer(node, 0),
+                num_keys * INTERNAL_NODE_CHILD_POINTER_SIZE);
+            *internal_node_child_pointer(node, 0) = *internal_node_right_child_pointer(sibling_node);
+            *internal_node_key(node, 0) = *internal_node_key(parent_node, sibling_index);
+            *internal_node_num_keys(node) = num_keys + 1;
+            *internal_node_key(parent_node, sibling_index) = *internal_node_key(sibling_node, num_sibling_keys - 1);
+            *internal_node_right_child_pointer(sibling_node) = *internal_node_child_pointer(sibling_node, num_sibling_keys - 1);
+            *internal_node_num_keys(sibling_node) = num_sibling_keys - 1;
+            adopt_children(pager, node, 0, 0);
+        } else {
+            //  The separator comes down behind the node and the first key of the sibling goes up
+            *internal_node_child_pointer(node, num_keys) = *internal_node_right_child_pointer(node);
+            *internal_node_key(node, num_keys) = *internal_node_key(parent_node, child_index);
+            *internal_node_right_child_pointer(node) = *internal_node_child_pointer(sibling_node, 0);
+            *internal_node_num_keys(node) = num_keys + 1;
+            *internal_node_key(parent_node, child_index) = *internal_node_key(sibling_node, 0);
+            memmove(internal_node_key(sibling_node, 0), internal_node_key(sibling_node, 1),
+                (num_sibling_keys - 1) * INTERNAL_NODE_KEY_SIZE);
+            memmove(internal_node_child_pointer(sibling_node, 0), internal_node_child_pointer(sibling_node, 1),
+                (num_sibling_keys - 1) * INTERNAL_NODE_CHILD_POINTER_SIZE);
+            *internal_node_num_keys(sibling_node) = num_sibling_keys - 1;
+            adopt_children(pager, node, num_keys + 1, num_keys + 1);
+        }
+        mark_node_dirty(pager, node);
+        mark_node_dirty(pager, sibling_node);
+        mark_node_dirty(pager, parent_node);
+        unpin_node(pager, sibling_node);
+        STATS_ADD(pager, borrows, 1);
+        return;
+    }
+
+    //  Merge the right one of the two nodes into the left one, with the separator between them
+    void* left_node = sibling_index < child_index ? sibling_node : node;
+    void* right_node = sibling_index < child_index ? node : sibling_node;
+    uint32_t separator_index = sibling_index < child_index ? sibling_index : child_index;
+    uint32_t num_left_keys = *internal_node_num_keys(left_node);
+    uint32_t num_right_keys = *internal_node_num_keys(right_node);
+    *internal_node_child_pointer(left_node, num_left_keys) = *internal_node_right_child_pointer(left_node);
+    *internal_node_key(left_node, num_left_keys) = *internal_node_key(parent_node, separator_index);
+    memcpy(internal_node_key(left_node, num_left_keys + 1), internal_node_key(right_node, 0),
+        num_right_keys * INTERNAL_NODE_KEY_SIZE);
+    memcpy(internal_node_child_pointer(left_node, num_left_keys + 1), internal_node_child_pointer(right_node, 0),
+        num_right_keys * INTERNAL_NODE_CHILD_POINTER_SIZE);
+    *internal_node_right_child_pointer(left_node) = *internal_node_right_child_pointer(right_node);
+    *internal_node_num_keys(left_node) = num_left_keys + 1 + num_right_keys;
+    adopt_children(pager, left_node, num_left_keys + 1, num_left_keys + 1 + num_right_keys);
+
+    _delete_key_from_internal_node(parent_node, separator_index);
+    mark_node_dirty(pager, left_node);
+    mark_node_dirty(pager, parent_node);
+    free_page(pager, right_node);
+    STATS_ADD(pager, internal_merges, 1);
+    unpin_node(pager, sibling_node);
+    rebalance_internal_node(pager, parent_node);
+}
+
+/**
+ * @brief This method fixes a leaf that has fewer than LEAF_NODE_MIN_CELLS cells after a delete
+ * It borrows a cell from a sibling under the same parent that can spare one, and updates the separator between
+ * them. Otherwise the two leaves are merged, and the separator is removed from the parent.
+ * 
+ * @param pager 
+ * @param node A latched leaf that is not the root
+ */
+void rebalance_leaf_node(Pager* pager, void* node) {
+    TRACE_DEBUG("Rebalancing the leaf node\n");
+    uint32_t child_index;
+    void* parent_node = get_parent_node(pager, node, &child_index);
+    latch_node(pager, parent_node);
+    uint32_t sibling_index;
+    void* sibling_node = get_sibling_for_rebalance(pager, parent_node, child_index, &sibling_index);
+    uint32_t num_sibling_cells = *leaf_node_num_cells(sibling_node);
+
+    if (num_sibling_cells > LEAF_NODE_MIN_CELLS) {
+        if (sibling_index < child_index) {
+            //  The last cell of the left sibling becomes the first cell of the node
+            uint32_t key = *leaf_node_key(sibling_node, num_sibling_cells - 1);
+            uint32_t value = *leaf_node_value(sibling_node, num_sibling_cells - 1);
+            _delete_key_from_leaf_node(sibling_node, num_sibling_cells - 1);
+            _insert_key_value_pair_to_leaf_node(node, key, value);
+            hash_index_invalidate(pager, key);
+            *internal_node_key(parent_node, sibling_index) = key;
+        } else {
+            //  The first cell of the right sibling becomes the last cell of the node
+            uint32_t key = *leaf_node_key(sibling_node, 0);
+            uint32_t value = *leaf_node_value(sibling_node, 0);
+            _delete_key_from_leaf_node(sibling_node, 0);
+            _insert_key_value_pair_to_leaf_node(node, key, value);
+            hash_index_invalidate(pager, key);
+            *internal_node_key(parent_node, child_index) = *leaf_node_key(sibling_node, 0);
+        }
+        mark_node_dirty(pager, node);
+        mark_node_dirty(pager, sibling_node);
+        mark_node_dirty(pager, parent_node);
+        unpin_node(pager, sibling_node);
+        STATS_ADD(pager, borrows, 1);
+        return;
+    }
+
+    //  Merge the right one of the two leaves into the left one and take it out of the sibling chain
+    void* left_node = sibling_index < child_index ? sibling_node : node;
+    void* right_node = sibling_index < child_index ? node : sibling_node;
+    uint32_t separator_index = sibling_index < child_index ? sibling_index : child_index;
+    uint32_t num_right_cells = *leaf_node_num_cells(right_node);
+    for (uint32_t i = 0; i < num_right_cells; i++) {
+        _insert_key_value_pair_to_leaf_node(left_node, *leaf_node_key(right_node, i), *leaf_node_value(right_node, i));
+        hash_index_invalidate(pager, *leaf_node_key(right_node, i));
+    }
+    uint32_t right_sibling_page_num = *leaf_node_right_sibling_pointer(right_node);
+    *leaf_node_right_sibling_pointer(left_node) = right_sibling_page_num;
+    if (right_sibling_page_num != INVALID_PAGE_NUM) {
+        void* right_sibling_node = get_page(pager, right_sibling_page_num);
+        latch_node(pager, right_sibling_node);
+        *leaf_node_left_sibling_pointer(right_sibling_node) = get_node_page_num(pager, left_node);
+        mark_node_dirty(pager, right_sibling_node);
+        unpin_node(pager, right_sibling_node);
+    }
+
+    _delete_key_from_internal_node(parent_node, separator_index);
+    mark_node_dirty(pager, left_node);
+    mark_node_dirty(pager, parent_node);
+    free_page(pager, right_node);
+    STATS_ADD(pager, leaf_merges, 1);
+    unpin_node(pager, sibling_node);
+    rebalance_internal_node(pager, parent_node);
+}
+
+/**
+ * @brief This method deletes a key from the tree with a single descent, rebalancing the leaf if it underflows
+ * 
+ * @param pager 
+ * @param key 
+ * @return int 1 if the key was deleted, -1 if it does not exist
+ */
+int bt_delete(Pager* pager, uint32_t key) {
+    uint64_t start_time = stats_operation_start(pager);
+    operation_trace_record(pager, TRACED_DELETE, key, 0);
+    begin_operation(pager);
+    void* node = descend_to_leaf(pager, key, 0);
+    if (*(char*)node_initialized(node) != NODE_INITIALIZED) {
+        release_path(pager);
+        end_operation(pager);
+        stats_operation_finish(pager, OPERATION_DELETE, start_time);
+        return -1;
+    }
+
+    //  Check if the key exists, no other writer can remove it while this operation holds the write latch
+    uint32_t key_index = binary_search(node, key);
+    if (key_index >= *leaf_node_num_cells(node) || *leaf_node_key(node, key_index) != key) {
+        release_path(pager);
+        end_operation(pager);
+        stats_operation_finish(pager, OPERATION_DELETE, start_time);
+        return -1;
+    }
+
+    latch_node(pager, node);
+    _delete_key_from_leaf_node(node, key_index);
+    wal_log_leaf_delete(pager, node, key);
+    hash_index_remove(pager, key);
+    if (*(uint8_t*)node_is_root(node) == 0 && *leaf_node_num_cells(node) < LEAF_NODE_MIN_CELLS) {
+        rebalance_leaf_node(pager, node);
+    }
+    release_path(pager);
+    end_operation(pager);
+    stats_operation_finish(pager, OPERATION_DELETE, start_time);
+    return 1;
+}
+
+void delete(Pager* pager, uint32_t key) {
+    TRACE_DEBUG("****\n");
+    TRACE_DEBUG("Deleting key %d\n", key);
+    if (bt_delete(pager, key) == -1) {
+        TRACE_DEBUG("The key does not exist\n");
+    }
+    TRACE_DEBUG("Done deleting key %d\n", key);
+    TRACE_DEBUG("****\n");
+}
+
+void initialize_leaf_node(void* node) {
+    TRACE_DEBUG("Initializing the node as a leaf node\n");
+    *(uint32_t*)node = LEAF_NODE;
+    *(char*)node_initialized(node) = NODE_INITIALIZED;
+    *(uint8_t*)node_is_root(node) = 0;
+    *(uint32_t*)node_parent_pointer(node) = 0;
+    *node_free_block_offset(node) = 0;
+    *node_lsn(node) = 0;
+    *(uint32_t*)leaf_node_num_cells(node) = 0;
+    *leaf_node_right_sibling_pointer(node) = INVALID_PAGE_NUM;
+    *leaf_node_left_sibling_pointer(node) = INVALID_PAGE_NUM;
+    *leaf_node_cell_content_start(node) = PAGE_SIZE;
+    TRACE_DEBUG("Done initializing the leaf node\n");
+    TRACE_DEBUG("***\n");
+}
+
+void initialize_internal_node(void* node) {
+    TRACE_DEBUG("Initializing the node as an internal node\n");
+    *(uint32_t*)node = INTERNAL_NODE;
+    *(char*)node_initialized(node) = NODE_INITIALIZED;
+    *(uint8_t*)node_is_root(node) = 0;
+    *(uint32_t*)node_parent_pointer(node) = 0;
+    *node_free_block_offset(node) = 0;
+    *node_lsn(node) = 0;
+    *(uint32_t*)internal_node_num_keys(node) = 0;
+    TRACE_DEBUG("Done initializing the internal node\n");
+}
+
+/**
+ * @brief This method returns whether a node on the path of the current operation is the rightmost node of its
+ * level, which it is when every node above it on the path has it under its right child
+ * 
+ * @param pager 
+ * @param node 
  * @return int 
  */
-int binary_search_modify_pointer(void** node, uint32_t key) {
-    int node_type = check_type_of_node(*node);
-    uint32_t num_cells;
-    if (node_type == LEAF_NODE) {
-        num_cells = *(uint32_t*)leaf_node_num_cells(*node);
-    } else if (node_type == INTERNAL_NODE) {
-        num_cells = *(uint32_t*)internal_node_num_keys(*node);
+int is_on_right_edge(Pager* pager, void* node) {
+    TreePath* path = &pager->path;
+    for (uint32_t level = get_path_level(pager, node); level > 0; level--) {
+        if (path->child_indices[level] != *internal_node_num_keys(path->nodes[level - 1])) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief This method splits a full internal node while inserting a key and the child to its right
+ * The lower half of the keys stays in the node, the upper half moves to the sibling and the middle key
+ * is removed from both so that it can be promoted to the parent. An append on the right edge of the tree keeps
+ * the node full instead. Swizzled children that moved to the sibling point back at it.
+ * 
+ * @param pager 
+ * @param node 
+ * @param sibling_node 
+ * @param key 
+ * @param child_node 
+ * @return uint32_t The key to promote
+ */
+uint32_t split_internal_node(Pager* pager, void* node, void* sibling_node, uint32_t key, void* child_node) {
+    TRACE_DEBUG("****\n");
+    TRACE_DEBUG("Splitting the internal node\n");
+    STATS_ADD(pager, internal_splits, 1);
+
+    initialize_internal_node(sibling_node);
+
+    //  Lay out the keys and children of the node with the new key and child in place
+    uint32_t num_keys = *(uint32_t*)internal_node_num_keys(node);
+    uint32_t key_index = binary_search(node, key);
+    uint32_t* keys = malloc((num_keys + 1) * sizeof(uint32_t));
+    uint32_t* children = malloc((num_keys + 2) * sizeof(uint32_t));
+    for (uint32_t i = 0, j = 0; i <= num_keys; i++, j++) {
+        if (i == key_index) {
+            keys[j] = key;
+            children[j] = *internal_node_child_at(node, i);
+            children[++j] = get_node_page_num(pager, child_node);
+            if (i < num_keys) {
+                keys[j] = *internal_node_key(node, i);
+            }
+            continue;
+        }
+        if (i < num_keys) {
+            keys[j] = *internal_node_key(node, i);
+        }
+        children[j] = *internal_node_child_at(node, i);
+    }
+
+    //  On the right edge of the tree, a new largest key leaves the node full and starts the sibling with the
+    //  new key and the two children around it, for the same reason as in split_leaf_node()
+    uint32_t total_keys = num_keys + 1;
+    uint32_t middle_index = total_keys / 2;
+    if (key_index == num_keys && is_on_right_edge(pager, node)) {
+        middle_index = total_keys - 2;
+    }
+    uint32_t key_to_promote = keys[middle_index];
+    TRACE_DEBUG("The key to promote is %d\n", key_to_promote);
+
+    //  The lower half stays in the node
+    for (uint32_t i = 0; i < middle_index; i++) {
+        *internal_node_child_pointer(node, i) = children[i];
+        *internal_node_key(node, i) = keys[i];
+    }
+    *internal_node_right_child_pointer(node) = children[middle_index];
+    *(uint32_t*)internal_node_num_keys(node) = middle_index;
+
+    //  The upper half moves to the sibling
+    uint32_t num_sibling_keys = total_keys - middle_index - 1;
+    for (uint32_t i = 0; i < num_sibling_keys; i++) {
+        *internal_node_child_pointer(sibling_node, i) = children[middle_index + 1 + i];
+        *internal_node_key(sibling_node, i) = keys[middle_index + 1 + i];
+    }
+    *internal_node_right_child_pointer(sibling_node) = children[total_keys];
+    *(uint32_t*)internal_node_num_keys(sibling_node) = num_sibling_keys;
+
+    adopt_children(pager, sibling_node, 0, num_sibling_keys);
+
+    free(keys);
+    free(children);
+    TRACE_DEBUG("****\n");
+    return key_to_promote;
+}
+
+/**
+ * @brief This method returns the parent of a node that is about to split from the path of the current operation
+ * If the node is the root, a new internal root is created with the node as its right child, and it is put at
+ * the top of the path
+ * 
+ * @param pager 
+ * @param node 
+ * @return void* 
+ */
+void* get_or_create_parent_node(Pager* pager, void* node) {
+    uint32_t child_index;
+    if (*(uint8_t*)node_is_root(node) == 0) {
+        return get_parent_node(pager, node, &child_index);
+    }
+
+    TRACE_DEBUG("Creating a new root\n");
+    STATS_ADD(pager, root_splits, 1);
+    void* new_root = allocate_page(pager);
+    latch_node(pager, new_root);
+    initialize_internal_node(new_root);
+    uint32_t new_root_page_num = get_node_page_num(pager, new_root);
+    *(uint8_t*)node_is_root(new_root) = 1;
+    *internal_node_right_child_pointer(new_root) = get_node_page_num(pager, node);
+    *(uint8_t*)node_is_root(node) = 0;
+    set_root_page(pager, new_root_page_num);
+    mark_node_dirty(pager, new_root);
+    push_root_onto_path(pager, new_root);
+    return new_root;
+}
+
+/**
+ * @brief This method puts a new root at the top of the path of the current operation, above the old root
+ * 
+ * @param pager 
+ * @param new_root 
+ */
+void push_root_onto_path(Pager* pager, void* new_root) {
+    TreePath* path = &pager->path;
+    if (path->depth == MAX_TREE_HEIGHT) {
+        fprintf(stderr, "The tree is more than %d levels deep\n", MAX_TREE_HEIGHT);
+        exit(EXIT_FAILURE);
+    }
+    memmove(&path->nodes[1], &path->nodes[0], path->depth * sizeof(void*));
+    memmove(&path->child_indices[1], &path->child_indices[0], path->depth * sizeof(uint32_t));
+    path->nodes[0] = new_root;
+    path->child_indices[0] = 0;
+    path->child_indices[1] = 0;
+    path->depth++;
+}
+
+void split_leaf_node(Pager* pager, void* node, void* sibling_node, uint32_t key, uint32_t value) {
+    TRACE_DEBUG("****\n");
+    TRACE_DEBUG("Splitting the leaf node\n");
+    STATS_ADD(pager, leaf_splits, 1);
+
+    TRACE_DEBUG("The new node is %p\n", sibling_node);
+
+    //  Initialize the new node
+    initialize_leaf_node(sibling_node);
+    //  Both nodes are logged as whole pages, so the cells that are copied below do not need records of their own
+    mark_node_dirty(pager, node);
+    mark_node_dirty(pager, sibling_node);
+
+    //  Link the new node into the sibling chain to the right of the node
+    uint32_t page_num = get_node_page_num(pager, node);
+    uint32_t sibling_page_num = get_node_page_num(pager, sibling_node);
+    uint32_t right_sibling_page_num = *leaf_node_right_sibling_pointer(node);
+    *leaf_node_left_sibling_pointer(sibling_node) = page_num;
+    *leaf_node_right_sibling_pointer(sibling_node) = right_sibling_page_num;
+    *leaf_node_right_sibling_pointer(node) = sibling_page_num;
+    if (right_sibling_page_num != INVALID_PAGE_NUM) {
+        void* right_sibling_node = get_page(pager, right_sibling_page_num);
+        latch_node(pager, right_sibling_node);
+        *leaf_node_left_sibling_pointer(right_sibling_node) = sibling_page_num;
+        mark_node_dirty(pager, right_sibling_node);
+        unpin_node(pager, right_sibling_node);
+    }
+
+    //  Copy the second half of the keys and their corresponding values to the new node
+    uint32_t num_cells = *(uint32_t*)leaf_node_num_cells(node);
+    TRACE_DEBUG("The number of cells is %d\n", num_cells);
+
+    //  An append to the rightmost leaf leaves the node full and starts the new node with the new key alone, so
+    //  that keys that only grow fill their leaves instead of leaving every one of them half empty
+    int is_append = right_sibling_page_num == INVALID_PAGE_NUM && key > *leaf_node_key(node, num_cells - 1);
+    uint32_t start_index_of_cells_to_move = is_append ? num_cells : num_cells / 2;
+    TRACE_DEBUG("The number of cells to move is %d\n", num_cells - start_index_of_cells_to_move);
+
+    for (int i = start_index_of_cells_to_move; i < num_cells; i++) {
+        uint32_t key = *leaf_node_key(node, i);
+        uint32_t value = *leaf_node_value(node, i);
+        TRACE_DEBUG("Copying the key: %d\n", key);
+        TRACE_DEBUG("Copying the value: %d\n", value);
+        _insert(pager, sibling_node, key, value);
+        hash_index_invalidate(pager, key);
+    }
+
+    //  Drop the cells that moved and compact the values of the cells that stayed
+    if (!is_append) {
+        *(uint32_t*)leaf_node_num_cells(node) = start_index_of_cells_to_move;
+        compact_leaf_node(node);
+    }
+
+    //  Insert the new key and value into one of the nodes
+    if (!is_append && key <= *leaf_node_key(sibling_node, 0)) {
+        TRACE_DEBUG("Inserting the key %d into the original node\n", key);
+        _insert(pager, node, key, value);
+    } else {
+        TRACE_DEBUG("Inserting the key %d into the new node\n", key);
+        _insert(pager, sibling_node, key, value);
+    }
+    return;
+}
+
+/**
+ * @brief This method inserts a key into an internal node after the child to the left of the key has split
+ * The child that split stays to the left of the new key and the new child is placed to its right
+ * 
+ * @param node 
+ * @param key 
+ * @param child_pointer The page number of the new child
+ */
+void _insert_key_value_pair_to_internal_node(void* node, uint32_t key, uint32_t child_pointer) {
+    uint32_t num_keys = *(uint32_t*)internal_node_num_keys(node);
+    TRACE_DEBUG("The number of keys is %d\n", num_keys);
+
+    uint32_t key_index = binary_search(node, key);
+    TRACE_DEBUG("The key index is %d\n", key_index);
+
+    uint32_t left_child_pointer = *internal_node_child_at(node, key_index);
+    uint32_t num_of_cells_to_move = num_keys - key_index;
+    TRACE_DEBUG("The number of cells to move is %d\n", num_of_cells_to_move);
+
+    //  The keys and the child pointers live in separate arrays, so both are shifted by one
+    memmove(internal_node_key(node, key_index + 1), internal_node_key(node, key_index), num_of_cells_to_move * INTERNAL_NODE_KEY_SIZE);
+    memmove(internal_node_child_pointer(node, key_index + 1), internal_node_child_pointer(node, key_index),
+        num_of_cells_to_move * INTERNAL_NODE_CHILD_POINTER_SIZE);
+
+    //  Insert the new key and child pointer
+    *internal_node_child_pointer(node, key_index) = left_child_pointer;
+    *internal_node_key(node, key_index) = key;
+
+    //  Update the number of keys
+    *(uint32_t*)internal_node_num_keys(node) = num_keys + 1;
+    *internal_node_child_at(node, key_index + 1) = child_pointer;
+}
+
+void _insert_key_value_pair_to_leaf_node(void* node, uint32_t key, uint32_t value) {
+    uint32_t num_cells = *(uint32_t*)leaf_node_num_cells(node);
+    TRACE_DEBUG("The number of cells is %d\n", num_cells);
+
+    uint32_t key_index = binary_search(node, key);
+    TRACE_DEBUG("The key index is %d\n", key_index);
+
+    uint32_t num_of_cells_to_move = num_cells - key_index;
+    TRACE_DEBUG("The number of cells to move is %d\n", num_of_cells_to_move);
+
+    //  Allocate the value before the cells move, since allocation may compact the node
+    uint16_t value_offset = leaf_node_allocate_value(node, LEAF_NODE_VALUE_SIZE);
+
+    //  The keys and the value offsets live in separate arrays, so both are shifted by one
+    memmove(leaf_node_key(node, key_index + 1), leaf_node_key(node, key_index), num_of_cells_to_move * LEAF_NODE_KEY_SIZE);
+    memmove(leaf_node_value_offset(node, key_index + 1), leaf_node_value_offset(node, key_index),
+        num_of_cells_to_move * LEAF_NODE_VALUE_OFFSET_SIZE);
+
+    *(uint32_t*)leaf_node_key(node, key_index) = key;
+    TRACE_DEBUG("Set the key as %d\n", key);
+
+    *leaf_node_value_offset(node, key_index) = value_offset;
+    *leaf_node_value(node, key_index) = value;
+    TRACE_DEBUG("Set the value as %d\n", value);
+
+    *(uint32_t*)leaf_node_num_cells(node) = num_cells + 1;
+    TRACE_DEBUG("\n");
+    return;
+}
+
+void _insert_into_internal(Pager* pager, void* node, uint32_t key, void* child_node) {
+    latch_node(pager, node);
+    uint32_t num_keys = *(uint32_t*)internal_node_num_keys(node);
+    TRACE_DEBUG("The number of keys is %d\n", num_keys);
+
+    //  Check if the node needs to be split
+    if (num_keys < INTERNAL_NODE_MAX_KEYS) {
+        TRACE_DEBUG("The internal node does not need to be split\n");
+        _insert_key_value_pair_to_internal_node(node, key, get_node_page_num(pager, child_node));
+        mark_node_dirty(pager, node);
+        return;
+    }
+
+    //  The node needs to be split
+    void* parent_node = get_or_create_parent_node(pager, node);
+
+    TRACE_DEBUG("The internal node needs to be split\n");
+    void* sibling_node = allocate_page(pager);
+    latch_node(pager, sibling_node);
+    uint32_t key_to_promote = split_internal_node(pager, node, sibling_node, key, child_node);
+    _insert(pager, parent_node, key_to_promote, sibling_node);
+
+    mark_node_dirty(pager, node);
+    mark_node_dirty(pager, sibling_node);
+    unpin_node(pager, sibling_node);
+    return;
+}
+
+void _insert_into_leaf(Pager* pager, void* node, uint32_t key, uint32_t value) {
+    latch_node(pager, node);
+    uint32_t num_cells = *(uint32_t*)leaf_node_num_cells(node);
+    TRACE_DEBUG("The number of cells is %d\n", num_cells);
+
+    //  Check if the node needs to be split
+    if (num_cells < LEAF_NODE_MAX_CELLS) {
+        //  this leaf node does not need to be split
+        TRACE_DEBUG("The leaf node does not need to be split\n");
+        _insert_key_value_pair_to_leaf_node(node, key, value);
+        wal_log_leaf_insert(pager, node, key, value);
+        return;
+    }
+
+    //  The node needs to split
+    TRACE_DEBUG("The leaf node needs to be split\n");
+    void* parent_node = get_or_create_parent_node(pager, node);
+
+    void* sibling_node = allocate_page(pager);
+    latch_node(pager, sibling_node);
+    split_leaf_node(pager, node, sibling_node, key, value);
+
+    //  The separator is the first key of the new sibling, which goes to the right of it in the parent
+    uint32_t key_to_promote = *leaf_node_key(sibling_node, 0);
+    _insert(pager, parent_node, key_to_promote, sibling_node);
+
+    mark_node_dirty(pager, node);
+    mark_node_dirty(pager, sibling_node);
+    unpin_node(pager, sibling_node);
+    return;
+}
+
+void insert(Pager* pager, uint32_t key, uint32_t value) {
+    uint64_t start_time = stats_operation_start(pager);
+    operation_trace_record(pager, TRACED_INSERT, key, value);
+    begin_operation(pager);
+    void* node = descend_to_leaf_for_insert(pager, key);
+    _insert(pager, node, key, value);
+    release_path(pager);
+    end_operation(pager);
+    stats_operation_finish(pager, OPERATION_INSERT, start_time);
+    return;
+}
+
+/**
+ * @brief This method inserts a key or replaces its value if it exists, with a single descent
+ * 
+ * @param pager 
+ * @param key 
+ * @param value 
+ * @return int 1 if the key was inserted, 0 if its value was replaced
+ */
+int bt_upsert(Pager* pager, uint32_t key, uint32_t value) {
+    uint64_t start_time = stats_operation_start(pager);
+    operation_trace_record(pager, TRACED_UPSERT, key, value);
+    begin_operation(pager);
+    void* node = descend_to_leaf_for_insert(pager, key);
+    uint32_t key_index = binary_search(node, key);
+    if (key_index < *leaf_node_num_cells(node) && *leaf_node_key(node, key_index) == key) {
+        latch_node(pager, node);
+        *leaf_node_value(node, key_index) = value;
+        wal_log_leaf_update(pager, node, key, value);
+        release_path(pager);
+        end_operation(pager);
+        stats_operation_finish(pager, OPERATION_INSERT, start_time);
+        return 0;
+    }
+    _insert(pager, node, key, value);
+    release_path(pager);
+    end_operation(pager);
+    stats_operation_finish(pager, OPERATION_INSERT, start_time);
+    return 1;
+}
+
+/**
+ * @brief This method inserts a key unless it exists already, with a single descent
+ * 
+ * @param pager 
+ * @param key 
+ * @param value 
+ * @return int 1 if the key was inserted, -1 if it exists
+ */
+int bt_insert_if_absent(Pager* pager, uint32_t key, uint32_t value) {
+    uint64_t start_time = stats_operation_start(pager);
+    operation_trace_record(pager, TRACED_INSERT_IF_ABSENT, key, value);
+    begin_operation(pager);
+    void* node = descend_to_leaf_for_insert(pager, key);
+    uint32_t key_index = binary_search(node, key);
+    int exists = key_index < *leaf_node_num_cells(node) && *leaf_node_key(node, key_index) == key;
+    if (!exists) {
+        _insert(pager, node, key, value);
+    }
+    release_path(pager);
+    end_operation(pager);
+    stats_operation_finish(pager, OPERATION_INSERT, start_time);
+    return exists ? -1 : 1;
+}
+
+/**
+ * Bulk loading
+ * Sorted entries are packed straight into leaves, left to right. Every level of the tree has one open node
+ * on its right edge. When a node is complete it is written out right away, so pages are written in roughly the
+ * order they were allocated, but it is only attached to the open node one level up once the next node of its
+ * level is complete. A parent that a full parent makes room for therefore always gets a second child. The last
+ * node of a level is attached to the open parent even past the fill factor, and a parent without room left hands
+ * its rightmost child over to a new parent instead. Every internal node ends up with at least two children, and
+ * the last open node at the top becomes the root.
+ */
+typedef struct {
+    Pager* pager;
+    uint32_t leaf_capacity;
+    uint32_t internal_capacity;
+    uint32_t num_levels;
+    void* open_nodes[BULK_LOAD_MAX_LEVELS];
+    uint32_t open_node_first_keys[BULK_LOAD_MAX_LEVELS];
+    uint32_t open_node_num_children[BULK_LOAD_MAX_LEVELS];
+    uint32_t held_page_nums[BULK_LOAD_MAX_LEVELS];
+    uint32_t held_first_keys[BULK_LOAD_MAX_LEVELS];
+} BulkLoader;
+
+void bulk_load_finish_node(BulkLoader* loader, uint32_t level, int is_last);
+
+/**
+ * @brief This method makes a completed node the rightmost child of the open node one level up
+ * 
+ * @param loader 
+ * @param level The level of the completed node
+ * @param page_num 
+ * @param first_key The smallest key under the completed node
+ * @param is_last Whether the node is the last one on its level
+ */
+void bulk_load_attach_to_parent(BulkLoader* loader, uint32_t level, uint32_t page_num, uint32_t first_key,
+    int is_last) {
+    Pager* pager = loader->pager;
+    uint32_t parent_level = level + 1;
+    if (parent_level >= BULK_LOAD_MAX_LEVELS) {
+        fprintf(stderr, "The bulk loaded tree is more than %d levels deep\n", BULK_LOAD_MAX_LEVELS);
+        exit(EXIT_FAILURE);
+    }
+
+    void* parent_node = loader->open_nodes[parent_level];
+    if (parent_node != NULL && !is_last && *internal_node_num_keys(parent_node) == loader->internal_capacity) {
+        //  The full parent can be completed now that it is known not to be the last one on its level, and the
+        //  node held back on this level follows this one into the new parent
+        bulk_load_finish_node(loader, parent_level, 0);
+        parent_node = NULL;
+    } else if (parent_node != NULL && *internal_node_num_keys(parent_node) == INTERNAL_NODE_MAX_KEYS) {
+        //  The last node has no room left, so it goes to a new parent together with the rightmost child
+        uint32_t num_keys = *internal_node_num_keys(parent_node);
+        uint32_t moved_page_num = *internal_node_right_child_pointer(parent_node);
+        uint32_t moved_first_key = *internal_node_key(parent_node, num_keys - 1);
+        *internal_node_right_child_pointer(parent_node) = *internal_node_child_pointer(parent_node, num_keys - 1);
+        *internal_node_num_keys(parent_node) = num_keys - 1;
+        loader->open_node_num_children[parent_level]--;
+        bulk_load_finish_node(loader, parent_level, 0);
+        bulk_load_attach_to_parent(loader, level, moved_page_num, moved_first_key, 0);
+        parent_node = loader->open_nodes[parent_level];
+    }
+    if (parent_node == NULL) {
+        parent_node = allocate_page(pager);
+        initialize_internal_node(parent_node);
+        loader->open_nodes[parent_level] = parent_node;
+        loader->open_node_first_keys[parent_level] = first_key;
+        loader->open_node_num_children[parent_level] = 0;
+        if (parent_level + 1 > loader->num_levels) {
+            loader->num_levels = parent_level + 1;
+        }
+    }
+
+    if (loader->open_node_num_children[parent_level] > 0) {
+        //  The current right child moves into the child array, separated from the new child by its first key
+        uint32_t num_keys = *internal_node_num_keys(parent_node);
+        *internal_node_child_pointer(parent_node, num_keys) = *internal_node_right_child_pointer(parent_node);
+        *internal_node_key(parent_node, num_keys) = first_key;
+        *internal_node_num_keys(parent_node) = num_keys + 1;
+    }
+    *internal_node_right_child_pointer(parent_node) = page_num;
+    loader->open_node_num_children[parent_level]++;
+}
+
+/**
+ * @brief This method completes the open node of a level and writes it out. The node held back on the level is
+ * attached to the open node one level up, and this one is held back in its place, or attached too if it is the
+ * last. The last node of a level that nothing was held back on becomes the root instead.
+ * 
+ * @param loader 
+ * @param level 
+ * @param is_last 
+ */
+void bulk_load_finish_node(BulkLoader* loader, uint32_t level, int is_last) {
+    Pager* pager = loader->pager;
+    void* node = loader->open_nodes[level];
+    uint32_t page_num = get_node_page_num(pager, node);
+    uint32_t first_key = loader->open_node_first_keys[level];
+    loader->open_nodes[level] = NULL;
+
+    if (is_last && loader->held_page_nums[level] == INVALID_PAGE_NUM) {
+        *(uint8_t*)node_is_root(node) = 1;
+        pager_flush(pager, page_num, PAGE_SIZE);
+        //  The pages went straight to the data file, so they have to be durable before the root that makes them
+        //  reachable is logged
+        if (pager->wal != NULL && fdatasync(pager->file_descriptor) == -1) {
+            fprintf(stderr, "Error syncing the database file\n");
+            exit(EXIT_FAILURE);
+        }
+        set_root_page(pager, page_num);
+        unpin_node(pager, node);
+        return;
+    }
+
+    if (loader->held_page_nums[level] != INVALID_PAGE_NUM) {
+        bulk_load_attach_to_parent(loader, level, loader->held_page_nums[level], loader->held_first_keys[level], 0);
+        loader->held_page_nums[level] = INVALID_PAGE_NUM;
+    }
+    if (is_last) {
+        bulk_load_attach_to_parent(loader, level, page_num, first_key, 1);
+    } else {
+        loader->held_page_nums[level] = page_num;
+        loader->held_first_keys[level] = first_key;
+    }
+    pager_flush(pager, page_num, PAGE_SIZE);
+    unpin_node(pager, node);
+}
+
+/**
+ * @brief This method builds the tree from entries that are sorted by key, bottom-up
+ * The tree has to be empty. Leaves and internal nodes are filled to fill_factor of their capacity, which leaves
+ * room for later inserts before the nodes have to split.
+ * 
+ * @param pager 
+ * @param iterator Returns the entries in strictly increasing key order
+ * @param fill_factor The fraction of each node to fill, greater than 0 and at most 1
+ */
+void bulk_load(Pager* pager, BulkLoadIterator* iterator, double fill_factor) {
+    if (fill_factor <= 0 || fill_factor > 1) {
+        fprintf(stderr, "The fill factor has to be greater than 0 and at most 1\n");
+        exit(EXIT_FAILURE);
+    }
+    //  The load is one operation, but the nodes it builds are not reachable before the root is set, so they
+    //  are neither latched nor logged
+    begin_operation(pager);
+    //  The leaves of the load are filled before they are latched, so no entry may lead into them
+    hash_index_clear(pager);
+    uint32_t empty_root_page_num = pager->root_page_num;
+    void* root_node = get_page(pager, empty_root_page_num);
+    int is_empty = *(char*)node_initialized(root_node) != NODE_INITIALIZED;
+    unpin_node(pager, root_node);
+    if (!is_empty) {
+        fprintf(stderr, "Bulk loading needs an empty tree\n");
+        exit(EXIT_FAILURE);
+    }
+
+    BulkLoader loader;
+    loader.pager = pager;
+    loader.leaf_capacity = (uint32_t)(fill_factor * LEAF_NODE_MAX_CELLS);
+    loader.internal_capacity = (uint32_t)(fill_factor * INTERNAL_NODE_MAX_KEYS);
+    if (loader.leaf_capacity == 0) {
+        loader.leaf_capacity = 1;
+    }
+    if (loader.internal_capacity == 0) {
+        loader.internal_capacity = 1;
+    }
+    loader.num_levels = 1;
+    for (uint32_t i = 0; i < BULK_LOAD_MAX_LEVELS; i++) {
+        loader.open_nodes[i] = NULL;
+        loader.open_node_first_keys[i] = 0;
+        loader.open_node_num_children[i] = 0;
+        loader.held_page_nums[i] = INVALID_PAGE_NUM;
+        loader.held_first_keys[i] = 0;
+    }
+
+    uint32_t key;
+    uint32_t value;
+    uint32_t previous_key = 0;
+    uint64_t num_entries = 0;
+    while (iterator->next(iterator->context, &key, &value)) {
+        if (num_entries > 0 && key <= previous_key) {
+            fprintf(stderr, "Bulk load keys have to be strictly increasing, got %u after %u\n", key, previous_key);
+            exit(EXIT_FAILURE);
+        }
+
+        void* leaf_node = loader.open_nodes[0];
+        if (leaf_node == NULL || *leaf_node_num_cells(leaf_node) == loader.leaf_capacity) {
+            void* new_leaf_node = allocate_page(pager);
+            initialize_leaf_node(new_leaf_node);
+            if (leaf_node != NULL) {
+                uint32_t new_leaf_page_num = get_node_page_num(pager, new_leaf_node);
+                *leaf_node_right_sibling_pointer(leaf_node) = new_leaf_page_num;
+                *leaf_node_left_sibling_pointer(new_leaf_node) = get_node_page_num(pager, leaf_node);
+                bulk_load_finish_node(&loader, 0, 0);
+            }
+            leaf_node = new_leaf_node;
+            loader.open_nodes[0] = leaf_node;
+            loader.open_node_first_keys[0] = key;
+        }
+
+        //  Append the entry, the values are packed from the back of the page without going through the free list
+        uint32_t cell_num = *leaf_node_num_cells(leaf_node);
+        *leaf_node_cell_content_start(leaf_node) -= LEAF_NODE_VALUE_SIZE;
+        *leaf_node_key(leaf_node, cell_num) = key;
+        *leaf_node_value_offset(leaf_node, cell_num) = *leaf_node_cell_content_start(leaf_node);
+        *leaf_node_value(leaf_node, cell_num) = value;
+        *leaf_node_num_cells(leaf_node) = cell_num + 1;
+
+        previous_key = key;
+        num_entries++;
+    }
+
+    if (num_entries == 0) {
+        end_operation(pager);
+        return;
+    }
+    //  Complete the right edge from the bottom up, the last open node becomes the root
+    for (uint32_t level = 0; level < loader.num_levels; level++) {
+        if (loader.open_nodes[level] != NULL) {
+            bulk_load_finish_node(&loader, level, 1);
+        }
+    }
+    //  The tree was built on new pages, so the empty root it replaced goes on the free list
+    root_node = get_page(pager, empty_root_page_num);
+    free_page(pager, root_node);
+    unpin_node(pager, root_node);
+    end_operation(pager);
+    TRACE_INFO("Bulk loaded %lu entries into a tree of height %d\n", num_entries, loader.num_levels);
+}
+
+/**
+ * Key search kernels
+ * A node is searched by narrowing the key array down to at most KEY_SEARCH_LINEAR_THRESHOLD keys with a
+ * branchless binary search, and then counting the keys in that window that are smaller than the search key.
+ * The counting is done with AVX2 or SSE4.2 compares when the CPU supports them.
+ */
+#define KEY_SEARCH_LINEAR_THRESHOLD 32
+
+uint32_t count_keys_less_than_scalar(const uint32_t* keys, uint32_t num_keys, uint32_t key) {
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < num_keys; i++) {
+        count += keys[i] < key;
+    }
+    return count;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+/*
+ * There is no unsigned 32-bit compare before AVX-512, so both sides are shifted into the signed range by
+ * flipping the sign bit, which keeps their order
+ */
+__attribute__((target("sse4.2")))
+uint32_t count_keys_less_than_sse42(const uint32_t* keys, uint32_t num_keys, uint32_t key) {
+    const __m128i sign_bit = _mm_set1_epi32((int)0x80000000u);
+    const __m128i search_key = _mm_xor_si128(_mm_set1_epi32((int)key), sign_bit);
+    uint32_t count = 0;
+    uint32_t i = 0;
+    for (; i + 4 <= num_keys; i += 4) {
+        __m128i block = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(keys + i)), sign_bit);
+        __m128i is_less = _mm_cmpgt_epi32(search_key, block);
+        count += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(is_less)));
+    }
+    return count + count_keys_less_than_scalar(keys + i, num_keys - i, key);
+}
+
+__attribute__((target("avx2")))
+uint32_t count_keys_less_than_avx2(const uint32_t* keys, uint32_t num_keys, uint32_t key) {
+    const __m256i sign_bit = _mm256_set1_epi32((int)0x80000000u);
+    const __m256i search_key = _mm256_xor_si256(_mm256_set1_epi32((int)key), sign_bit);
+    uint32_t count = 0;
+    uint32_t i = 0;
+    for (; i + 8 <= num_keys; i += 8) {
+        __m256i block = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(keys + i)), sign_bit);
+        __m256i is_less = _mm256_cmpgt_epi32(search_key, block);
+        count += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(is_less)));
+    }
+    return count + count_keys_less_than_scalar(keys + i, num_keys - i, key);
+}
+#endif
+
+typedef uint32_t (*CountKeysFunction)(const uint32_t* keys, uint32_t num_keys, uint32_t key);
+
+CountKeysFunction count_keys_less_than = NULL;
+KeySearchKernel active_key_search_kernel = KEY_SEARCH_AUTO;
+
+/**
+ * @brief This method picks the kernel used to count keys. KEY_SEARCH_AUTO picks the widest one that CPUID reports,
+ * and asking for a kernel the CPU does not support falls back to the scalar one
+ * 
+ * @param kernel 
+ */
+void set_key_search_kernel(KeySearchKernel kernel) {
+    count_keys_less_than = count_keys_less_than_scalar;
+    active_key_search_kernel = KEY_SEARCH_SCALAR;
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if ((kernel == KEY_SEARCH_AUTO || kernel == KEY_SEARCH_AVX2) && __builtin_cpu_supports("avx2")) {
+        count_keys_less_than = count_keys_less_than_avx2;
+        active_key_search_kernel = KEY_SEARCH_AVX2;
+    } else if ((kernel == KEY_SEARCH_AUTO || kernel == KEY_SEARCH_SSE42) && __builtin_cpu_supports("sse4.2")) {
+        count_keys_less_than = count_keys_less_than_sse42;
+        active_key_search_kernel = KEY_SEARCH_SSE42;
+    }
+#endif
+}
+
+KeySearchKernel get_key_search_kernel() {
+    if (count_keys_less_than == NULL) {
+        set_key_search_kernel(KEY_SEARCH_AUTO);
+    }
+    return active_key_search_kernel;
+}
+
+/**
+ * @brief This method returns the index of the first key that is not smaller than the search key
+ * 
+ * @param keys A sorted array of keys
+ * @param num_keys 
+ * @param key 
+ * @return uint32_t 
+ */
+uint32_t key_lower_bound(const uint32_t* keys, uint32_t num_keys, uint32_t key) {
+    if (count_keys_less_than == NULL) {
+        set_key_search_kernel(KEY_SEARCH_AUTO);
+    }
+    //  The answer always lies in [base, base + num_keys]
+    uint32_t base = 0;
+    uint32_t steps = 0;
+    while (num_keys > KEY_SEARCH_LINEAR_THRESHOLD) {
+        uint32_t half = num_keys / 2;
+        base = keys[base + half - 1] < key ? base + half : base;
+        num_keys -= half;
+        steps++;
+    }
+    STATS_COUNT(key_comparisons, steps + num_keys);
+    return base + count_keys_less_than(keys + base, num_keys, key);
+}
+
+/**
+ * @brief This method searches for a key within a single node
+ * For a leaf node it returns the index of the key, or the index it would be inserted at
+ * For an internal node it returns the index of the child that covers the key. Keys equal to a separator
+ * live to its right, so this is the index of the first separator that is greater than the key
+ * 
+ * @param node 
+ * @param key 
+ * @return int 
+ */
+int binary_search(void* node, uint32_t key) {
+    int node_type = check_type_of_node(node);
+    if (node_type == LEAF_NODE) {
+        return key_lower_bound(leaf_node_key(node, 0), *leaf_node_num_cells(node), key);
+    }
+
+    //  The child to follow is the one left of the first separator that is greater than the key
+    uint32_t num_keys = *internal_node_num_keys(node);
+    if (key == UINT32_MAX) {
+        return num_keys;
+    }
+    return key_lower_bound(internal_node_key(node, 0), num_keys, key + 1);
+}
+
+
+/**
+ * @brief This method descends to the leaf that covers a key without pinning or latching anything
+ * Every node is read optimistically. A child pointer is only followed once the version of its node shows that
+ * the pointer was read from a consistent node, and the version of the child is taken before that check, so the
+ * child is the node the pointer referred to. Counts read from a node that is being changed are clamped before
+ * they are used, since the node is only known to be consistent after its version has been validated.
+ * 
+ * @param pager 
+ * @param key 
+ * @param version The version of the leaf, which the caller validates after reading it
+ * @param parent_frame_index The frame of the parent of the leaf, or -1 if the leaf is the root
+ * @param parent_version The version of the parent when the child index was read
+ * @param child_index The index of the leaf in the parent
+ * @return int32_t The frame of the leaf, or -1 if the tree is empty
+ */
+int32_t descend_optimistic(Pager* pager, uint32_t key, uint64_t* version, int32_t* parent_frame_index,
+    uint64_t* parent_version, uint32_t* child_index) {
+restart:;
+    uint32_t root_page_num = __atomic_load_n(&pager->root_page_num, __ATOMIC_ACQUIRE);
+    int32_t frame_index = fix_page_optimistic(pager, root_page_num, version);
+    //  A root that split after it was read is no longer the root
+    if (__atomic_load_n(&pager->root_page_num, __ATOMIC_ACQUIRE) != root_page_num) {
+        STATS_COUNT(restarts, 1);
+        goto restart;
+    }
+    *parent_frame_index = -1;
+    *child_index = 0;
+
+    while (1) {
+        Frame* frame = &pager->frames[frame_index];
+        void* node = frame->page;
+        STATS_COUNT(node_visits, 1);
+        if (*(char*)node_initialized(node) != NODE_INITIALIZED) {
+            if (!frame_validate_version(frame, *version)) {
+                STATS_COUNT(restarts, 1);
+                goto restart;
+            }
+            return -1;
+        }
+        if (*node_type(node) == LEAF_NODE) {
+            return frame_index;
+        }
+
+        uint32_t num_keys = *internal_node_num_keys(node);
+        if (num_keys > INTERNAL_NODE_MAX_KEYS) {
+            STATS_COUNT(restarts, 1);
+            goto restart;
+        }
+        uint32_t index = key == UINT32_MAX ? num_keys : key_lower_bound(internal_node_key(node, 0), num_keys, key + 1);
+        uint32_t child_pointer = *internal_node_child_at(node, index);
+        if (!frame_validate_version(frame, *version)) {
+            STATS_COUNT(restarts, 1);
+            goto restart;
+        }
+
+        uint64_t child_version;
+        int32_t child_frame_index;
+        if (is_swizzled(child_pointer)) {
+            child_frame_index = child_pointer & ~SWIZZLED_POINTER_FLAG;
+            child_version = frame_read_version(&pager->frames[child_frame_index]);
+        } else {
+            child_frame_index = fix_page_optimistic(pager, child_pointer, &child_version);
+        }
+        if (!frame_validate_version(frame, *version)) {
+            STATS_COUNT(restarts, 1);
+            goto restart;
+        }
+        *parent_frame_index = frame_index;
+        *parent_version = *version;
+        *child_index = index;
+        frame_index = child_frame_index;
+        *version = child_version;
+    }
+}
+
+/**
+ * Adaptive hash index
+ * An optional table of PagerOptions.hash_index_size bytes that takes lookups of hot keys straight to their slot in a
+ * leaf. Every lookup that has to descend counts its key in the entry the key hashes to, and once a key has been
+ * counted HASH_INDEX_PROMOTION_LOOKUPS times, the entry keeps the leaf and the slot the key was found at. A key
+ * that hashes to an entry held by another key wears the count of that key down by one, and takes the entry over
+ * when the count reaches zero, so the entries end up with the keys that are looked up the most.
+ * Entries are read and written without latches. A lookup through an entry checks that the slot still holds the key
+ * in a leaf and validates the version of the leaf, so an entry that went stale costs a descent, never a wrong value.
+ * Writers invalidate the entries of the keys that splits and merges move, and drop the entries of deleted keys.
+ */
+const uint16_t HASH_INDEX_PROMOTION_LOOKUPS = 8;
+const uint16_t HASH_INDEX_MAX_COUNT = 255;
+
+HashIndexEntry* hash_index_entry(Pager* pager, uint32_t key) {
+    return &pager->hash_index[(uint32_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & pager->hash_index_mask];
+}
+
+/**
+ * @brief This method looks a key up through its hash index entry
+ * 
+ * @param pager 
+ * @param key 
+ * @param value Set to the value of the key if it was found
+ * @return int 1 if the entry took the lookup to the key, 0 if the key has to be looked up with a descent
+ */
+int hash_index_get(Pager* pager, uint32_t key, uint32_t* value) {
+    HashIndexEntry* entry = hash_index_entry(pager, key);
+    uint32_t page_num = __atomic_load_n(&entry->page_num, __ATOMIC_RELAXED);
+    uint32_t cell_num = __atomic_load_n(&entry->cell_num, __ATOMIC_RELAXED);
+    if (page_num == INVALID_PAGE_NUM || __atomic_load_n(&entry->key, __ATOMIC_RELAXED) != key) {
+        return 0;
+    }
+    uint64_t version;
+    Frame* frame = &pager->frames[fix_page_optimistic(pager, page_num, &version)];
+    void* node = frame->page;
+    STATS_COUNT(node_visits, 1);
+    //  A key is in one leaf only, so a leaf that holds it in the slot has its value
+    if (*node_type(node) != LEAF_NODE || *(char*)node_initialized(node) != NODE_INITIALIZED) {
+        return 0;
+    }
+    uint32_t num_cells = *leaf_node_num_cells(node);
+    if (num_cells > LEAF_NODE_MAX_CELLS || cell_num >= num_cells || *leaf_node_key(node, cell_num) != key) {
+        return 0;
+    }
+    uint16_t value_offset = *leaf_node_value_offset(node, cell_num);
+    if (value_offset > PAGE_SIZE - LEAF_NODE_VALUE_SIZE) {
+        return 0;
+    }
+    uint32_t found_value = *(uint32_t*)(node + value_offset);
+    if (!frame_validate_version(frame, version)) {
+        return 0;
+    }
+    *value = found_value;
+    return 1;
+}
+
+/**
+ * @brief This method counts a lookup that found a key with a descent, and points the entry of the key at the
+ * slot once the key is hot
+ * 
+ * @param pager 
+ * @param key 
+ * @param page_num The leaf the key was found in
+ * @param cell_num The slot of the key in the leaf
+ */
+void hash_index_record(Pager* pager, uint32_t key, uint32_t page_num, uint32_t cell_num) {
+    HashIndexEntry* entry = hash_index_entry(pager, key);
+    uint16_t count = __atomic_load_n(&entry->count, __ATOMIC_RELAXED);
+    if (__atomic_load_n(&entry->key, __ATOMIC_RELAXED) != key) {
+        if (count > 0) {
+            __atomic_store_n(&entry->count, count - 1, __ATOMIC_RELAXED);
+            return;
+        }
+        __atomic_store_n(&entry->page_num, INVALID_PAGE_NUM, __ATOMIC_RELAXED);
+        __atomic_store_n(&entry->key, key, __ATOMIC_RELAXED);
+    }
+    if (count < HASH_INDEX_MAX_COUNT) {
+        count++;
+        __atomic_store_n(&entry->count, count, __ATOMIC_RELAXED);
+    }
+    if (count >= HASH_INDEX_PROMOTION_LOOKUPS) {
+        __atomic_store_n(&entry->cell_num, cell_num, __ATOMIC_RELAXED);
+        __atomic_store_n(&entry->page_num, page_num, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief This method makes the entry of a key that moved to another slot go back to descending
+ * The key stays hot, so the next descent points the entry at the new slot.
+ * 
+ * @param pager 
+ * @param key 
+ */
+void hash_index_invalidate(Pager* pager, uint32_t key) {
+    if (pager->hash_index == NULL) {
+        return;
+    }
+    HashIndexEntry* entry = hash_index_entry(pager, key);
+    if (__atomic_load_n(&entry->key, __ATOMIC_RELAXED) == key) {
+        __atomic_store_n(&entry->page_num, INVALID_PAGE_NUM, __ATOMIC_RELAXED);
+    }
+}
+
+void hash_index_remove(Pager* pager, uint32_t key) {
+    if (pager->hash_index == NULL) {
+        return;
+    }
+    HashIndexEntry* entry = hash_index_entry(pager, key);
+    if (__atomic_load_n(&entry->key, __ATOMIC_RELAXED) == key) {
+        __atomic_store_n(&entry->page_num, INVALID_PAGE_NUM, __ATOMIC_RELAXED);
+        __atomic_store_n(&entry->count, 0, __ATOMIC_RELAXED);
+    }
+}
+
+void hash_index_clear(Pager* pager) {
+    if (pager->hash_index == NULL) {
+        return;
+    }
+    for (uint32_t i = 0; i <= pager->hash_index_mask; i++) {
+        __atomic_store_n(&pager->hash_index[i].page_num, INVALID_PAGE_NUM, __ATOMIC_RELAXED);
+        __atomic_store_n(&pager->hash_index[i].count, 0, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief This method descends from the root to the leaf that covers a key and looks the key up there
+ * 
+ * @param pager 
+ * @param key 
+ * @param value Set to the value of the key if it was found
+ * @return int 1 if the key was found, -1 otherwise
+ */
+int get_optimistic(Pager* pager, uint32_t key, uint32_t* value) {
+    if (pager->hash_index != NULL) {
+        if (hash_index_get(pager, key, value)) {
+            STATS_COUNT(hash_index_hits, 1);
+            return 1;
+        }
+        STATS_COUNT(hash_index_misses, 1);
+    }
+    uint64_t version;
+    int32_t parent_frame_index;
+    uint64_t parent_version;
+    uint32_t child_index;
+    while (1) {
+        int32_t frame_index = descend_optimistic(pager, key, &version, &parent_frame_index, &parent_version, &child_index);
+        if (frame_index == -1) {
+            return -1;
+        }
+        Frame* frame = &pager->frames[frame_index];
+        void* node = frame->page;
+        uint32_t num_cells = *leaf_node_num_cells(node);
+        if (num_cells > LEAF_NODE_MAX_CELLS) {
+            STATS_COUNT(restarts, 1);
+            continue;
+        }
+        uint32_t key_index = key_lower_bound(leaf_node_key(node, 0), num_cells, key);
+        int found = key_index < num_cells && *leaf_node_key(node, key_index) == key;
+        uint32_t found_value = 0;
+        if (found) {
+            uint16_t value_offset = *leaf_node_value_offset(node, key_index);
+            if (value_offset > PAGE_SIZE - LEAF_NODE_VALUE_SIZE) {
+                STATS_COUNT(restarts, 1);
+                continue;
+            }
+            found_value = *(uint32_t*)(node + value_offset);
+        }
+        uint32_t page_num = __atomic_load_n(&frame->page_num, __ATOMIC_ACQUIRE);
+        if (!frame_validate_version(frame, version)) {
+            STATS_COUNT(restarts, 1);
+            continue;
+        }
+        if (!found) {
+            return -1;
+        }
+        if (pager->hash_index != NULL) {
+            hash_index_record(pager, key, page_num, key_index);
+        }
+        *value = found_value;
+        return 1;
+    }
+}
+
+/**
+ * @brief This method looks up the value of a key in the B+ tree
+ * The lookup does not latch anything, so it runs alongside writers and other readers.
+ * 
+ * @param pager 
+ * @param key 
+ * @param value Set to the value of the key if it was found
+ * @return int 1 if the key was found, -1 otherwise
+ */
+int bt_get(Pager* pager, uint32_t key, uint32_t* value) {
+    uint64_t start_time = stats_operation_start(pager);
+    operation_trace_record(pager, TRACED_GET, key, 0);
+    int result = get_optimistic(pager, key, value);
+    stats_operation_finish(pager, OPERATION_GET, start_time);
+    return result;
+}
+
+/**
+ * @brief This method is responsible for searching for a key in the B+ tree
+ * 
+ * @param pager 
+ * @param key 
+ * @return int 1 if the key was found, -1 otherwise
+ */
+int search(Pager* pager, uint32_t key) {
+    uint32_t value;
+    if (bt_get(pager, key, &value) == -1) {
+        return -1;
+    }
+    TRACE_INFO("The value is %d\n", value);
+    return 1;
+}
+
+/**
+ * Batch lookups
+ * The keys of a batch are sorted and descended for in groups, one level at a time for the whole group. A child is
+ * prefetched as soon as it is known, so the cache misses of the group overlap instead of being taken one after
+ * the other, and the children of a level that are not resident are read in one batch. Keys that reach the same
+ * node share the lookup of its child. Any key whose optimistic read does not validate is looked up on its own.
+ */
+typedef struct {
+    uint32_t key;
+    uint32_t index;
+} MultiGetKey;
+
+int compare_multi_get_keys(const void* a, const void* b) {
+    uint32_t first = ((const MultiGetKey*)a)->key;
+    uint32_t second = ((const MultiGetKey*)b)->key;
+    return (first > second) - (first < second);
+}
+
+/**
+ * @brief This method pulls the cache lines of a node that its search touches first into the cache
+ * The type of the node is not known yet, so the middle of the keys of both node types is fetched
+ * 
+ * @param node 
+ */
+void prefetch_node(void* node) {
+    __builtin_prefetch(node);
+    __builtin_prefetch(internal_node_key(node, INTERNAL_NODE_MAX_KEYS / 2));
+    __builtin_prefetch(leaf_node_key(node, LEAF_NODE_MAX_CELLS / 2));
+}
+
+/**
+ * @brief This method descends from the root to the leaves that cover a group of sorted keys in lock-step
+ * 
+ * @param pager 
+ * @param keys 
+ * @param group_size At most MULTI_GET_GROUP_SIZE
+ * @param frame_indices The frame of the leaf of each key
+ * @param versions The version of the leaf of each key, which the caller validates after reading it
+ * @param failed Set for the keys whose descent did not validate
+ * @return int 0 if the tree is empty
+ */
+int multi_get_descend(Pager* pager, const MultiGetKey* keys, uint32_t group_size, int32_t* frame_indices,
+    uint64_t* versions, uint8_t* failed) {
+    uint32_t root_page_num;
+    uint64_t root_version;
+    int32_t root_frame_index;
+    while (1) {
+        root_page_num = __atomic_load_n(&pager->root_page_num, __ATOMIC_ACQUIRE);
+        root_frame_index = fix_page_optimistic(pager, root_page_num, &root_version);
+        if (__atomic_load_n(&pager->root_page_num, __ATOMIC_ACQUIRE) != root_page_num) {
+            continue;
+        }
+        Frame* root_frame = &pager->frames[root_frame_index];
+        if (*(char*)node_initialized(root_frame->page) != NODE_INITIALIZED) {
+            if (!frame_validate_version(root_frame, root_version)) {
+                continue;
+            }
+            return 0;
+        }
+        break;
+    }
+    for (uint32_t g = 0; g < group_size; g++) {
+        frame_indices[g] = root_frame_index;
+        versions[g] = root_version;
+        failed[g] = 0;
+    }
+
+    int32_t child_frame_indices[MULTI_GET_GROUP_SIZE];
+    uint64_t child_versions[MULTI_GET_GROUP_SIZE];
+    uint32_t child_indices[MULTI_GET_GROUP_SIZE];
+    uint32_t missing_page_nums[MULTI_GET_GROUP_SIZE];
+    uint8_t is_internal[MULTI_GET_GROUP_SIZE];
+    while (1) {
+        uint32_t num_internal = 0;
+        uint32_t num_missing = 0;
+        for (uint32_t g = 0; g < group_size; g++) {
+            is_internal[g] = 0;
+            if (failed[g]) {
+                continue;
+            }
+            Frame* frame = &pager->frames[frame_indices[g]];
+            void* node = frame->page;
+            STATS_COUNT(node_visits, 1);
+            if (*node_type(node) != INTERNAL_NODE) {
+                continue;
+            }
+            uint32_t num_keys = *internal_node_num_keys(node);
+            if (num_keys > INTERNAL_NODE_MAX_KEYS) {
+                failed[g] = 1;
+                continue;
+            }
+            uint32_t key = keys[g].key;
+            uint32_t index = key == UINT32_MAX ? num_keys : key_lower_bound(internal_node_key(node, 0), num_keys, key + 1);
+            is_internal[g] = 1;
+            child_indices[g] = index;
+            num_internal++;
+
+            //  The previous key went through the same node to the same child
+            if (g > 0 && is_internal[g - 1] && frame_indices[g - 1] == frame_indices[g] && versions[g - 1] == versions[g] &&
+                child_indices[g - 1] == index) {
+                child_frame_indices[g] = child_frame_indices[g - 1];
+                child_versions[g] = child_versions[g - 1];
+                missing_page_nums[g] = missing_page_nums[g - 1];
+                continue;
+            }
+
+            uint32_t child_pointer = *internal_node_child_at(node, index);
+            if (!frame_validate_version(frame, versions[g])) {
+                failed[g] = 1;
+                is_internal[g] = 0;
+                continue;
+            }
+            missing_page_nums[g] = INVALID_PAGE_NUM;
+            if (is_swizzled(child_pointer)) {
+                child_frame_indices[g] = child_pointer & ~SWIZZLED_POINTER_FLAG;
+                child_versions[g] = frame_read_version(&pager->frames[child_frame_indices[g]]);
+            } else {
+                child_frame_indices[g] = page_table_lookup_optimistic(pager, child_pointer, &child_versions[g]);
+                if (child_frame_indices[g] == -1) {
+                    missing_page_nums[g] = child_pointer;
+                    num_missing++;
+                    continue;
+                }
+            }
+            prefetch_node(pager->frames[child_frame_indices[g]].page);
+        }
+        if (num_internal == 0) {
+            return 1;
+        }
+
+        if (num_missing > 0) {
+            uint32_t page_nums[MULTI_GET_GROUP_SIZE];
+            uint32_t num_page_nums = 0;
+            for (uint32_t g = 0; g < group_size; g++) {
+                if (is_internal[g] && missing_page_nums[g] != INVALID_PAGE_NUM &&
+                    (num_page_nums == 0 || page_nums[num_page_nums - 1] != missing_page_nums[g])) {
+                    page_nums[num_page_nums++] = missing_page_nums[g];
+                }
+            }
+            pager_prefetch(pager, page_nums, num_page_nums);
+            for (uint32_t g = 0; g < group_size; g++) {
+                if (is_internal[g] && missing_page_nums[g] != INVALID_PAGE_NUM) {
+                    child_frame_indices[g] = fix_page_optimistic(pager, missing_page_nums[g], &child_versions[g]);
+                }
+            }
+        }
+
+        //  The child is the node the pointer referred to if the parent has not changed since
+        for (uint32_t g = 0; g < group_size; g++) {
+            if (!is_internal[g]) {
+                continue;
+            }
+            if (!frame_validate_version(&pager->frames[frame_indices[g]], versions[g])) {
+                failed[g] = 1;
+                continue;
+            }
+            frame_indices[g] = child_frame_indices[g];
+            versions[g] = child_versions[g];
+        }
+    }
+}
+
+/**
+ * @brief This method looks up the values of a batch of keys
+ * Like bt_get() it does not latch anything, so it runs alongside writers and other readers
+ * 
+ * @param pager 
+ * @param keys 
+ * @param num_keys 
+ * @param values Set to the value of each key that was found
+ * @param found Set to 1 for each key that was found and to 0 otherwise
+ * @return uint32_t The number of keys that were found
+ */
+uint32_t bt_multi_get(Pager* pager, const uint32_t* keys, uint32_t num_keys, uint32_t* values, uint8_t* found) {
+    uint64_t start_time = stats_operation_start(pager);
+    operation_trace_record_multi_get(pager, keys, num_keys);
+    MultiGetKey* sorted_keys = malloc(num_keys * sizeof(MultiGetKey));
+    for (uint32_t i = 0; i < num_keys; i++) {
+        sorted_keys[i].key = keys[i];
+        sorted_keys[i].index = i;
+    }
+    qsort(sorted_keys, num_keys, sizeof(MultiGetKey), compare_multi_get_keys);
+
+    uint32_t num_found = 0;
+    int32_t frame_indices[MULTI_GET_GROUP_SIZE];
+    uint64_t versions[MULTI_GET_GROUP_SIZE];
+    uint8_t failed[MULTI_GET_GROUP_SIZE];
+    for (uint32_t start = 0; start < num_keys; start += MULTI_GET_GROUP_SIZE) {
+        const MultiGetKey* group = sorted_keys + start;
+        uint32_t group_size = num_keys - start < MULTI_GET_GROUP_SIZE ? num_keys - start : MULTI_GET_GROUP_SIZE;
+        int is_empty = !multi_get_descend(pager, group, group_size, frame_indices, versions, failed);
+        for (uint32_t g = 0; g < group_size; g++) {
+            uint32_t index = group[g].index;
+            found[index] = 0;
+            if (is_empty) {
+                continue;
+            }
+
+            uint8_t is_valid = 0;
+            if (!failed[g]) {
+                Frame* frame = &pager->frames[frame_indices[g]];
+                void* node = frame->page;
+                STATS_COUNT(node_visits, 1);
+                uint32_t num_cells = *leaf_node_num_cells(node);
+                if (*node_type(node) == LEAF_NODE && num_cells <= LEAF_NODE_MAX_CELLS) {
+                    uint32_t key_index = key_lower_bound(leaf_node_key(node, 0), num_cells, group[g].key);
+                    uint8_t is_found = key_index < num_cells && *leaf_node_key(node, key_index) == group[g].key;
+                    uint32_t value = 0;
+                    uint16_t value_offset = is_found ? *leaf_node_value_offset(node, key_index) : 0;
+                    if (value_offset <= PAGE_SIZE - LEAF_NODE_VALUE_SIZE) {
+                        if (is_found) {
+                            value = *(uint32_t*)(node + value_offset);
+                        }
+                        if (frame_validate_version(frame, versions[g])) {
+                            is_valid = 1;
+                            found[index] = is_found;
+                            values[index] = value;
+                        }
+                    }
+                }
+            }
+            if (!is_valid) {
+                STATS_COUNT(restarts, 1);
+                found[index] = get_optimistic(pager, group[g].key, &values[index]) == 1;
+            }
+            num_found += found[index];
+        }
+    }
+    free(sorted_keys);
+    stats_operation_finish(pager, OPERATION_MULTI_GET, start_time);
+    return num_found;
+}
+
+/**
+ * Cursor methods
+ * A cursor sits between two entries of the tree. cursor_next() returns the entry after it and moves forward,
+ * cursor_prev() returns the entry before it and moves backward. The cursor keeps its leaf pinned and streams
+ * through the leaves along the sibling chain.
+ *
+ * Writers can change the leaf under the cursor, so the cursor remembers its position as the smallest key that
+ * may follow it, and reads every entry optimistically against the version of the leaf. When the leaf has changed,
+ * the cursor descends again to its position.
+ *
+ * While moving forward, the cursor keeps a queue of the leaves that follow the current one under the same
+ * parent, and prefetches them in batches of readahead_pages, one batch ahead of the leaf it is on.
+ */
+void cursor_prefetch(Cursor* cursor, uint32_t queue_index) {
+    if (queue_index < cursor->num_readahead_pages) {
+        uint32_t num_pages = cursor->num_readahead_pages - queue_index;
+        if (num_pages > cursor->pager->readahead_pages) {
+            num_pages = cursor->pager->readahead_pages;
+        }
+        pager_prefetch(cursor->pager, cursor->readahead_pages + queue_index, num_pages);
+    }
+}
+
+/**
+ * @brief This method pins the frame of a node that was found optimistically
+ * 
+ * @param pager 
+ * @param frame_index 
+ * @param version 
+ * @return int 0 if the node has changed since version was read
+ */
+int pin_frame_if_unchanged(Pager* pager, int32_t frame_index, uint64_t version) {
+    Frame* frame = &pager->frames[frame_index];
+    pthread_mutex_lock(&pager->latch);
+    //  Frames only change hands under the pager latch, so a frame with the same version still holds the node
+    int is_unchanged = frame_validate_version(frame, version);
+    if (is_unchanged) {
+        __atomic_fetch_add(&frame->pin_count, 1, __ATOMIC_SEQ_CST);
+        frame->reference_bit = 1;
+    }
+    pthread_mutex_unlock(&pager->latch);
+    return is_unchanged;
+}
+
+/**
+ * @brief This method makes the leaves to the right of a leaf under the same parent the read-ahead queue
+ * 
+ * @param cursor 
+ * @param parent_frame_index 
+ * @param parent_version 
+ * @param child_index The index of the leaf in the parent
+ * @return int 0 if the parent changed while it was read
+ */
+int cursor_fill_readahead_queue(Cursor* cursor, int32_t parent_frame_index, uint64_t parent_version, uint32_t child_index) {
+    Pager* pager = cursor->pager;
+    cursor->num_readahead_pages = 0;
+    cursor->next_readahead_page = 0;
+    if (parent_frame_index == -1) {
+        return 1;
+    }
+    void* parent_node = pager->frames[parent_frame_index].page;
+    uint32_t num_keys = *internal_node_num_keys(parent_node);
+    for (uint32_t i = child_index + 1; i <= num_keys && i <= INTERNAL_NODE_MAX_KEYS &&
+        cursor->num_readahead_pages < MAX_READAHEAD_PAGES; i++) {
+        uint32_t child_pointer = *internal_node_child_at(parent_node, i);
+        //  Swizzled children are resident already
+        if (!is_swizzled(child_pointer)) {
+            cursor->readahead_pages[cursor->num_readahead_pages++] = child_pointer;
+        }
+    }
+    return frame_validate_version(&pager->frames[parent_frame_index], parent_version);
+}
+
+/**
+ * @brief This method refills the read-ahead queue from the parent of the leaf that covers key
+ * 
+ * @param cursor 
+ * @param key 
+ */
+void cursor_refill_readahead_queue(Cursor* cursor, uint32_t key) {
+    uint64_t version;
+    int32_t parent_frame_index;
+    uint64_t parent_version;
+    uint32_t child_index;
+    do {
+        if (descend_optimistic(cursor->pager, key, &version, &parent_frame_index, &parent_version, &child_index) == -1) {
+            cursor->num_readahead_pages = 0;
+            cursor->next_readahead_page = 0;
+            return;
+        }
+    } while (!cursor_fill_readahead_queue(cursor, parent_frame_index, parent_version, child_index));
+    cursor_prefetch(cursor, 0);
+}
+
+/**
+ * @brief This method moves the cursor to the leaf that holds its position and pins it
+ * The leaves to the right of it under the same parent become the read-ahead queue
+ * 
+ * @param cursor 
+ */
+void cursor_descend(Cursor* cursor) {
+    Pager* pager = cursor->pager;
+    if (cursor->node != NULL) {
+        unpin_node(pager, cursor->node);
+        cursor->node = NULL;
+    }
+    uint32_t key = cursor->past_last_key ? UINT32_MAX : cursor->boundary_key;
+    uint64_t version;
+    int32_t parent_frame_index;
+    uint64_t parent_version;
+    uint32_t child_index;
+    while (1) {
+        int32_t frame_index = descend_optimistic(pager, key, &version, &parent_frame_index, &parent_version, &child_index);
+        if (frame_index == -1) {
+            return;
+        }
+        if (!cursor_fill_readahead_queue(cursor, parent_frame_index, parent_version, child_index)) {
+            continue;
+        }
+        if (pin_frame_if_unchanged(pager, frame_index, version)) {
+            cursor->node = pager->frames[frame_index].page;
+            cursor->version = version;
+            break;
+        }
+    }
+
+    void* node = cursor->node;
+    uint32_t num_cells = *leaf_node_num_cells(node);
+    if (num_cells > LEAF_NODE_MAX_CELLS) {
+        num_cells = 0;
+    }
+    cursor->cell_num = cursor->past_last_key ? num_cells : key_lower_bound(leaf_node_key(node, 0), num_cells, key);
+    if (!frame_validate_version(&pager->frames[get_frame_index(pager, node)], cursor->version)) {
+        cursor_descend(cursor);
+        return;
+    }
+    cursor_prefetch(cursor, 0);
+}
+
+/**
+ * @brief This method checks that the leaf of the cursor has not changed and re-reads its version
+ * 
+ * @param cursor 
+ * @return Frame* The frame of the leaf
+ */
+Frame* cursor_revalidate(Cursor* cursor) {
+    Pager* pager = cursor->pager;
+    Frame* frame = &pager->frames[get_frame_index(pager, cursor->node)];
+    if (frame_read_version(frame) != cursor->version) {
+        cursor_descend(cursor);
+        if (cursor->node == NULL) {
+            return NULL;
+        }
+        frame = &pager->frames[get_frame_index(pager, cursor->node)];
+    }
+    return frame;
+}
+
+/**
+ * @brief This method moves the cursor to the start of the leaf to the right of the current one
+ * 
+ * @param cursor 
+ * @return int 0 if the current leaf is the last one
+ */
+int cursor_move_to_right_sibling(Cursor* cursor) {
+    Pager* pager = cursor->pager;
+    Frame* frame = &pager->frames[get_frame_index(pager, cursor->node)];
+    uint32_t right_sibling_page_num = *leaf_node_right_sibling_pointer(cursor->node);
+    if (!frame_validate_version(frame, cursor->version)) {
+        cursor_descend(cursor);
+        return cursor->node != NULL;
+    }
+    if (right_sibling_page_num == INVALID_PAGE_NUM) {
+        return 0;
+    }
+    void* right_sibling_node = get_page(pager, right_sibling_page_num);
+    STATS_COUNT(node_visits, 1);
+    uint64_t right_sibling_version = frame_read_version(&pager->frames[get_frame_index(pager, right_sibling_node)]);
+    //  A split of the current leaf puts a new leaf in between
+    if (!frame_validate_version(frame, cursor->version)) {
+        unpin_node(pager, right_sibling_node);
+        cursor_descend(cursor);
+        return cursor->node != NULL;
+    }
+    unpin_node(pager, cursor->node);
+    cursor->node = right_sibling_node;
+    cursor->version = right_sibling_version;
+    cursor->cell_num = 0;
+
+    if (cursor->next_readahead_page < cursor->num_readahead_pages &&
+        cursor->readahead_pages[cursor->next_readahead_page] == right_sibling_page_num) {
+        //  Once the cursor moves into a prefetched batch, the batch after it is prefetched
+        cursor->next_readahead_page++;
+        if (pager->readahead_pages > 0 && (cursor->next_readahead_page - 1) % pager->readahead_pages == 0) {
+            cursor_prefetch(cursor, cursor->next_readahead_page - 1 + pager->readahead_pages);
+        }
+    } else {
+        //  The cursor has left the leaves of the last parent, so find the leaves under the next one
+        Frame* right_sibling_frame = &pager->frames[get_frame_index(pager, right_sibling_node)];
+        uint32_t num_cells = *leaf_node_num_cells(right_sibling_node);
+        uint32_t first_key = *leaf_node_key(right_sibling_node, 0);
+        if (num_cells > 0 && num_cells <= LEAF_NODE_MAX_CELLS && frame_validate_version(right_sibling_frame, right_sibling_version)) {
+            cursor_refill_readahead_queue(cursor, first_key);
+        }
+    }
+    return 1;
+}
+
+int cursor_move_to_left_sibling(Cursor* cursor) {
+    Pager* pager = cursor->pager;
+    Frame* frame = &pager->frames[get_frame_index(pager, cursor->node)];
+    uint32_t left_sibling_page_num = *leaf_node_left_sibling_pointer(cursor->node);
+    if (!frame_validate_version(frame, cursor->version)) {
+        cursor_descend(cursor);
+        return cursor->node != NULL;
+    }
+    if (left_sibling_page_num == INVALID_PAGE_NUM) {
+        return 0;
+    }
+    void* left_sibling_node = get_page(pager, left_sibling_page_num);
+    STATS_COUNT(node_visits, 1);
+    Frame* left_sibling_frame = &pager->frames[get_frame_index(pager, left_sibling_node)];
+    uint64_t left_sibling_version = frame_read_version(left_sibling_frame);
+    uint32_t num_cells = *leaf_node_num_cells(left_sibling_node);
+    if (!frame_validate_version(frame, cursor->version) || !frame_validate_version(left_sibling_frame, left_sibling_version) ||
+        num_cells > LEAF_NODE_MAX_CELLS) {
+        unpin_node(pager, left_sibling_node);
+        cursor_descend(cursor);
+        return cursor->node != NULL;
+    }
+    unpin_node(pager, cursor->node);
+    cursor->node = left_sibling_node;
+    cursor->version = left_sibling_version;
+    cursor->cell_num = num_cells;
+    return 1;
+}
+
+/**
+ * @brief This method opens a cursor positioned before the first key that is not smaller than lo
+ * 
+ * @param pager 
+ * @param lo 
+ * @return Cursor* 
+ */
+Cursor* cursor_open(Pager* pager, uint32_t lo) {
+    uint64_t start_time = stats_operation_start(pager);
+    Cursor* cursor = malloc(sizeof(Cursor));
+    cursor->pager = pager;
+    cursor->node = NULL;
+    cursor->version = 0;
+    cursor->cell_num = 0;
+    cursor->boundary_key = lo;
+    cursor->past_last_key = 0;
+    cursor->num_readahead_pages = 0;
+    cursor->next_readahead_page = 0;
+    cursor->trace_key = lo;
+    cursor->num_next = 0;
+    cursor->num_prev = 0;
+    cursor_descend(cursor);
+    stats_operation_finish(pager, OPERATION_SCAN, start_time);
+    return cursor;
+}
+
+/**
+ * @brief This method returns the entry after the cursor and moves the cursor past it
+ * 
+ * @param cursor 
+ * @param key 
+ * @param value 
+ * @return int 1 if an entry was returned, 0 at the end of the tree
+ */
+int cursor_next(Cursor* cursor, uint32_t* key, uint32_t* value) {
+    while (cursor->node != NULL) {
+        Frame* frame = cursor_revalidate(cursor);
+        if (frame == NULL) {
+            return 0;
+        }
+        void* node = cursor->node;
+        uint32_t num_cells = *leaf_node_num_cells(node);
+        uint32_t cell_num = cursor->cell_num;
+        //  Skip over leaves that have been emptied by deletes
+        if (cell_num >= num_cells) {
+            if (!frame_validate_version(frame, cursor->version)) {
+                continue;
+            }
+            if (!cursor_move_to_right_sibling(cursor)) {
+                return 0;
+            }
+            continue;
+        }
+        uint32_t next_key = *leaf_node_key(node, cell_num);
+        uint16_t value_offset = *leaf_node_value_offset(node, cell_num);
+        if (value_offset > PAGE_SIZE - LEAF_NODE_VALUE_SIZE) {
+            continue;
+        }
+        uint32_t next_value = *(uint32_t*)(node + value_offset);
+        if (!frame_validate_version(frame, cursor->version)) {
+            continue;
+        }
+        *key = next_key;
+        *value = next_value;
+        cursor->cell_num = cell_num + 1;
+        cursor->past_last_key = next_key == UINT32_MAX;
+        cursor->boundary_key = next_key + 1;
+        cursor->num_next++;
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief This method returns the entry before the cursor and moves the cursor in front of it
+ * 
+ * @param cursor 
+ * @param key 
+ * @param value 
+ * @return int 1 if an entry was returned, 0 at the start of the tree
+ */
+int cursor_prev(Cursor* cursor, uint32_t* key, uint32_t* value) {
+    while (cursor->node != NULL) {
+        Frame* frame = cursor_revalidate(cursor);
+        if (frame == NULL) {
+            return 0;
+        }
+        if (cursor->cell_num == 0) {
+            if (!cursor_move_to_left_sibling(cursor)) {
+                return 0;
+            }
+            continue;
+        }
+        void* node = cursor->node;
+        uint32_t num_cells = *leaf_node_num_cells(node);
+        uint32_t cell_num = cursor->cell_num - 1;
+        if (cell_num >= num_cells) {
+            continue;
+        }
+        uint32_t previous_key = *leaf_node_key(node, cell_num);
+        uint16_t value_offset = *leaf_node_value_offset(node, cell_num);
+        if (value_offset > PAGE_SIZE - LEAF_NODE_VALUE_SIZE) {
+            continue;
+        }
+        uint32_t previous_value = *(uint32_t*)(node + value_offset);
+        if (!frame_validate_version(frame, cursor->version)) {
+            continue;
+        }
+        *key = previous_key;
+        *value = previous_value;
+        cursor->cell_num = cell_num;
+        cursor->past_last_key = 0;
+        cursor->boundary_key = previous_key;
+        cursor->num_prev++;
+        return 1;
+    }
+    return 0;
+}
+
+void cursor_close(Cursor* cursor) {
+    operation_trace_record_scan(cursor->pager, cursor->trace_key, cursor->num_next, cursor->num_prev);
+    if (cursor->node != NULL) {
+        unpin_node(cursor->pager, cursor->node);
+    }
+    free(cursor);
+}
+
+/**
+ * Byte tree
+ * Next to the tree of 32-bit keys, a file holds a tree of byte string keys and values of any size, which starts
+ * out empty and is only created by its first insert. Keys are ordered by the comparator the pager was opened with,
+ * so a file has to be opened with the same comparator every time.
+ * Writers go through the same operations as the other tree: they are serialized by the write latch, descend with a
+ * path and latch the nodes they change, which are logged as page images. Readers descend optimistically and
+ * validate the version of every node they read, overflow pages included.
+ * With the default comparator, every node stores the bytes its whole key range shares once, and leaves split at the
+ * shortest key that separates their halves. A leaf is only taken out of the tree once it is empty, and internal
+ * nodes stay, so nodes can stay sparse after many deletes.
+ */
+
+/**
+ * @brief This method is the default key comparator. It orders keys by their bytes, and a key before any key it
+ * is a prefix of
+ */
+int compare_bytes(const void* a, uint32_t a_size, const void* b, uint32_t b_size) {
+    int result = memcmp(a, b, a_size < b_size ? a_size : b_size);
+    if (result != 0) {
+        return result;
+    }
+    return (a_size > b_size) - (a_size < b_size);
+}
+
+void check_bytes_key_size(uint32_t key_size) {
+    if (key_size > BYTES_MAX_KEY_SIZE) {
+        fprintf(stderr, "A key of %u bytes is larger than the maximum of %u\n", key_size, BYTES_MAX_KEY_SIZE);
+        exit(EXIT_FAILURE);
+    }
+}
+
+void initialize_bytes_node(void* node, PageType type) {
+    *(uint32_t*)node = type;
+    *(char*)node_initialized(node) = NODE_INITIALIZED;
+    *(uint8_t*)node_is_root(node) = 0;
+    *(uint32_t*)node_parent_pointer(node) = 0;
+    *node_free_block_offset(node) = 0;
+    *node_lsn(node) = 0;
+    *bytes_node_num_cells(node) = 0;
+    *bytes_node_cell_content_start(node) = PAGE_SIZE;
+    *bytes_node_right_pointer(node) = INVALID_PAGE_NUM;
+    *bytes_node_left_sibling_pointer(node) = INVALID_PAGE_NUM;
+    *(uint16_t*)(node + BYTES_NODE_PREFIX_SIZE_OFFSET) = 0;
+}
+
+/**
+ * @brief This method searches the keys of a byte tree node
+ * 
+ * @param pager 
+ * @param node 
+ * @param key 
+ * @param key_size 
+ * @param upper_bound Whether to skip the cells that are equal to the key
+ * @param found Set to whether a cell is equal to the key
+ * @return uint32_t The first cell that is not smaller than the key, or greater than it if upper_bound is set.
+ * For an internal node with upper_bound set, this is the child that covers the key.
+ */
+uint32_t bytes_node_search(Pager* pager, void* node, const void* key, uint32_t key_size, int upper_bound, int* found) {
+    uint32_t num_cells = *bytes_node_num_cells(node);
+    if (num_cells > BYTES_NODE_MAX_CELLS) {
+        num_cells = BYTES_NODE_MAX_CELLS;
+    }
+    *found = 0;
+    uint32_t prefix_size = bytes_node_prefix_size(node);
+    if (prefix_size > 0) {
+        //  Every key of the node starts with the prefix, so a key that does not sorts before or after all of them
+        int result = memcmp(key, bytes_node_prefix(node), key_size < prefix_size ? key_size : prefix_size);
+        STATS_COUNT(key_comparisons, 1);
+        if (result < 0 || (result == 0 && key_size < prefix_size)) {
+            return 0;
+        }
+        if (result > 0) {
+            return num_cells;
+        }
+        key += prefix_size;
+        key_size -= prefix_size;
+    }
+    uint32_t lo = 0;
+    uint32_t hi = num_cells;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        void* cell = bytes_node_cell(node, mid);
+        int result = pager->compare_keys(bytes_cell_key(cell), bytes_cell_key_size(node, cell), key, key_size);
+        STATS_COUNT(key_comparisons, 1);
+        if (result == 0) {
+            *found = 1;
+        }
+        if (result < 0 || (result == 0 && upper_bound)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/**
+ * @brief This method returns the number of bytes the cells of a byte tree node take up, with their offsets
+ */
+uint32_t bytes_node_used_space(void* node) {
+    uint32_t num_cells = *bytes_node_num_cells(node);
+    uint32_t used_space = 0;
+    for (uint32_t i = 0; i < num_cells; i++) {
+        used_space += BYTES_NODE_CELL_OFFSET_SIZE + bytes_node_cell_size(node, bytes_node_cell(node, i));
+    }
+    return used_space;
+}
+
+/**
+ * @brief This method rewrites the cells of a byte tree node back to back at the end of the page
+ * Afterwards the free block list is empty and all free space sits between the cell offsets and the cell content
+ * start
+ * 
+ * @param node 
+ */
+void compact_bytes_node(void* node) {
+    void* copy = malloc(PAGE_SIZE);
+    memcpy(copy, node, PAGE_SIZE);
+    uint32_t num_cells = *bytes_node_num_cells(node);
+    uint32_t cell_content_start = PAGE_SIZE - bytes_node_prefix_size(node);
+    for (uint32_t i = 0; i < num_cells; i++) {
+        void* cell = bytes_node_cell(copy, i);
+        uint32_t cell_size = bytes_node_cell_size(copy, cell);
+        cell_content_start -= cell_size;
+        memcpy(node + cell_content_start, cell, cell_size);
+        *bytes_node_cell_offset(node, i) = cell_content_start;
+    }
+    *bytes_node_cell_content_start(node) = cell_content_start;
+    *node_free_block_offset(node) = 0;
+    free(copy);
+}
+
+/**
+ * @brief This method allocates space for a cell in a byte tree node that is about to get one more cell
+ * The free block list is searched first fit. Otherwise the cell is taken from the gap between the cell offsets and
+ * the cell content start, compacting the node first if the free space is fragmented.
+ * 
+ * @param node 
+ * @param size 
+ * @return uint16_t The offset of the cell, or 0 if the node is too full for it
+ */
+uint16_t bytes_node_allocate_cell(void* node, uint16_t size) {
+    uint32_t end_of_cell_offsets = BYTES_NODE_CELL_OFFSETS_OFFSET + (*bytes_node_num_cells(node) + 1) * BYTES_NODE_CELL_OFFSET_SIZE;
+    if (*bytes_node_cell_content_start(node) >= end_of_cell_offsets) {
+        uint16_t free_block = allocate_from_free_block_list(node, size);
+        if (free_block != 0) {
+            return free_block;
+        }
+    }
+    if (*bytes_node_cell_content_start(node) < end_of_cell_offsets + size) {
+        if (BYTES_NODE_CELL_OFFSETS_OFFSET + bytes_node_used_space(node) + BYTES_NODE_CELL_OFFSET_SIZE + size +
+            bytes_node_prefix_size(node) > PAGE_SIZE) {
+            return 0;
+        }
+        compact_bytes_node(node);
+    }
+    *bytes_node_cell_content_start(node) -= size;
+    return *bytes_node_cell_content_start(node);
+}
+
+/**
+ * @brief This method returns the number of bytes two keys start with in common
+ */
+uint32_t bytes_common_prefix_size(const void* a, uint32_t a_size, const void* b, uint32_t b_size) {
+    uint32_t size = a_size < b_size ? a_size : b_size;
+    uint32_t i = 0;
+    while (i < size && ((const uint8_t*)a)[i] == ((const uint8_t*)b)[i]) {
+        i++;
+    }
+    return i;
+}
+
+/**
+ * @brief This method lays out the cells of a byte tree node with their whole keys, and a new cell in its place
+ * among them, so that the node can be rebuilt with another prefix
+ * 
+ * @param node 
+ * @param cell_num Where the new cell goes
+ * @param cell The new cell, or NULL
+ * @param cell_size 
+ * @param cells Set to the cells, with room for one more than the node holds
+ * @param cell_sizes Set to the sizes of the cells
+ * @return void* The buffer the cells of the node were copied to, which the caller frees
+ */
+void* bytes_node_expand_cells(void* node, uint32_t cell_num, const void* cell, uint32_t cell_size, const void** cells,
+    uint32_t* cell_sizes) {
+    uint32_t num_cells = *bytes_node_num_cells(node);
+    uint32_t prefix_size = bytes_node_prefix_size(node);
+    void* buffer = malloc(PAGE_SIZE + num_cells * prefix_size);
+    void* next_cell = buffer;
+    for (uint32_t i = 0, j = 0; j < num_cells; i++) {
+        if (cell != NULL && i == cell_num) {
+            cells[i] = cell;
+            cell_sizes[i] = cell_size;
+            continue;
+        }
+        void* node_cell = bytes_node_cell(node, j++);
+        uint32_t node_cell_size = bytes_node_cell_size(node, node_cell);
+        memcpy(next_cell, node_cell, BYTES_CELL_HEADER_SIZE);
+        *(uint16_t*)(next_cell + BYTES_CELL_KEY_SIZE_OFFSET) = prefix_size + bytes_cell_key_size(node, node_cell);
+        memcpy(bytes_cell_key(next_cell), bytes_node_prefix(node), prefix_size);
+        memcpy(bytes_cell_key(next_cell) + prefix_size, bytes_cell_key(node_cell), node_cell_size - BYTES_CELL_HEADER_SIZE);
+        cells[i] = next_cell;
+        cell_sizes[i] = node_cell_size + prefix_size;
+        next_cell += cell_sizes[i];
+    }
+    if (cell != NULL && cell_num == num_cells) {
+        cells[num_cells] = cell;
+        cell_sizes[num_cells] = cell_size;
+    }
+    return buffer;
+}
+
+/**
+ * @brief This method fills an empty byte tree node with cells that hold their whole keys, which all start with the
+ * prefix. The prefix is stored once, and the cells only keep what follows it.
+ * 
+ * @param node 
+ * @param cells 
+ * @param cell_sizes 
+ * @param first The first cell that goes into the node
+ * @param last The cell after the last one that goes into the node
+ * @param prefix 
+ * @param prefix_size 
+ */
+void bytes_node_build(void* node, const void** cells, const uint32_t* cell_sizes, uint32_t first, uint32_t last,
+    const void* prefix, uint32_t prefix_size) {
+    *(uint16_t*)(node + BYTES_NODE_PREFIX_SIZE_OFFSET) = prefix_size;
+    memcpy(node + PAGE_SIZE - prefix_size, prefix, prefix_size);
+    uint32_t cell_content_start = PAGE_SIZE - prefix_size;
+    for (uint32_t i = first; i < last; i++) {
+        uint32_t cell_size = cell_sizes[i] - prefix_size;
+        cell_content_start -= cell_size;
+        void* cell = node + cell_content_start;
+        memcpy(cell, cells[i], BYTES_CELL_HEADER_SIZE);
+        *(uint16_t*)(cell + BYTES_CELL_KEY_SIZE_OFFSET) = *(uint16_t*)(cells[i] + BYTES_CELL_KEY_SIZE_OFFSET) - prefix_size;
+        memcpy(bytes_cell_key(cell), cells[i] + BYTES_CELL_HEADER_SIZE + prefix_size, cell_size - BYTES_CELL_HEADER_SIZE);
+        *bytes_node_cell_offset(node, i - first) = cell_content_start;
+    }
+    *bytes_node_cell_content_start(node) = cell_content_start;
+    *bytes_node_num_cells(node) = last - first;
+}
+
+/**
+ * @brief This method removes a cell from a byte tree node and frees its space
+ */
+void bytes_node_remove_cell(void* node, uint32_t cell_num) {
+    uint32_t num_cells = *bytes_node_num_cells(node);
+    uint16_t offset = *bytes_node_cell_offset(node, cell_num);
+    uint32_t cell_size = bytes_node_cell_size(node, node + offset);
+    memmove(bytes_node_cell_offset(node, cell_num), bytes_node_cell_offset(node, cell_num + 1),
+        (num_cells - cell_num - 1) * BYTES_NODE_CELL_OFFSET_SIZE);
+    *bytes_node_num_cells(node) = num_cells - 1;
+    _insert_into_free_block_list(node, offset, cell_size);
+}
+
+/**
+ * Unlinked overflow chains
+ * Overflow pages are written and freed by operations of their own, so a value needs one frame at a time however
+ * large it is. Between those operations and the one that changes the leaf, the chain is referred to by no leaf.
+ * Each of these operations logs the chain as the unlinked chain of the file, which is kept in the meta page, and
+ * recovery frees whatever chain a crash left there. There is only one such chain at a time, so byte tree writers
+ * hold the overflow mutex from the first of their operations to the last.
+ */
+void set_unlinked_overflow_page(Pager* pager, uint32_t page_num) {
+    pager->unlinked_overflow_page_num = page_num;
+    wal_log_unlinked_overflow_page(pager, page_num);
+}
+
+/**
+ * @brief This method writes a value to a new chain of overflow pages, before the operation that puts the value
+ * into a leaf
+ * The chain is written from its end, so that every page is complete when it is written, and the pages written so
+ * far are the unlinked chain.
+ * 
+ * @param pager 
+ * @param value 
+ * @param value_size 
+ * @return uint32_t The first page of the chain
+ */
+uint32_t bytes_write_overflow_chain(Pager* pager, const void* value, uint32_t value_size) {
+    uint32_t next_page_num = INVALID_PAGE_NUM;
+    uint32_t num_pages = (value_size + OVERFLOW_PAGE_DATA_SIZE - 1) / OVERFLOW_PAGE_DATA_SIZE;
+    for (uint32_t i = num_pages; i > 0; i--) {
+        uint32_t offset = (i - 1) * OVERFLOW_PAGE_DATA_SIZE;
+        uint32_t chunk_size = value_size - offset < OVERFLOW_PAGE_DATA_SIZE ? value_size - offset : OVERFLOW_PAGE_DATA_SIZE;
+        begin_operation(pager);
+        void* page = allocate_page(pager);
+        latch_node(pager, page);
+        *(uint32_t*)page = OVERFLOW_PAGE;
+        *(char*)node_initialized(page) = NODE_INITIALIZED;
+        *overflow_page_next_pointer(page) = next_page_num;
+        memcpy(overflow_page_data(page), value + offset, chunk_size);
+        mark_node_dirty(pager, page);
+        next_page_num = get_node_page_num(pager, page);
+        set_unlinked_overflow_page(pager, next_page_num);
+        unpin_node(pager, page);
+        //  The operation that puts the value into its leaf waits for the log up to here anyway
+        release_operation(pager);
+    }
+    return next_page_num;
+}
+
+/**
+ * @brief This method frees the unlinked chain of overflow pages after the operation that took it out of its leaf,
+ * a page per operation
+ * 
+ * @param pager 
+ * @param page_num The first page of the chain, or INVALID_PAGE_NUM
+ * @param commit_lsn The commit of the operation that took the chain out of its leaf
+ * @return uint64_t The commit to wait for
+ */
+uint64_t bytes_free_overflow_chain(Pager* pager, uint32_t page_num, uint64_t commit_lsn) {
+    while (page_num != INVALID_PAGE_NUM) {
+        begin_operation(pager);
+        void* page = get_page(pager, page_num);
+        page_num = *overflow_page_next_pointer(page);
+        free_page(pager, page);
+        set_unlinked_overflow_page(pager, page_num);
+        unpin_node(pager, page);
+        commit_lsn = release_operation(pager);
+    }
+    return commit_lsn;
+}
+
+/**
+ * @brief This method copies a value out of a leaf cell that is read optimistically
+ * The pages of an overflow chain are only freed after the leaf that referred to them has changed, so a chain that
+ * was read while the leaf kept its version is the chain of the value.
+ * 
+ * @param pager 
+ * @param leaf_frame 
+ * @param leaf_version 
+ * @param cell 
+ * @param value Where to copy the value to, or NULL to only read its size
+ * @param value_capacity The number of bytes to copy at most
+ * @param value_size Set to the size of the whole value
+ * @return int 0 if the leaf changed while the value was read
+ */
+int bytes_read_value(Pager* pager, Frame* leaf_frame, uint64_t leaf_version, void* cell, void* value,
+    uint32_t value_capacity, uint32_t* value_size) {
+    void* node = leaf_frame->page;
+    *value_size = *bytes_cell_word(cell);
+    uint32_t copy_size = *value_size < value_capacity ? *value_size : value_capacity;
+    if (value == NULL || copy_size == 0) {
+        return 1;
+    }
+    void* inline_value = bytes_cell_value(node, cell);
+    if (bytes_value_is_inline(*value_size)) {
+        uint32_t room = node + PAGE_SIZE - inline_value;
+        memcpy(value, inline_value, copy_size < room ? copy_size : room);
+        return 1;
+    }
+
+    uint32_t page_num = *(uint32_t*)inline_value;
+    //  The leaf is pinned, or reading a chain longer than the buffer pool would evict it and start over forever
+    if (!pin_frame_if_unchanged(pager, leaf_frame - pager->frames, leaf_version)) {
+        return 0;
+    }
+    int is_unchanged = 1;
+    for (uint32_t offset = 0; offset < copy_size && is_unchanged; offset += OVERFLOW_PAGE_DATA_SIZE) {
+        if (!frame_validate_version(leaf_frame, leaf_version)) {
+            is_unchanged = 0;
+            break;
+        }
+        uint64_t version;
+        Frame* frame = &pager->frames[fix_page_optimistic(pager, page_num, &version)];
+        uint32_t chunk_size = copy_size - offset < OVERFLOW_PAGE_DATA_SIZE ? copy_size - offset : OVERFLOW_PAGE_DATA_SIZE;
+        memcpy(value + offset, overflow_page_data(frame->page), chunk_size);
+        page_num = *overflow_page_next_pointer(frame->page);
+        is_unchanged = frame_validate_version(frame, version);
+    }
+    unpin_node(pager, node);
+    return is_unchanged;
+}
+
+/**
+ * @brief This method descends the byte tree to the leaf that covers a key without pinning or latching anything,
+ * the same way descend_optimistic() does
+ * 
+ * @param pager 
+ * @param key 
+ * @param key_size 
+ * @param version The version of the leaf, which the caller validates after reading it
+ * @return int32_t The frame of the leaf, or -1 if there is no byte tree
+ */
+int32_t bytes_descend_optimistic(Pager* pager, const void* key, uint32_t key_size, uint64_t* version) {
+restart:;
+    uint32_t root_page_num = get_bytes_root_page(pager);
+    if (root_page_num == INVALID_PAGE_NUM) {
+        return -1;
+    }
+    int32_t frame_index = fix_page_optimistic(pager, root_page_num, version);
+    if (get_bytes_root_page(pager) != root_page_num) {
+        STATS_COUNT(restarts, 1);
+        goto restart;
+    }
+
+    for (uint32_t depth = 1; ; depth++) {
+        Frame* frame = &pager->frames[frame_index];
+        void* node = frame->page;
+        STATS_COUNT(node_visits, 1);
+        uint8_t type = *node_type(node);
+        if (type == BYTES_LEAF_NODE) {
+            return frame_index;
+        }
+        if (type != BYTES_INTERNAL_NODE || depth == MAX_TREE_HEIGHT) {
+            if (!frame_validate_version(frame, *version)) {
+                STATS_COUNT(restarts, 1);
+                goto restart;
+            }
+            fprintf(stderr, "Page %u of the byte tree is not a node\n", frame->page_num);
+            exit(EXIT_FAILURE);
+        }
+
+        int found;
+        uint32_t index = bytes_node_search(pager, node, key, key_size, 1, &found);
+        uint32_t child_page_num = *bytes_internal_node_child_at(node, index);
+        if (!frame_validate_version(frame, *version)) {
+            STATS_COUNT(restarts, 1);
+            goto restart;
+        }
+        uint64_t child_version;
+        int32_t child_frame_index = fix_page_optimistic(pager, child_page_num, &child_version);
+        if (!frame_validate_version(frame, *version)) {
+            STATS_COUNT(restarts, 1);
+            goto restart;
+        }
+        frame_index = child_frame_index;
+        *version = child_version;
+    }
+}
+
+/**
+ * @brief This method looks up the value of a byte string key
+ * The lookup does not latch anything, so it runs alongside writers and other readers.
+ * 
+ * @param pager 
+ * @param key 
+ * @param key_size 
+ * @param value Where to copy the value to, or NULL to only look up its size without reading overflow pages
+ * @param value_capacity The number of bytes to copy at most
+ * @param value_size Set to the size of the whole value if the key was found
+ * @return int 1 if the key was found, -1 otherwise
+ */
+int bt_get_bytes(Pager* pager, const void* key, uint32_t key_size, void* value, uint32_t value_capacity,
+    uint32_t* value_size) {
+    check_bytes_key_size(key_size);
+    uint64_t start_time = stats_operation_start(pager);
+    operation_trace_record_bytes(pager, TRACED_GET_BYTES, key, key_size, 0);
+    while (1) {
+        uint64_t version;
+        int32_t frame_index = bytes_descend_optimistic(pager, key, key_size, &version);
+        if (frame_index == -1) {
+            stats_operation_finish(pager, OPERATION_GET, start_time);
+            return -1;
+        }
+        Frame* frame = &pager->frames[frame_index];
+        int found;
+        uint32_t cell_num = bytes_node_search(pager, frame->page, key, key_size, 0, &found);
+        if (found && !bytes_read_value(pager, frame, version, bytes_node_cell(frame->page, cell_num), value,
+            value_capacity, value_size)) {
+            STATS_COUNT(restarts, 1);
+            continue;
+        }
+        if (!frame_validate_version(frame, version)) {
+            STATS_COUNT(restarts, 1);
+            continue;
+        }
+        stats_operation_finish(pager, OPERATION_GET, start_time);
+        return found ? 1 : -1;
+    }
+}
+
+/**
+ * @brief This method descends the byte tree to the leaf that covers a key and records the path of the current
+ * operation on the way
+ * 
+ * @param pager 
+ * @param key 
+ * @param key_size 
+ * @param create_empty_root Whether a file without a byte tree gets an empty root leaf
+ * @return void* The leaf, or NULL if there is no byte tree
+ */
+void* bytes_descend_to_leaf(Pager* pager, const void* key, uint32_t key_size, uint8_t create_empty_root) {
+    TreePath* path = &pager->path;
+    path->depth = 0;
+    void* node;
+    if (pager->bytes_root_page_num == INVALID_PAGE_NUM) {
+        if (!create_empty_root) {
+            return NULL;
+        }
+        node = allocate_page(pager);
+        latch_node(pager, node);
+        initialize_bytes_node(node, BYTES_LEAF_NODE);
+        mark_node_dirty(pager, node);
+        set_bytes_root_page(pager, get_node_page_num(pager, node));
+    } else {
+        node = get_page(pager, pager->bytes_root_page_num);
+    }
+    path->nodes[0] = node;
+    path->child_indices[0] = 0;
+    path->depth = 1;
+    STATS_COUNT(node_visits, 1);
+
+    while (*node_type(node) == BYTES_INTERNAL_NODE) {
+        if (path->depth == MAX_TREE_HEIGHT) {
+            fprintf(stderr, "The byte tree is more than %d levels deep\n", MAX_TREE_HEIGHT);
+            exit(EXIT_FAILURE);
+        }
+        int found;
+        uint32_t child_index = bytes_node_search(pager, node, key, key_size, 1, &found);
+        node = get_page(pager, *bytes_internal_node_child_at(node, child_index));
+        path->nodes[path->depth] = node;
+        path->child_indices[path->depth] = child_index;
+        path->depth++;
+        STATS_COUNT(node_visits, 1);
+    }
+    return node;
+}
+
+/**
+ * @brief This method returns the parent of a byte tree node that is about to split from the path of the current
+ * operation. A root gets a new internal root above it with the node as its only child.
+ * 
+ * @param pager 
+ * @param node 
+ * @return void* 
+ */
+void* bytes_get_or_create_parent_node(Pager* pager, void* node) {
+    uint32_t level = get_path_level(pager, node);
+    if (level > 0) {
+        return pager->path.nodes[level - 1];
+    }
+    STATS_ADD(pager, root_splits, 1);
+    void* new_root = allocate_page(pager);
+    latch_node(pager, new_root);
+    initialize_bytes_node(new_root, BYTES_INTERNAL_NODE);
+    *bytes_node_right_pointer(new_root) = get_node_page_num(pager, node);
+    mark_node_dirty(pager, new_root);
+    set_bytes_root_page(pager, get_node_page_num(pager, new_root));
+    push_root_onto_path(pager, new_root);
+    return new_root;
+}
+
+/**
+ * @brief This method copies a fence key of a child of a node on the path of the current operation
+ * The lower fence of a child is the separator to the left of it and the upper fence the separator to the right of
+ * it, taken from the lowest node on the path that has one. Every key in the range of the child is at least the
+ * lower fence and smaller than the upper fence.
+ * 
+ * @param pager 
+ * @param level The level of the parent of the child
+ * @param child_index The index of the child in the parent
+ * @param upper Whether to copy the upper fence
+ * @param key At least BYTES_MAX_KEY_SIZE bytes
+ * @param key_size 
+ * @return int 0 if the child is on the left or right edge of the tree and has no such fence
+ */
+int bytes_fence_key(Pager* pager, uint32_t level, uint32_t child_index, int upper, uint8_t* key, uint32_t* key_size) {
+    while (1) {
+        void* node = pager->path.nodes[level];
+        if (upper ? child_index < *bytes_node_num_cells(node) : child_index > 0) {
+            *key_size = bytes_node_copy_key(node, bytes_node_cell(node, upper ? child_index : child_index - 1), key);
+            return 1;
+        }
+        if (level == 0) {
+            return 0;
+        }
+        child_index = pager->path.child_indices[level];
+        level--;
+    }
+}
+
+/**
+ * @brief This method returns how many bytes every key between two fences starts with, which is the prefix of a
+ * node with that range
+ * Bytewise, every key between two fences starts with the bytes the fences have in common. Other orders do not keep
+ * the keys of a range together like that, so their nodes have no prefix.
+ * 
+ * @param pager 
+ * @param lo The lower fence, or NULL on the left edge of the tree
+ * @param lo_size 
+ * @param hi The upper fence, or NULL on the right edge of the tree
+ * @param hi_size 
+ * @return uint32_t 
+ */
+uint32_t bytes_range_prefix_size(Pager* pager, const void* lo, uint32_t lo_size, const void* hi, uint32_t hi_size) {
+    if (pager->compare_keys != compare_bytes || lo == NULL || hi == NULL) {
+        return 0;
+    }
+    return bytes_common_prefix_size(lo, lo_size, hi, hi_size);
+}
+
+/**
+ * @brief This method returns how much of the first key of the right half of a leaf split goes into the separator
+ * Bytewise, the bytes it has in common with the last key of the left half and one more are enough to tell the
+ * halves apart, which keeps separators short and internal nodes wide. Other orders need the whole key.
+ * 
+ * @param pager 
+ * @param left_key 
+ * @param left_key_size 
+ * @param right_key 
+ * @param right_key_size 
+ * @return uint32_t 
+ */
+uint32_t bytes_separator_size(Pager* pager, const void* left_key, uint32_t left_key_size, const void* right_key,
+    uint32_t right_key_size) {
+    if (pager->compare_keys != compare_bytes) {
+        return right_key_size;
+    }
+    return bytes_common_prefix_size(left_key, left_key_size, right_key, right_key_size) + 1;
+}
+
+/**
+ * @brief This method splits a byte tree node that has no room for a new cell
+ * The cells are divided so that both nodes hold about as many bytes, except that a new last cell leaves the node
+ * as full as it is and starts the sibling with it. Keys that arrive at the end of a node tend to keep arriving
+ * there, like the keys of a tenant in time order, so the node would not fill up again.
+ * A leaf promotes the shortest separator between its halves, an internal node promotes the key between its cells
+ * and the cells of the sibling. Both halves get the prefix of their narrower range, which is at least as long as
+ * the prefix of the node, so they fit.
+ * 
+ * @param pager 
+ * @param node 
+ * @param cell_num Where the new cell goes
+ * @param cell The new cell, with its whole key
+ * @param cell_size 
+ */
+void bytes_split_node(Pager* pager, void* node, uint32_t cell_num, const void* cell, uint32_t cell_size) {
+    int is_leaf = *node_type(node) == BYTES_LEAF_NODE;
+    STATS_ADD(pager, leaf_splits, is_leaf);
+    STATS_ADD(pager, internal_splits, !is_leaf);
+    void* parent_node = bytes_get_or_create_parent_node(pager, node);
+    uint32_t level = get_path_level(pager, node);
+    uint32_t child_index = pager->path.child_indices[level];
+    void* sibling_node = allocate_page(pager);
+    latch_node(pager, sibling_node);
+    uint32_t page_num = get_node_page_num(pager, node);
+    uint32_t sibling_page_num = get_node_page_num(pager, sibling_node);
+
+    //  Lay out the cells with the new one in place. Their sizes in the node leave out the prefix
+    uint32_t prefix_size = bytes_node_prefix_size(node);
+    uint32_t num_cells = *bytes_node_num_cells(node) + 1;
+    const void** cells = malloc(num_cells * sizeof(void*));
+    uint32_t* cell_sizes = malloc(num_cells * sizeof(uint32_t));
+    void* expanded_cells = bytes_node_expand_cells(node, cell_num, cell, cell_size, cells, cell_sizes);
+    uint32_t total_size = 0;
+    for (uint32_t i = 0; i < num_cells; i++) {
+        total_size += cell_sizes[i] - prefix_size + BYTES_NODE_CELL_OFFSET_SIZE;
+    }
+
+    //  The sibling starts at the split cell. An internal node promotes the key of the split cell instead
+    uint32_t split_cell = 1;
+    uint32_t left_size = cell_sizes[0] - prefix_size + BYTES_NODE_CELL_OFFSET_SIZE;
+    while (split_cell < num_cells - 1 && left_size + (cell_sizes[split_cell] - prefix_size) / 2 < total_size / 2) {
+        left_size += cell_sizes[split_cell] - prefix_size + BYTES_NODE_CELL_OFFSET_SIZE;
+        split_cell++;
+    }
+    if (cell_num == num_cells - 1) {
+        split_cell = num_cells - 1;
+    } else if (is_leaf && pager->compare_keys == compare_bytes) {
+        //  Anywhere in the middle half of the bytes, split where the separator is shortest. That is where the
+        //  halves have the least in common, like between the keys of two tenants, and each gets a longer prefix
+        uint32_t best_separator_size = UINT32_MAX;
+        uint32_t best_distance = UINT32_MAX;
+        uint32_t size = cell_sizes[0] - prefix_size + BYTES_NODE_CELL_OFFSET_SIZE;
+        for (uint32_t i = 1; i < num_cells; i++) {
+            if (size >= total_size / 4 && size <= total_size / 4 * 3) {
+                uint32_t separator_size = bytes_separator_size(pager, bytes_cell_key((void*)cells[i - 1]),
+                    *(uint16_t*)(cells[i - 1] + BYTES_CELL_KEY_SIZE_OFFSET), bytes_cell_key((void*)cells[i]),
+                    *(uint16_t*)(cells[i] + BYTES_CELL_KEY_SIZE_OFFSET));
+                uint32_t distance = size > total_size / 2 ? size - total_size / 2 : total_size / 2 - size;
+                if (separator_size < best_separator_size ||
+                    (separator_size == best_separator_size && distance < best_distance)) {
+                    best_separator_size = separator_size;
+                    best_distance = distance;
+                    split_cell = i;
+                }
+            }
+            size += cell_sizes[i] - prefix_size + BYTES_NODE_CELL_OFFSET_SIZE;
+        }
+    }
+    if (!is_leaf && split_cell > num_cells - 2) {
+        split_cell = num_cells - 2;
+    }
+    const void* separator = bytes_cell_key((void*)cells[split_cell]);
+    uint32_t separator_size = *(uint16_t*)(cells[split_cell] + BYTES_CELL_KEY_SIZE_OFFSET);
+    if (is_leaf) {
+        const void* left_cell = cells[split_cell - 1];
+        separator_size = bytes_separator_size(pager, bytes_cell_key((void*)left_cell),
+            *(uint16_t*)(left_cell + BYTES_CELL_KEY_SIZE_OFFSET), separator, separator_size);
+    }
+
+    //  The separator divides the range of the node into the ranges of the halves
+    uint8_t* fences = malloc(2 * BYTES_MAX_KEY_SIZE);
+    uint32_t lo_size = 0;
+    uint32_t hi_size = 0;
+    int has_lo = bytes_fence_key(pager, level - 1, child_index, 0, fences, &lo_size);
+    int has_hi = bytes_fence_key(pager, level - 1, child_index, 1, fences + BYTES_MAX_KEY_SIZE, &hi_size);
+    uint32_t left_prefix_size = bytes_range_prefix_size(pager, has_lo ? fences : NULL, lo_size, separator, separator_size);
+    uint32_t right_prefix_size = bytes_range_prefix_size(pager, separator, separator_size,
+        has_hi ? fences + BYTES_MAX_KEY_SIZE : NULL, hi_size);
+
+    //  Rebuild the node from the cells that stay and fill the sibling with the rest
+    uint8_t type = *node_type(node);
+    uint64_t lsn = *node_lsn(node);
+    uint32_t left_sibling_page_num = *bytes_node_left_sibling_pointer(node);
+    uint32_t right_pointer = *bytes_node_right_pointer(node);
+    initialize_bytes_node(node, type);
+    *node_lsn(node) = lsn;
+    *bytes_node_left_sibling_pointer(node) = left_sibling_page_num;
+    initialize_bytes_node(sibling_node, type);
+    bytes_node_build(node, cells, cell_sizes, 0, split_cell, separator, left_prefix_size);
+    bytes_node_build(sibling_node, cells, cell_sizes, is_leaf ? split_cell : split_cell + 1, num_cells, separator,
+        right_prefix_size);
+    if (is_leaf) {
+        *bytes_node_right_pointer(node) = sibling_page_num;
+        *bytes_node_left_sibling_pointer(sibling_node) = page_num;
+        *bytes_node_right_pointer(sibling_node) = right_pointer;
+        if (right_pointer != INVALID_PAGE_NUM) {
+            void* right_sibling_node = get_page(pager, right_pointer);
+            latch_node(pager, right_sibling_node);
+            *bytes_node_left_sibling_pointer(right_sibling_node) = sibling_page_num;
+            mark_node_dirty(pager, right_sibling_node);
+            unpin_node(pager, right_sibling_node);
+        }
+    } else {
+        *bytes_node_right_pointer(node) = *bytes_cell_word((void*)cells[split_cell]);
+        *bytes_node_right_pointer(sibling_node) = right_pointer;
+    }
+    mark_node_dirty(pager, node);
+    mark_node_dirty(pager, sibling_node);
+
+    //  The separator goes into the parent with the node to its left. The sibling takes the place of the node
+    //  first, so that it ends up to the right of the separator even if the parent splits
+    uint32_t parent_cell_size = BYTES_CELL_HEADER_SIZE + separator_size;
+    void* parent_cell = malloc(parent_cell_size);
+    *bytes_cell_word(parent_cell) = page_num;
+    *(uint16_t*)(parent_cell + BYTES_CELL_KEY_SIZE_OFFSET) = separator_size;
+    memcpy(bytes_cell_key(parent_cell), separator, separator_size);
+    free(cells);
+    free(cell_sizes);
+    free(expanded_cells);
+    free(fences);
+
+    latch_node(pager, parent_node);
+    *bytes_internal_node_child_at(parent_node, child_index) = sibling_page_num;
+    unpin_node(pager, sibling_node);
+    bytes_node_insert_cell(pager, parent_node, child_index, parent_cell, parent_cell_size);
+    free(parent_cell);
+}
+
+/**
+ * @brief This method inserts a cell into a byte tree node on the path of the current operation, splitting it if
+ * it is full
+ * 
+ * @param pager 
+ * @param node 
+ * @param cell_num 
+ * @param cell The cell, with its whole key
+ * @param cell_size 
+ */
+void bytes_node_insert_cell(Pager* pager, void* node, uint32_t cell_num, const void* cell, uint32_t cell_size) {
+    latch_node(pager, node);
+    //  Every key in the range of a node starts with its prefix, see bytes_range_prefix_size()
+    uint32_t prefix_size = bytes_node_prefix_size(node);
+    uint32_t key_size = *(uint16_t*)(cell + BYTES_CELL_KEY_SIZE_OFFSET);
+    if (key_size < prefix_size || memcmp(bytes_cell_key((void*)cell), bytes_node_prefix(node), prefix_size) != 0) {
+        fprintf(stderr, "A key does not start with the prefix of page %u\n", get_node_page_num(pager, node));
+        exit(EXIT_FAILURE);
+    }
+    uint16_t offset = bytes_node_allocate_cell(node, cell_size - prefix_size);
+    if (offset == 0) {
+        bytes_split_node(pager, node, cell_num, cell, cell_size);
+        return;
+    }
+    uint32_t num_cells = *bytes_node_num_cells(node);
+    memmove(bytes_node_cell_offset(node, cell_num + 1), bytes_node_cell_offset(node, cell_num),
+        (num_cells - cell_num) * BYTES_NODE_CELL_OFFSET_SIZE);
+    void* node_cell = node + offset;
+    memcpy(node_cell, cell, BYTES_CELL_HEADER_SIZE);
+    *(uint16_t*)(node_cell + BYTES_CELL_KEY_SIZE_OFFSET) = key_size - prefix_size;
+    memcpy(bytes_cell_key(node_cell), cell + BYTES_CELL_HEADER_SIZE + prefix_size,
+        cell_size - BYTES_CELL_HEADER_SIZE - prefix_size);
+    *bytes_node_cell_offset(node, cell_num) = offset;
+    *bytes_node_num_cells(node) = num_cells + 1;
+    mark_node_dirty(pager, node);
+}
+
+/**
+ * @brief This method removes a cell from a byte tree leaf
+ * 
+ * @return uint32_t The overflow chain of the value, which the caller frees once the operation has ended, or
+ * INVALID_PAGE_NUM
+ */
+uint32_t bytes_leaf_node_remove_cell(Pager* pager, void* node, uint32_t cell_num) {
+    latch_node(pager, node);
+    void* cell = bytes_node_cell(node, cell_num);
+    uint32_t overflow_page_num = INVALID_PAGE_NUM;
+    if (!bytes_value_is_inline(*bytes_cell_word(cell))) {
+        overflow_page_num = *(uint32_t*)bytes_cell_value(node, cell);
+    }
+    bytes_node_remove_cell(node, cell_num);
+    mark_node_dirty(pager, node);
+    return overflow_page_num;
+}
+
+/**
+ * @brief This method inserts a byte string key or replaces its value if it exists, with a single descent
+ * 
+ * @param pager 
+ * @param key At most BYTES_MAX_KEY_SIZE bytes
+ * @param key_size 
+ * @param value 
+ * @param value_size 
+ * @return int 1 if the key was inserted, 0 if its value was replaced
+ */
+int bt_put_bytes(Pager* pager, const void* key, uint32_t key_size, const void* value, uint32_t value_size) {
+    check_bytes_key_size(key_size);
+    uint64_t start_time = stats_operation_start(pager);
+    operation_trace_record_bytes(pager, TRACED_PUT_BYTES, key, key_size, value_size);
+    uint32_t overflow_page_num = INVALID_PAGE_NUM;
+    pthread_mutex_lock(&pager->overflow_mutex);
+    if (!bytes_value_is_inline(value_size)) {
+        overflow_page_num = bytes_write_overflow_chain(pager, value, value_size);
+    }
+    begin_operation(pager);
+    void* node = bytes_descend_to_leaf(pager, key, key_size, 1);
+    int found;
+    uint32_t cell_num = bytes_node_search(pager, node, key, key_size, 0, &found);
+    uint32_t old_overflow_page_num = INVALID_PAGE_NUM;
+    if (found) {
+        old_overflow_page_num = bytes_leaf_node_remove_cell(pager, node, cell_num);
+    }
+
+    uint32_t cell_size = bytes_leaf_cell_size(key_size, value_size);
+    void* cell = malloc(cell_size);
+    *bytes_cell_word(cell) = value_size;
+    *(uint16_t*)(cell + BYTES_CELL_KEY_SIZE_OFFSET) = key_size;
+    memcpy(bytes_cell_key(cell), key, key_size);
+    if (bytes_value_is_inline(value_size)) {
+        memcpy(bytes_cell_key(cell) + key_size, value, value_size);
+    } else {
+        *(uint32_t*)(bytes_cell_key(cell) + key_size) = overflow_page_num;
+    }
+    bytes_node_insert_cell(pager, node, cell_num, cell, cell_size);
+    free(cell);
+    //  The new chain is linked now, and the old one takes its place
+    if (overflow_page_num != INVALID_PAGE_NUM || old_overflow_page_num != INVALID_PAGE_NUM) {
+        set_unlinked_overflow_page(pager, old_overflow_page_num);
+    }
+
+    release_path(pager);
+    uint64_t commit_lsn = bytes_free_overflow_chain(pager, old_overflow_page_num, release_operation(pager));
+    pthread_mutex_unlock(&pager->overflow_mutex);
+    wal_wait_for_commit(pager, commit_lsn);
+    stats_operation_finish(pager, OPERATION_INSERT, start_time);
+    return !found;
+}
+
+/**
+ * @brief This method gives a child of a node on the path of the current operation the range of a neighbour that
+ * is about to be taken out as well, rebuilding the child with the prefix of its wider range
+ * 
+ * @param pager 
+ * @param level The level of the parent
+ * @param child_index 
+ * @param neighbour_index The index of the neighbour, right next to the child
+ * @return int 0 if the cells of the child would no longer fit
+ */
+int bytes_widen_child(Pager* pager, uint32_t level, uint32_t child_index, uint32_t neighbour_index) {
+    uint8_t* fences = malloc(2 * BYTES_MAX_KEY_SIZE);
+    uint32_t lo_size = 0;
+    uint32_t hi_size = 0;
+    uint32_t first_index = child_index < neighbour_index ? child_index : neighbour_index;
+    int has_lo = bytes_fence_key(pager, level, first_index, 0, fences, &lo_size);
+    int has_hi = bytes_fence_key(pager, level, first_index + 1, 1, fences + BYTES_MAX_KEY_SIZE, &hi_size);
+    uint32_t prefix_size = bytes_range_prefix_size(pager, has_lo ? fences : NULL, lo_size,
+        has_hi ? fences + BYTES_MAX_KEY_SIZE : NULL, hi_size);
+    void* node = get_page(pager, *bytes_internal_node_child_at(pager->path.nodes[level], child_index));
+    if (bytes_node_prefix_size(node) <= prefix_size) {
+        unpin_node(pager, node);
+        free(fences);
+        return 1;
+    }
+
+    uint32_t num_cells = *bytes_node_num_cells(node);
+    const void** cells = malloc((num_cells + 1) * sizeof(void*));
+    uint32_t* cell_sizes = malloc((num_cells + 1) * sizeof(uint32_t));
+    void* expanded_cells = bytes_node_expand_cells(node, 0, NULL, 0, cells, cell_sizes);
+    uint32_t size = BYTES_NODE_CELL_OFFSETS_OFFSET + prefix_size;
+    for (uint32_t i = 0; i < num_cells; i++) {
+        size += cell_sizes[i] - prefix_size + BYTES_NODE_CELL_OFFSET_SIZE;
+    }
+    int fits = size <= PAGE_SIZE;
+    if (fits) {
+        latch_node(pager, node);
+        uint8_t type = *node_type(node);
+        uint64_t lsn = *node_lsn(node);
+        uint32_t left_sibling_page_num = *bytes_node_left_sibling_pointer(node);
+        uint32_t right_pointer = *bytes_node_right_pointer(node);
+        initialize_bytes_node(node, type);
+        *node_lsn(node) = lsn;
+        *bytes_node_left_sibling_pointer(node) = left_sibling_page_num;
+        *bytes_node_right_pointer(node) = right_pointer;
+        bytes_node_build(node, cells, cell_sizes, 0, num_cells, fences, prefix_size);
+        mark_node_dirty(pager, node);
+    }
+    unpin_node(pager, node);
+    free(cells);
+    free(cell_sizes);
+    free(expanded_cells);
+    free(fences);
+    return fits;
+}
+
+/**
+ * @brief This method takes a byte tree leaf without cells out of the tree, and its neighbour takes over its range
+ * A root leaf simply stays empty. The last child of a node stays too, and so does a leaf whose neighbour would
+ * not fit with the shorter prefix of the wider range, since the range of a node never grows past its prefix.
+ * 
+ * @param pager 
+ * @param node A leaf on the path of the current operation
+ */
+void bytes_remove_empty_leaf(Pager* pager, void* node) {
+    uint32_t level = get_path_level(pager, node);
+    if (level == 0) {
+        initialize_bytes_node(node, BYTES_LEAF_NODE);
+        mark_node_dirty(pager, node);
+        return;
+    }
+    void* parent_node = pager->path.nodes[level - 1];
+    uint32_t child_index = pager->path.child_indices[level];
+    uint32_t num_cells = *bytes_node_num_cells(parent_node);
+    if (num_cells == 0) {
+        return;
+    }
+    //  The neighbour to the right of the leaf takes over its keys, or the one to the left for the rightmost child
+    uint32_t neighbour_index = child_index < num_cells ? child_index + 1 : child_index - 1;
+    if (!bytes_widen_child(pager, level - 1, neighbour_index, child_index)) {
+        return;
+    }
+
+    uint32_t left_sibling_page_num = *bytes_node_left_sibling_pointer(node);
+    uint32_t right_sibling_page_num = *bytes_node_right_pointer(node);
+    if (left_sibling_page_num != INVALID_PAGE_NUM) {
+        void* left_sibling_node = get_page(pager, left_sibling_page_num);
+        latch_node(pager, left_sibling_node);
+        *bytes_node_right_pointer(left_sibling_node) = right_sibling_page_num;
+        mark_node_dirty(pager, left_sibling_node);
+        unpin_node(pager, left_sibling_node);
+    }
+    if (right_sibling_page_num != INVALID_PAGE_NUM) {
+        void* right_sibling_node = get_page(pager, right_sibling_page_num);
+        latch_node(pager, right_sibling_node);
+        *bytes_node_left_sibling_pointer(right_sibling_node) = left_sibling_page_num;
+        mark_node_dirty(pager, right_sibling_node);
+        unpin_node(pager, right_sibling_node);
+    }
+
+    latch_node(pager, parent_node);
+    free_page(pager, node);
+    if (child_index == num_cells) {
+        *bytes_node_right_pointer(parent_node) = *bytes_cell_word(bytes_node_cell(parent_node, num_cells - 1));
+        child_index = num_cells - 1;
+    }
+    bytes_node_remove_cell(parent_node, child_index);
+    mark_node_dirty(pager, parent_node);
+}
+
+/**
+ * @brief This method deletes a byte string key
+ * 
+ * @param pager 
+ * @param key 
+ * @param key_size 
+ * @return int 1 if the key was deleted, -1 if it does not exist
+ */
+int bt_delete_bytes(Pager* pager, const void* key, uint32_t key_size) {
+    check_bytes_key_size(key_size);
+    uint64_t start_time = stats_operation_start(pager);
+    operation_trace_record_bytes(pager, TRACED_DELETE_BYTES, key, key_size, 0);
+    pthread_mutex_lock(&pager->overflow_mutex);
+    begin_operation(pager);
+    void* node = bytes_descend_to_leaf(pager, key, key_size, 0);
+    int found = 0;
+    uint32_t cell_num = node == NULL ? 0 : bytes_node_search(pager, node, key, key_size, 0, &found);
+    uint32_t overflow_page_num = INVALID_PAGE_NUM;
+    if (found) {
+        overflow_page_num = bytes_leaf_node_remove_cell(pager, node, cell_num);
+        if (overflow_page_num != INVALID_PAGE_NUM) {
+            set_unlinked_overflow_page(pager, overflow_page_num);
+        }
+        if (*bytes_node_num_cells(node) == 0) {
+            bytes_remove_empty_leaf(pager, node);
+        }
+
+        //  A root with a single child hands the tree down to it
+        void* root_node = pager->path.nodes[0];
+        if (*node_type(root_node) == BYTES_INTERNAL_NODE && *bytes_node_num_cells(root_node) == 0) {
+            STATS_ADD(pager, root_collapses, 1);
+            set_bytes_root_page(pager, *bytes_node_right_pointer(root_node));
+            free_page(pager, root_node);
+        }
+    }
+    release_path(pager);
+    uint64_t commit_lsn = bytes_free_overflow_chain(pager, overflow_page_num, release_operation(pager));
+    pthread_mutex_unlock(&pager->overflow_mutex);
+    wal_wait_for_commit(pager, commit_lsn);
+    stats_operation_finish(pager, OPERATION_DELETE, start_time);
+    return found ? 1 : -1;
+}
+
+/**
+ * Byte tree cursors
+ * A byte tree cursor walks the leaves forward from a key. It remembers the leaf it is in by its frame and the
+ * version the frame had, without pinning it, and goes back to the tree for the last key it returned whenever the
+ * frame changed.
+ */
+
+/**
+ * @brief This method opens a cursor positioned before the first key that is not smaller than lo
+ * 
+ * @param pager 
+ * @param lo 
+ * @param lo_size 
+ * @return BytesCursor* 
+ */
+BytesCursor* bytes_cursor_open(Pager* pager, const void* lo, uint32_t lo_size) {
+    check_bytes_key_size(lo_size);
+    BytesCursor* cursor = malloc(sizeof(BytesCursor));
+    cursor->pager = pager;
+    cursor->frame_index = -1;
+    cursor->version = 0;
+    cursor->cell_num = 0;
+    cursor->key = malloc(BYTES_MAX_KEY_SIZE);
+    cursor->next_key = malloc(BYTES_MAX_KEY_SIZE);
+    memcpy(cursor->key, lo, lo_size);
+    cursor->key_size = lo_size;
+    cursor->inclusive = 1;
+    cursor->trace_key = NULL;
+    cursor->trace_key_size = lo_size;
+    cursor->num_next = 0;
+    if (pager->operation_trace != NULL) {
+        cursor->trace_key = malloc(lo_size > 0 ? lo_size : 1);
+        memcpy(cursor->trace_key, lo, lo_size);
+    }
+    return cursor;
+}
+
+/**
+ * @brief This method returns the entry after the cursor and moves the cursor past it
+ * 
+ * @param cursor 
+ * @param key Set to the key, which stays valid until the cursor moves again
+ * @param key_size 
+ * @param value Where to copy the value to, or NULL to not read it
+ * @param value_capacity The number of bytes to copy at most
+ * @param value_size Set to the size of the whole value
+ * @return int 0 once the cursor is past the last entry
+ */
+int bytes_cursor_next(BytesCursor* cursor, const void** key, uint32_t* key_size, void* value, uint32_t value_capacity,
+    uint32_t* value_size) {
+    Pager* pager = cursor->pager;
+    while (1) {
+        if (cursor->frame_index == -1) {
+            cursor->frame_index = bytes_descend_optimistic(pager, cursor->key, cursor->key_size, &cursor->version);
+            if (cursor->frame_index == -1) {
+                return 0;
+            }
+            int found;
+            cursor->cell_num = bytes_node_search(pager, pager->frames[cursor->frame_index].page, cursor->key,
+                cursor->key_size, !cursor->inclusive, &found);
+        }
+        Frame* frame = &pager->frames[cursor->frame_index];
+        void* node = frame->page;
+        if (*node_type(node) != BYTES_LEAF_NODE || cursor->cell_num > BYTES_NODE_MAX_CELLS) {
+            cursor->frame_index = -1;
+            continue;
+        }
+
+        if (cursor->cell_num >= *bytes_node_num_cells(node)) {
+            uint32_t right_sibling_page_num = *bytes_node_right_pointer(node);
+            if (!frame_validate_version(frame, cursor->version)) {
+                cursor->frame_index = -1;
+                continue;
+            }
+            if (right_sibling_page_num == INVALID_PAGE_NUM) {
+                return 0;
+            }
+            uint64_t version;
+            int32_t frame_index = fix_page_optimistic(pager, right_sibling_page_num, &version);
+            STATS_COUNT(node_visits, 1);
+            if (!frame_validate_version(frame, cursor->version)) {
+                cursor->frame_index = -1;
+                continue;
+            }
+            cursor->frame_index = frame_index;
+            cursor->version = version;
+            cursor->cell_num = 0;
+            continue;
+        }
+
+        void* cell = bytes_node_cell(node, cursor->cell_num);
+        uint32_t next_key_size = bytes_node_copy_key(node, cell, cursor->next_key);
+        if (!bytes_read_value(pager, frame, cursor->version, cell, value, value_capacity, value_size) ||
+            !frame_validate_version(frame, cursor->version)) {
+            cursor->frame_index = -1;
+            continue;
+        }
+        uint8_t* returned_key = cursor->next_key;
+        cursor->next_key = cursor->key;
+        cursor->key = returned_key;
+        cursor->key_size = next_key_size;
+        cursor->inclusive = 0;
+        cursor->cell_num++;
+        cursor->num_next++;
+        *key = cursor->key;
+        *key_size = cursor->key_size;
+        return 1;
+    }
+}
+
+void bytes_cursor_close(BytesCursor* cursor) {
+    if (cursor->trace_key != NULL) {
+        operation_trace_record_bytes(cursor->pager, TRACED_SCAN_BYTES, cursor->trace_key, cursor->trace_key_size,
+            cursor->num_next);
+        free(cursor->trace_key);
+    }
+    free(cursor->key);
+    free(cursor->next_key);
+    free(cursor);
+}
+
+/**
+ * Snapshots
+ * A snapshot is a consistent view of the tree for long scans and backups that does not hold writers up. Opening one
+ * starts a new epoch. While snapshots are open, the first change an operation makes to a page saves the image the
+ * page had into the version store, unless the page already has a version from the epoch of the newest snapshot.
+ * A snapshot reads a page from its oldest version that is not older than the snapshot, or from the file when the
+ * page has not changed since. Versions that no open snapshot reads any more are freed when a snapshot closes.
+ * Writers only pay for the copy when a snapshot is open, and never wait for snapshot readers.
+ */
+const uint32_t PAGE_VERSION_BUCKETS = 4096;
+
+PageVersion** page_version_bucket(Pager* pager, uint32_t page_num) {
+    return &pager->page_versions[page_num & (PAGE_VERSION_BUCKETS - 1)];
+}
+
+/**
+ * @brief This method returns the version of a page that a snapshot of an epoch reads, the caller holds the
+ * snapshot mutex
+ * 
+ * @param pager 
+ * @param page_num 
+ * @param epoch 
+ * @return PageVersion* NULL if the page has not changed since the epoch started
+ */
+PageVersion* find_page_version(Pager* pager, uint32_t page_num, uint64_t epoch) {
+    PageVersion* found = NULL;
+    for (PageVersion* version = *page_version_bucket(pager, page_num); version != NULL; version = version->next) {
+        if (version->page_num == page_num && version->epoch >= epoch && (found == NULL || version->epoch < found->epoch)) {
+            found = version;
+        }
+    }
+    return found;
+}
+
+/**
+ * @brief This method turns the swizzled child pointers in a copy of an internal node into page numbers
+ * The frames are not touched, since the copy is not the node they point back to.
+ * 
+ * @param pager 
+ * @param page 
+ */
+void unswizzle_page_copy(Pager* pager, void* page) {
+    if (*node_type(page) != INTERNAL_NODE) {
+        return;
+    }
+    uint32_t num_keys = *internal_node_num_keys(page);
+    if (num_keys > INTERNAL_NODE_MAX_KEYS) {
+        return;
+    }
+    for (uint32_t i = 0; i <= num_keys; i++) {
+        uint32_t* child_pointer = internal_node_child_at(page, i);
+        *child_pointer = get_child_page_num(pager, *child_pointer);
+    }
+}
+
+/**
+ * @brief This method saves the image of a page that an operation is about to change, if an open snapshot still
+ * needs it
+ * It is called by latch_node() before the frame is latched, so a snapshot reader that still sees the old version
+ * of the frame finds the saved image once the frame changes.
+ * 
+ * @param pager 
+ * @param frame 
+ */
+void snapshot_save_page_version(Pager* pager, Frame* frame) {
+    Snapshot* newest = pager->snapshots;
+    uint32_t page_num = frame->page_num;
+    //  Pages past the end of the newest snapshot are not in any snapshot
+    if (page_num >= newest->num_pages) {
+        return;
+    }
+    pthread_mutex_lock(&pager->snapshot_mutex);
+    int saved = find_page_version(pager, page_num, newest->epoch) != NULL;
+    pthread_mutex_unlock(&pager->snapshot_mutex);
+    if (saved) {
+        return;
+    }
+
+    PageVersion* version = malloc(sizeof(PageVersion));
+    version->page_num = page_num;
+    version->epoch = newest->epoch;
+    version->page = malloc(PAGE_SIZE);
+    memcpy(version->page, frame->page, PAGE_SIZE);
+    //  Pointers are only unswizzled under the pager latch, so the frames of the swizzled pointers stay put
+    pthread_mutex_lock(&pager->latch);
+    unswizzle_page_copy(pager, version->page);
+    pthread_mutex_unlock(&pager->latch);
+
+    pthread_mutex_lock(&pager->snapshot_mutex);
+    PageVersion** bucket = page_version_bucket(pager, page_num);
+    version->next = *bucket;
+    *bucket = version;
+    pager->num_page_versions++;
+    pthread_mutex_unlock(&pager->snapshot_mutex);
+    STATS_ADD(pager, page_versions, 1);
+}
+
+/**
+ * @brief This method opens a snapshot of the tree as it is between operations
+ * 
+ * @param pager 
+ * @return Snapshot* 
+ */
+Snapshot* snapshot_open(Pager* pager) {
+    Snapshot* snapshot = malloc(sizeof(Snapshot));
+    snapshot->pager = pager;
+    snapshot->page = malloc(PAGE_SIZE);
+    pthread_mutex_lock(&pager->write_latch);
+    if (pager->page_versions == NULL) {
+        pager->page_versions = calloc(PAGE_VERSION_BUCKETS, sizeof(PageVersion*));
+    }
+    snapshot->epoch = ++pager->snapshot_epoch;
+    snapshot->root_page_num = pager->root_page_num;
+    snapshot->bytes_root_page_num = pager->bytes_root_page_num;
+    snapshot->num_pages = pager->num_pages;
+    snapshot->next = pager->snapshots;
+    pager->snapshots = snapshot;
+    pthread_mutex_unlock(&pager->write_latch);
+    return snapshot;
+}
+
+/**
+ * @brief This method checks whether an open snapshot still reads a version
+ * 
+ * @param pager 
+ * @param version 
+ * @return int 
+ */
+int page_version_is_needed(Pager* pager, PageVersion* version) {
+    for (Snapshot* snapshot = pager->snapshots; snapshot != NULL; snapshot = snapshot->next) {
+        if (snapshot->epoch <= version->epoch && find_page_version(pager, version->page_num, snapshot->epoch) == version) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief This method closes a snapshot and frees the page versions that only it read
+ * 
+ * @param snapshot 
+ */
+void snapshot_close(Snapshot* snapshot) {
+    Pager* pager = snapshot->pager;
+    pthread_mutex_lock(&pager->write_latch);
+    Snapshot** link = &pager->snapshots;
+    while (*link != snapshot) {
+        link = &(*link)->next;
+    }
+    *link = snapshot->next;
+
+    pthread_mutex_lock(&pager->snapshot_mutex);
+    for (uint32_t i = 0; i < PAGE_VERSION_BUCKETS; i++) {
+        PageVersion** version_link = &pager->page_versions[i];
+        while (*version_link != NULL) {
+            PageVersion* version = *version_link;
+            if (pager->snapshots != NULL && page_version_is_needed(pager, version)) {
+                version_link = &version->next;
+                continue;
+            }
+            *version_link = version->next;
+            free(version->page);
+            free(version);
+            pager->num_page_versions--;
+        }
+    }
+    pthread_mutex_unlock(&pager->snapshot_mutex);
+    pthread_mutex_unlock(&pager->write_latch);
+    free(snapshot->page);
+    free(snapshot);
+}
+
+/**
+ * @brief This method copies a page as it was when a snapshot was opened
+ * The version of the frame is read before the version store is searched. A writer saves the image before it
+ * latches the frame, so a copy of the frame that validates was taken before the page changed.
+ * 
+ * @param snapshot 
+ * @param page_num 
+ * @param page 
+ */
+void snapshot_read_page(Snapshot* snapshot, uint32_t page_num, void* page) {
+    Pager* pager = snapshot->pager;
+    if (page_num == META_PAGE_NUM || page_num >= snapshot->num_pages) {
+        fprintf(stderr, "Page %d is not in the snapshot\n", page_num);
+        exit(EXIT_FAILURE);
+    }
+    STATS_COUNT(node_visits, 1);
+    while (1) {
+        uint64_t frame_version;
+        Frame* frame = &pager->frames[fix_page_optimistic(pager, page_num, &frame_version)];
+
+        pthread_mutex_lock(&pager->snapshot_mutex);
+        PageVersion* version = find_page_version(pager, page_num, snapshot->epoch);
+        if (version != NULL) {
+            memcpy(page, version->page, PAGE_SIZE);
+        }
+        pthread_mutex_unlock(&pager->snapshot_mutex);
+        if (version != NULL) {
+            return;
+        }
+
+        memcpy(page, frame->page, PAGE_SIZE);
+        unswizzle_page_copy(pager, page);
+        if (frame_validate_version(frame, frame_version)) {
+            return;
+        }
+        STATS_COUNT(restarts, 1);
+    }
+}
+
+/**
+ * @brief This method reads the leaf of a snapshot that covers a key into a page
+ * 
+ * @param snapshot 
+ * @param key 
+ * @param page 
+ * @return int 0 if the tree of the snapshot is empty
+ */
+int snapshot_descend(Snapshot* snapshot, uint32_t key, void* page) {
+    snapshot_read_page(snapshot, snapshot->root_page_num, page);
+    if (*(char*)node_initialized(page) != NODE_INITIALIZED) {
+        return 0;
+    }
+    while (*node_type(page) == INTERNAL_NODE) {
+        uint32_t num_keys = *internal_node_num_keys(page);
+        uint32_t index = key == UINT32_MAX ? num_keys : key_lower_bound(internal_node_key(page, 0), num_keys, key + 1);
+        snapshot_read_page(snapshot, *internal_node_child_at(page, index), page);
+    }
+    return 1;
+}
+
+/**
+ * @brief This method looks up the value a key had when a snapshot was opened
+ * 
+ * @param snapshot 
+ * @param key 
+ * @param value Set to the value of the key if it was found
+ * @return int 1 if the key was found, -1 otherwise
+ */
+int snapshot_get(Snapshot* snapshot, uint32_t key, uint32_t* value) {
+    Pager* pager = snapshot->pager;
+    uint64_t start_time = stats_operation_start(pager);
+    int result = -1;
+    void* node = snapshot->page;
+    if (snapshot_descend(snapshot, key, node)) {
+        uint32_t num_cells = *leaf_node_num_cells(node);
+        uint32_t key_index = key_lower_bound(leaf_node_key(node, 0), num_cells, key);
+        if (key_index < num_cells && *leaf_node_key(node, key_index) == key) {
+            *value = *leaf_node_value(node, key_index);
+            result = 1;
+        }
+    }
+    stats_operation_finish(pager, OPERATION_GET, start_time);
+    return result;
+}
+
+/**
+ * @brief This method opens a cursor over a snapshot positioned before the first key that is not smaller than lo
+ * The cursor keeps a copy of its leaf, so it can stay open for as long as the snapshot does.
+ * 
+ * @param snapshot 
+ * @param lo 
+ * @return SnapshotCursor* 
+ */
+SnapshotCursor* snapshot_cursor_open(Snapshot* snapshot, uint32_t lo) {
+    Pager* pager = snapshot->pager;
+    uint64_t start_time = stats_operation_start(pager);
+    SnapshotCursor* cursor = malloc(sizeof(SnapshotCursor));
+    cursor->snapshot = snapshot;
+    cursor->node = malloc(PAGE_SIZE);
+    cursor->cell_num = 0;
+    if (snapshot_descend(snapshot, lo, cursor->node)) {
+        uint32_t num_cells = *leaf_node_num_cells(cursor->node);
+        cursor->cell_num = key_lower_bound(leaf_node_key(cursor->node, 0), num_cells, lo);
+    } else {
+        free(cursor->node);
+        cursor->node = NULL;
+    }
+    stats_operation_finish(pager, OPERATION_SCAN, start_time);
+    return cursor;
+}
+
+/**
+ * @brief This method returns the entry after a snapshot cursor and moves the cursor past it
+ * 
+ * @param cursor 
+ * @param key 
+ * @param value 
+ * @return int 1 if an entry was returned, 0 at the end of the tree
+ */
+int snapshot_cursor_next(SnapshotCursor* cursor, uint32_t* key, uint32_t* value) {
+    if (cursor->node == NULL) {
+        return 0;
+    }
+    //  Leaves that deletes have emptied are skipped
+    while (cursor->cell_num >= *leaf_node_num_cells(cursor->node)) {
+        uint32_t right_sibling_page_num = *leaf_node_right_sibling_pointer(cursor->node);
+        if (right_sibling_page_num == INVALID_PAGE_NUM) {
+            return 0;
+        }
+        snapshot_read_page(cursor->snapshot, right_sibling_page_num, cursor->node);
+        cursor->cell_num = 0;
+    }
+    *key = *leaf_node_key(cursor->node, cursor->cell_num);
+    *value = *leaf_node_value(cursor->node, cursor->cell_num);
+    cursor->cell_num++;
+    return 1;
+}
+
+void snapshot_cursor_close(SnapshotCursor* cursor) {
+    free(cursor->node);
+    free(cursor);
+}
+
+PagerOptions default_pager_options() {
+    PagerOptions options;
+    options.buffer_pool_size = DEFAULT_BUFFER_POOL_SIZE;
+    options.swizzle_pointers = 0;
+    options.readahead_pages = DEFAULT_READAHEAD_PAGES;
+    options.wal_enabled = 1;
+    options.synchronous_commit = 1;
+    options.group_commit_delay_us = 0;
+    options.io_backend = IO_BACKEND_AUTO;
+    options.direct_io = 0;
+    options.checkpoint_pages_per_second = DEFAULT_CHECKPOINT_PAGES_PER_SECOND;
+    options.checkpoint_log_size = DEFAULT_CHECKPOINT_LOG_SIZE;
+    options.huge_pages = HUGE_PAGES_TRANSPARENT;
+    options.memory_mapped = 0;
+    options.mmap_reserve_size = DEFAULT_MMAP_RESERVE_SIZE;
+    options.track_latency = 0;
+    options.operation_trace_filename = NULL;
+    options.key_comparator = NULL;
+    options.hash_index_size = 0;
+    return options;
+}
+
+Pager* open_database_file(const char* filename) {
+    PagerOptions options = default_pager_options();
+    return open_database_file_with_options(filename, &options);
+}
+
+/**
+ * Frame arena
+ * The frame buffer is one anonymous mapping, aligned to and rounded up to HUGE_PAGE_SIZE, so that it can be backed
+ * by huge pages and a descent through the pool costs a handful of TLB entries instead of one per page. On machines
+ * with more than one NUMA node the buffer is interleaved across the nodes, since every thread reads every frame.
+ */
+
+/**
+ * @brief This method spreads a range of memory across the online NUMA nodes, if there is more than one
+ * 
+ * @param start 
+ * @param length 
+ */
+void frame_arena_interleave(void* start, size_t length) {
+#if defined(__linux__) && defined(__NR_mbind)
+    FILE* file = fopen("/sys/devices/system/node/online", "r");
+    if (file == NULL) {
+        return;
+    }
+    //  The list looks like "0-3" or "0,2"
+    unsigned long node_mask = 0;
+    uint32_t first, last;
+    char separator;
+    while (fscanf(file, "%u", &first) == 1) {
+        last = first;
+        int result = fscanf(file, "%c", &separator);
+        if (result == 1 && separator == '-') {
+            if (fscanf(file, "%u", &last) != 1) {
+                break;
+            }
+            result = fscanf(file, "%c", &separator);
+        }
+        for (uint32_t node = first; node <= last && node < 8 * sizeof(node_mask); node++) {
+            node_mask |= 1ul << node;
+        }
+        if (result != 1 || separator != ',') {
+            break;
+        }
+    }
+    fclose(file);
+    if (__builtin_popcountl(node_mask) > 1 &&
+        syscall(__NR_mbind, start, length, MPOL_INTERLEAVE, &node_mask, 8 * sizeof(node_mask), 0) == -1) {
+        fprintf(stderr, "Unable to interleave the buffer pool across NUMA nodes\n");
+    }
+#endif
+}
+
+/**
+ * @brief This method maps the memory for the frame buffer
+ * Explicit huge pages come from the pool the administrator reserved, and the buffer falls back to transparent huge
+ * pages with a warning if there are not enough of them
+ * 
+ * @param size 
+ * @param mode 
+ * @param mapped_size Set to the size of the mapping, which has to be passed to munmap
+ * @return void* 
+ */
+void* frame_arena_allocate(size_t size, HugePageMode mode, size_t* mapped_size) {
+    size = (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    *mapped_size = size;
+#ifdef MAP_HUGETLB
+    if (mode == HUGE_PAGES_EXPLICIT) {
+        void* buffer = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (buffer != MAP_FAILED) {
+            frame_arena_interleave(buffer, size);
+            return buffer;
+        }
+        fprintf(stderr, "Not enough huge pages are reserved for the buffer pool, using transparent huge pages\n");
+        mode = HUGE_PAGES_TRANSPARENT;
+    }
+#endif
+
+    //  Map one huge page more than needed and trim both ends, which leaves a range aligned to a huge page
+    void* mapping = mmap(NULL, size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+        fprintf(stderr, "Unable to allocate the buffer pool\n");
+        exit(EXIT_FAILURE);
+    }
+    uintptr_t start = ((uintptr_t)mapping + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    if (start > (uintptr_t)mapping) {
+        munmap(mapping, start - (uintptr_t)mapping);
+    }
+    uintptr_t end = (uintptr_t)mapping + size + HUGE_PAGE_SIZE;
+    if (end > start + size) {
+        munmap((void*)(start + size), end - (start + size));
+    }
+    void* buffer = (void*)start;
+#ifdef MADV_HUGEPAGE
+    if (mode == HUGE_PAGES_TRANSPARENT) {
+        madvise(buffer, size, MADV_HUGEPAGE);
+    }
+#endif
+    frame_arena_interleave(buffer, size);
+    return buffer;
+}
+
+/**
+ * @brief This method sets up the frames, the frame buffer and the page table of the buffer pool
+ * 
+ * @param pager 
+ * @param options 
+ */
+void buffer_pool_open(Pager* pager, PagerOptions* options) {
+    pager->num_frames = options->buffer_pool_size;
+    pager->num_frames_used = 0;
+    pager->clock_hand = 0;
+    pager->frames = calloc(pager->num_frames, sizeof(Frame));
+    //  The frames share one buffer so that the frame holding a node can be found from the node's address.
+    //  Being aligned to a huge page, it is also aligned to the block size of the device, as direct I/O needs.
+    pager->frame_buffer = frame_arena_allocate((size_t)pager->num_frames * PAGE_SIZE, options->huge_pages,
+        &pager->frame_buffer_size);
+    for (uint32_t i = 0; i < pager->num_frames; i++) {
+        pager->frames[i].page = pager->frame_buffer + (size_t)i * PAGE_SIZE;
+        pager->frames[i].next_in_bucket = -1;
+        pager->frames[i].swizzled_parent = -1;
+    }
+
+    //  Size the page table to the next power of two that is at least twice the number of frames
+    //  so that the chains stay short
+    uint32_t page_table_size = 1;
+    while (page_table_size < 2 * pager->num_frames) {
+        page_table_size <<= 1;
+    }
+    pager->page_table_mask = page_table_size - 1;
+    pager->page_table = malloc(page_table_size * sizeof(int32_t));
+    for (uint32_t i = 0; i < page_table_size; i++) {
+        pager->page_table[i] = -1;
+    }
+}
+
+/**
+ * Memory-mapped pages
+ * Instead of a buffer pool, the pager can map the database file and hand out page addresses in the mapping, so
+ * resident pages are read without a copy or a system call. Frame i holds page i for as long as the file is open,
+ * so nothing is ever evicted and the page table is not needed.
+ * The mapping is private. A change to a page stays in memory until the pager writes the page out with pwrite, the
+ * same way it writes frames of the buffer pool, so the kernel never writes back a page before the log allows it.
+ * The address range for the whole mapping is reserved up front, and the file is mapped into it in extents as it
+ * grows, so pages never move while readers hold pointers to them.
+ */
+
+/**
+ * @brief This method reserves the address range of the mapping and the frames that go with it
+ * The frames are anonymous memory, so only those of mapped pages take up memory
+ * 
+ * @param pager 
+ * @param options 
+ */
+void mmap_open(Pager* pager, PagerOptions* options) {
+    //  Pages are handed out by their place in the mapping, so pointers are never swizzled
+    pager->swizzle_pointers = 0;
+    pager->mmap_max_pages = options->mmap_reserve_size / PAGE_SIZE;
+    pager->mmap_base = mmap(NULL, (size_t)pager->mmap_max_pages * PAGE_SIZE, PROT_NONE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    pager->frames = mmap(NULL, (size_t)pager->mmap_max_pages * sizeof(Frame), PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (pager->mmap_base == MAP_FAILED || pager->frames == MAP_FAILED) {
+        fprintf(stderr, "Unable to reserve %lu bytes for the mapping\n", options->mmap_reserve_size);
+        exit(EXIT_FAILURE);
+    }
+    pager->frame_buffer = pager->mmap_base;
+    pager->num_frames = 0;
+    pager->num_frames_used = 0;
+    pager->clock_hand = 0;
+    pager->page_table = NULL;
+    pager->page_table_mask = 0;
+}
+
+/**
+ * @brief This method maps the file up to at least a number of pages, extending the file first if it is shorter
+ * The mapping grows by MMAP_EXTENT_PAGES at a time. The caller holds the pager latch, or is opening the file.
+ * 
+ * @param pager 
+ * @param num_pages 
+ */
+void mmap_grow(Pager* pager, uint32_t num_pages) {
+    uint32_t old_num_pages = pager->num_frames;
+    if (num_pages <= old_num_pages) {
+        return;
+    }
+    uint32_t new_num_pages = (num_pages + MMAP_EXTENT_PAGES - 1) / MMAP_EXTENT_PAGES * MMAP_EXTENT_PAGES;
+    if (new_num_pages > pager->mmap_max_pages) {
+        new_num_pages = pager->mmap_max_pages;
+    }
+    if (num_pages > new_num_pages) {
+        fprintf(stderr, "The database file does not fit into the %u pages reserved for the mapping\n", pager->mmap_max_pages);
+        exit(EXIT_FAILURE);
+    }
+
+    //  Touching a mapped page past the end of the file is a bus error
+    struct stat file_stat;
+    if (fstat(pager->file_descriptor, &file_stat) == -1) {
+        fprintf(stderr, "Error reading the size of the database file\n");
+        exit(EXIT_FAILURE);
+    }
+    if (file_stat.st_size < (off_t)new_num_pages * PAGE_SIZE &&
+        ftruncate(pager->file_descriptor, (off_t)new_num_pages * PAGE_SIZE) == -1) {
+        fprintf(stderr, "Error extending the database file\n");
+        exit(EXIT_FAILURE);
+    }
+    void* start = pager->mmap_base + (size_t)old_num_pages * PAGE_SIZE;
+    size_t length = (size_t)(new_num_pages - old_num_pages) * PAGE_SIZE;
+    if (mmap(start, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, pager->file_descriptor,
+            (off_t)old_num_pages * PAGE_SIZE) == MAP_FAILED) {
+        fprintf(stderr, "Error mapping the database file\n");
+        exit(EXIT_FAILURE);
+    }
+    //  Point lookups touch scattered pages, so the kernel should not read around a fault
+    madvise(start, length, MADV_RANDOM);
+
+    for (uint32_t i = old_num_pages; i < new_num_pages; i++) {
+        Frame* frame = &pager->frames[i];
+        frame->page = pager->frame_buffer + (size_t)i * PAGE_SIZE;
+        frame->page_num = i;
+        frame->next_in_bucket = -1;
+        frame->swizzled_parent = -1;
+    }
+    //  Readers look at the number of frames without the pager latch, so the frames are set up before it grows
+    __atomic_store_n(&pager->num_frames_used, new_num_pages, __ATOMIC_RELEASE);
+    __atomic_store_n(&pager->num_frames, new_num_pages, __ATOMIC_RELEASE);
+}
+
+void mmap_close(Pager* pager) {
+    munmap(pager->mmap_base, (size_t)pager->mmap_max_pages * PAGE_SIZE);
+    munmap(pager->frames, (size_t)pager->mmap_max_pages * sizeof(Frame));
+}
+
+Pager* open_database_file_with_options(const char* filename, PagerOptions* options) {
+    //  Pages of a mapping come from the page cache, so direct I/O does not apply
+    uint8_t direct_io = options->direct_io && !options->memory_mapped;
+    int fd = open(filename, O_RDWR | O_CREAT | (direct_io ? O_DIRECT : 0), S_IRUSR | S_IWUSR);
+    if (fd == -1 && direct_io && errno == EINVAL) {
+        //  Some file systems, tmpfs among them, do not support direct I/O
+        fprintf(stderr, "Direct I/O is not supported for %s, using the page cache\n", filename);
+        direct_io = 0;
+        fd = open(filename, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+    }
+    if (fd == -1) {
+        fprintf(stderr, "Unable to open file\n");
+        exit(EXIT_FAILURE);
+    }
+    off_t file_length = lseek(fd, 0, SEEK_END);
+
+    if (options->buffer_pool_size == 0) {
+        fprintf(stderr, "The buffer pool needs at least one frame\n");
+        exit(EXIT_FAILURE);
+    }
+
+    Pager* pager = malloc(sizeof(Pager));
+    pager->file_descriptor = fd;
+    pager->file_length = file_length;
+    pager->swizzle_pointers = options->swizzle_pointers;
+    pager->readahead_pages = options->readahead_pages < MAX_READAHEAD_PAGES ? options->readahead_pages : MAX_READAHEAD_PAGES;
+    pager->mmap_base = NULL;
+    if (options->memory_mapped) {
+        mmap_open(pager, options);
+    } else {
+        buffer_pool_open(pager, options);
+    }
+    reset_buffer_pool_stats(pager);
+    if (posix_memalign((void**)&pager->tree_stats, 64, TREE_STATS_SHARDS * TREE_STATS_SHARD_SIZE) != 0) {
+        fprintf(stderr, "Unable to allocate the tree stats\n");
+        exit(EXIT_FAILURE);
+    }
+    memset(pager->tree_stats, 0, TREE_STATS_SHARDS * TREE_STATS_SHARD_SIZE);
+    pager->track_latency = options->track_latency;
+    pager->hash_index = NULL;
+    pager->hash_index_mask = 0;
+    if (options->hash_index_size >= sizeof(HashIndexEntry)) {
+        //  The table is a power of two entries that fits in the size
+        uint64_t num_entries = 1;
+        while (num_entries * 2 * sizeof(HashIndexEntry) <= options->hash_index_size && num_entries < (1ull << 31)) {
+            num_entries *= 2;
+        }
+        pager->hash_index = malloc(num_entries * sizeof(HashIndexEntry));
+        pager->hash_index_mask = num_entries - 1;
+        for (uint64_t i = 0; i < num_entries; i++) {
+            pager->hash_index[i] = (HashIndexEntry){0, INVALID_PAGE_NUM, 0, 0};
+        }
+    }
+    pager->operation_trace = NULL;
+    if (options->operation_trace_filename != NULL) {
+        pager->operation_trace = operation_trace_open(options->operation_trace_filename);
+    }
+
+    pthread_mutex_init(&pager->latch, NULL);
+    pthread_mutex_init(&pager->write_latch, NULL);
+    pthread_mutex_init(&pager->overflow_mutex, NULL);
+    pthread_mutex_init(&pager->snapshot_mutex, NULL);
+    pager->snapshots = NULL;
+    pager->snapshot_epoch = 0;
+    pager->page_versions = NULL;
+    pager->num_page_versions = 0;
+
+    //  Opening a file only reads its meta page, every other page is read when it is first needed
+    if (posix_memalign(&pager->meta_page, 4096, PAGE_SIZE) != 0) {
+        fprintf(stderr, "Unable to allocate the meta page\n");
+        exit(EXIT_FAILURE);
+    }
+    wal_initialize_checksum_table();
+    if (file_length == 0) {
+        pager->root_page_num = META_PAGE_NUM + 1;
+        pager->num_pages = META_PAGE_NUM + 2;
+        pager->free_list_head = INVALID_PAGE_NUM;
+        pager->bytes_root_page_num = INVALID_PAGE_NUM;
+        pager->unlinked_overflow_page_num = INVALID_PAGE_NUM;
+        pager_write_meta_page(pager);
+        if (fdatasync(fd) == -1) {
+            fprintf(stderr, "Error syncing the database file\n");
+            exit(EXIT_FAILURE);
+        }
+    } else {
+        pager_read_meta_page(pager);
+    }
+    if (pager->mmap_base != NULL) {
+        mmap_grow(pager, pager->num_pages > file_length / PAGE_SIZE ? pager->num_pages : file_length / PAGE_SIZE);
+    }
+    pager->in_operation = 0;
+    //  An operation changes a node, a new or merged sibling, a neighbouring leaf and a freed page on each level at most,
+    //  and a new or collapsed root, however many frames the buffer pool or the mapping has
+    pager->operation_frames = malloc(MAX_OPERATION_FRAMES * sizeof(uint32_t));
+    pager->num_operation_frames = 0;
+    pager->path.depth = 0;
+    pager->append_leaf_page_num = INVALID_PAGE_NUM;
+    pager->compare_keys = options->key_comparator != NULL ? options->key_comparator : compare_bytes;
+
+    pager->direct_io = direct_io;
+    pager->io_ring = NULL;
+    //  The frames of a mapping cannot be registered with io_uring, and its pages are written with pwrite
+    if (options->io_backend != IO_BACKEND_PREAD && pager->mmap_base == NULL) {
+        pager->io_ring = io_ring_open(pager, IO_RING_ENTRIES);
+        if (pager->io_ring == NULL && options->io_backend == IO_BACKEND_IO_URING) {
+            fprintf(stderr, "io_uring is not available\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    pager->wal = NULL;
+    if (options->wal_enabled) {
+        wal_open(pager, filename, options);
+        //  A crash between the operations that write or free an overflow chain leaves the chain to recovery
+        wal_wait_for_commit(pager, bytes_free_overflow_chain(pager, pager->unlinked_overflow_page_num, 0));
+    } else {
+        //  Without the log nothing after the last checkpoint is known, so an unlinked chain there may be linked by now
+        pager->unlinked_overflow_page_num = INVALID_PAGE_NUM;
+    }
+
+    pager->checkpoint_pages_per_second = options->checkpoint_pages_per_second;
+    pager->checkpoint_log_size = options->checkpoint_log_size;
+    pager->checkpointer_running = 0;
+    if (pager->checkpoint_pages_per_second > 0) {
+        checkpointer_start(pager);
+    }
+    return pager;
+}
+
+/**
+ * Node latches
+ * The version of a frame is the optimistic latch of the node it holds. A writer makes the version odd while it
+ * changes the node and moves it on to the next even version when it is done, so a reader that sees the same even
+ * version before and after reading a node has read a consistent node. The frame is latched the same way while it
+ * is handed to another page.
+ */
+uint64_t frame_read_version(Frame* frame) {
+    uint32_t spins = 0;
+    uint64_t version;
+    while ((version = __atomic_load_n(&frame->version, __ATOMIC_ACQUIRE)) & 1) {
+        if (++spins % 64 == 0) {
+            sched_yield();
+        }
+    }
+    return version;
+}
+
+int frame_validate_version(Frame* frame, uint64_t version) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&frame->version, __ATOMIC_RELAXED) == version;
+}
+
+int frame_try_write_lock(Frame* frame) {
+    uint64_t version = __atomic_load_n(&frame->version, __ATOMIC_RELAXED);
+    return (version & 1) == 0 &&
+        __atomic_compare_exchange_n(&frame->version, &version, version + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+}
+
+void frame_write_lock(Frame* frame) {
+    uint32_t spins = 0;
+    while (!frame_try_write_lock(frame)) {
+        if (++spins % 64 == 0) {
+            sched_yield();
+        }
+    }
+}
+
+void frame_write_unlock(Frame* frame) {
+    __atomic_store_n(&frame->version, frame->version + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Operations
+ * An insert, delete or bulk load is one operation. Operations are serialized by the write latch. Before an
+ * operation changes a node it latches the node with latch_node(), and the node stays latched, and in the buffer
+ * pool, until the operation ends.
+ */
+void begin_operation(Pager* pager) {
+    pthread_mutex_lock(&pager->write_latch);
+    pager->in_operation = 1;
+    pager->operation_thread = pthread_self();
+    wal_begin_operation(pager);
+}
+
+void latch_node(Pager* pager, void* node) {
+    if (!pager->in_operation) {
+        return;
+    }
+    int32_t frame_index = get_frame_index(pager, node);
+    Frame* frame = &pager->frames[frame_index];
+    if (frame->in_operation) {
+        return;
+    }
+    if (pager->num_operation_frames == MAX_OPERATION_FRAMES) {
+        fprintf(stderr, "An operation latched more than %d nodes\n", MAX_OPERATION_FRAMES);
+        exit(EXIT_FAILURE);
+    }
+    if (pager->snapshots != NULL) {
+        snapshot_save_page_version(pager, frame);
+    }
+    frame_write_lock(frame);
+    frame->in_operation = 1;
+    pager->operation_frames[pager->num_operation_frames++] = frame_index;
+}
+
+/**
+ * @brief This method logs the operation, releases its nodes and the write latch, and then waits for the commit
+ * to be durable, so that the next operation can run while the log is synced
+ * 
+ * @param pager 
+ */
+void end_operation(Pager* pager) {
+    wal_wait_for_commit(pager, release_operation(pager));
+}
+
+/**
+ * @brief This method logs the operation and releases its nodes and the write latch, without waiting for the commit
+ * It is for operations that are only part of a change, whose last operation waits for the log to be durable.
+ * 
+ * @param pager 
+ * @return uint64_t The LSN the log has to be durable up to for the operation to be committed, 0 if there is none
+ */
+uint64_t release_operation(Pager* pager) {
+    uint64_t commit_lsn = wal_commit_operation(pager);
+    for (uint32_t i = 0; i < pager->num_operation_frames; i++) {
+        Frame* frame = &pager->frames[pager->operation_frames[i]];
+        frame->in_operation = 0;
+        frame->needs_image = 0;
+        frame_write_unlock(frame);
+    }
+    pager->num_operation_frames = 0;
+    pager->in_operation = 0;
+    pthread_mutex_unlock(&pager->write_latch);
+    return commit_lsn;
+}
+
+/**
+ * Page table methods
+ * The page table maps a page number to the frame holding it. It is changed under the pager latch, but readers
+ * walk it without the latch, so its links are read and written atomically.
+ */
+int32_t page_table_lookup(Pager* pager, uint32_t page_num) {
+    if (pager->mmap_base != NULL) {
+        return page_num < pager->num_frames ? (int32_t)page_num : -1;
+    }
+    int32_t frame_index = pager->page_table[page_num & pager->page_table_mask];
+    while (frame_index != -1 && pager->frames[frame_index].page_num != page_num) {
+        frame_index = pager->frames[frame_index].next_in_bucket;
+    }
+    return frame_index;
+}
+
+/**
+ * @brief This method looks a page up without the pager latch and reads the version of its frame
+ * A chain can change while it is walked, so the walk gives up after visiting every frame once. Once the version
+ * is known, the frame is checked to still hold the page, after which any change to the frame changes its version.
+ * 
+ * @param pager 
+ * @param page_num 
+ * @param version 
+ * @return int32_t The frame, or -1 if the page was not found
+ */
+int32_t page_table_lookup_optimistic(Pager* pager, uint32_t page_num, uint64_t* version) {
+    if (pager->mmap_base != NULL) {
+        if (page_num >= __atomic_load_n(&pager->num_frames, __ATOMIC_ACQUIRE)) {
+            return -1;
+        }
+        *version = frame_read_version(&pager->frames[page_num]);
+        return page_num;
+    }
+    int32_t frame_index = __atomic_load_n(&pager->page_table[page_num & pager->page_table_mask], __ATOMIC_ACQUIRE);
+    for (uint32_t steps = 0; frame_index != -1 && steps < pager->num_frames; steps++) {
+        Frame* frame = &pager->frames[frame_index];
+        if (__atomic_load_n(&frame->page_num, __ATOMIC_ACQUIRE) == page_num) {
+            *version = frame_read_version(frame);
+            if (__atomic_load_n(&frame->page_num, __ATOMIC_ACQUIRE) != page_num) {
+                return -1;
+            }
+            STATS_COUNT(buffer_hits, 1);
+            return frame_index;
+        }
+        frame_index = __atomic_load_n(&frame->next_in_bucket, __ATOMIC_ACQUIRE);
+    }
+    return -1;
+}
+
+/**
+ * @brief This method returns the frame holding a page and its version for an optimistic read
+ * A page that is not resident is read in with get_page(). It is unpinned right away, since the version check
+ * of the reader catches the frame being reused.
+ * 
+ * @param pager 
+ * @param page_num 
+ * @param version 
+ * @return int32_t 
+ */
+int32_t fix_page_optimistic(Pager* pager, uint32_t page_num, uint64_t* version) {
+    int32_t frame_index = page_table_lookup_optimistic(pager, page_num, version);
+    if (frame_index != -1) {
+        return frame_index;
+    }
+    void* node = get_page(pager, page_num);
+    frame_index = get_frame_index(pager, node);
+    *version = frame_read_version(&pager->frames[frame_index]);
+    unpin_node(pager, node);
+    return frame_index;
+}
+
+void page_table_insert(Pager* pager, uint32_t page_num, int32_t frame_index) {
+    uint32_t bucket = page_num & pager->page_table_mask;
+    __atomic_store_n(&pager->frames[frame_index].next_in_bucket, pager->page_table[bucket], __ATOMIC_RELEASE);
+    __atomic_store_n(&pager->page_table[bucket], frame_index, __ATOMIC_RELEASE);
+}
+
+void page_table_remove(Pager* pager, uint32_t page_num) {
+    int32_t* link = &pager->page_table[page_num & pager->page_table_mask];
+    while (*link != -1) {
+        Frame* frame = &pager->frames[*link];
+        if (frame->page_num == page_num) {
+            __atomic_store_n(link, frame->next_in_bucket, __ATOMIC_RELEASE);
+            __atomic_store_n(&frame->next_in_bucket, -1, __ATOMIC_RELEASE);
+            return;
+        }
+        link = &frame->next_in_bucket;
+    }
+}
+
+/**
+ * Pointer swizzling
+ * While swizzling is enabled, a child pointer in a resident internal node can hold the index of the frame
+ * that holds the child instead of its page number, so that the descent does not need the page table.
+ * Swizzled pointers are tagged with SWIZZLED_POINTER_FLAG and never reach the disk.
+ */
+uint32_t is_swizzled(uint32_t child_pointer) {
+    return (child_pointer & SWIZZLED_POINTER_FLAG) != 0;
+}
+
+uint32_t get_child_page_num(Pager* pager, uint32_t child_pointer) {
+    if (is_swizzled(child_pointer)) {
+        return pager->frames[child_pointer & ~SWIZZLED_POINTER_FLAG].page_num;
+    }
+    return child_pointer;
+}
+
+/**
+ * @brief This method turns every swizzled child pointer in a node back into a page number
+ * It has to run before the node is written out or its frame is reused
+ * 
+ * @param pager 
+ * @param node 
+ */
+void unswizzle_children(Pager* pager, void* node) {
+    if (*node_type(node) != INTERNAL_NODE) {
+        return;
+    }
+    uint32_t num_keys = *internal_node_num_keys(node);
+    for (uint32_t i = 0; i <= num_keys; i++) {
+        uint32_t* child_pointer = internal_node_child_at(node, i);
+        if (is_swizzled(*child_pointer)) {
+            Frame* child_frame = &pager->frames[*child_pointer & ~SWIZZLED_POINTER_FLAG];
+            *child_pointer = child_frame->page_num;
+            child_frame->swizzled_parent = -1;
+        }
+    }
+}
+
+/**
+ * @brief This method turns the pointer to a frame in its parent back into a page number
+ * It has to run before the frame is reused for another page. The parent is latched while the pointer changes,
+ * so that readers that followed the old pointer notice. A parent held by the operation of the calling thread is
+ * latched already, otherwise rebalancing a node with many resident children could run out of frames.
+ * 
+ * @param pager 
+ * @param frame_index 
+ * @return int 0 if the parent is latched by someone else
+ */
+int unswizzle_from_parent(Pager* pager, int32_t frame_index) {
+    Frame* frame = &pager->frames[frame_index];
+    if (frame->swizzled_parent == -1) {
+        return 1;
+    }
+    Frame* parent_frame = &pager->frames[frame->swizzled_parent];
+    uint8_t latched_by_operation = parent_frame->in_operation && pthread_equal(pager->operation_thread, pthread_self());
+    if (!latched_by_operation && !frame_try_write_lock(parent_frame)) {
+        return 0;
+    }
+    void* parent_node = parent_frame->page;
+    uint32_t num_keys = *internal_node_num_keys(parent_node);
+    for (uint32_t i = 0; i <= num_keys; i++) {
+        uint32_t* child_pointer = internal_node_child_at(parent_node, i);
+        if (*child_pointer == (SWIZZLED_POINTER_FLAG | frame_index)) {
+            __atomic_store_n(child_pointer, frame->page_num, __ATOMIC_RELEASE);
+            break;
+        }
+    }
+    if (!latched_by_operation) {
+        frame_write_unlock(parent_frame);
+    }
+    frame->swizzled_parent = -1;
+    return 1;
+}
+
+/**
+ * @brief This method returns the pinned child that a child pointer of a node refers to
+ * If swizzling is enabled, the child pointer is swizzled once the child is resident, so later descents
+ * go straight to the frame. Only writers descend this way, readers follow child pointers optimistically.
+ * 
+ * @param pager 
+ * @param node 
+ * @param child_pointer 
+ * @return void* 
+ */
+void* get_child_node(Pager* pager, void* node, uint32_t* child_pointer) {
+    pthread_mutex_lock(&pager->latch);
+    //  Pointers are only unswizzled under the pager latch, so a pointer that is swizzled now stays valid
+    uint32_t pointer = __atomic_load_n(child_pointer, __ATOMIC_ACQUIRE);
+    if (is_swizzled(pointer)) {
+        Frame* frame = &pager->frames[pointer & ~SWIZZLED_POINTER_FLAG];
+        __atomic_fetch_add(&frame->pin_count, 1, __ATOMIC_SEQ_CST);
+        frame->reference_bit = 1;
+        pager->stats.hits++;
+        pager->stats.swizzled_hits++;
+        pthread_mutex_unlock(&pager->latch);
+        return frame->page;
+    }
+
+    void* child_node = get_page_locked(pager, pointer);
+    if (pager->swizzle_pointers) {
+        int32_t child_frame_index = get_frame_index(pager, child_node);
+        Frame* child_frame = &pager->frames[child_frame_index];
+        //  A child that is still swizzled in another frame is reached through a stale pointer, so leave it alone
+        if (child_frame->swizzled_parent == -1) {
+            child_frame->swizzled_parent = get_frame_index(pager, node);
+            __atomic_store_n(child_pointer, SWIZZLED_POINTER_FLAG | child_frame_index, __ATOMIC_RELEASE);
+        }
+    }
+    pthread_mutex_unlock(&pager->latch);
+    return child_node;
+}
+
+/**
+ * Page I/O
+ * Pages are read and written with io_uring when the kernel supports it, so that a batch of pages costs a single
+ * system call, and with pread and pwrite otherwise. Both run under the pager latch.
+ */
+#ifdef __linux__
+IoRing* io_ring_open(Pager* pager, uint32_t num_entries) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int ring_fd = syscall(__NR_io_uring_setup, num_entries, &params);
+    if (ring_fd == -1) {
+        return NULL;
+    }
+
+    IoRing* ring = calloc(1, sizeof(IoRing));
+    ring->ring_fd = ring_fd;
+    ring->num_entries = params.sq_entries;
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+    void* sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+    if (ring->sq_ring == MAP_FAILED || ring->cq_ring == MAP_FAILED || sqes == MAP_FAILED) {
+        if (ring->sq_ring != MAP_FAILED) {
+            munmap(ring->sq_ring, ring->sq_ring_size);
+        }
+        if (ring->cq_ring != MAP_FAILED) {
+            munmap(ring->cq_ring, ring->cq_ring_size);
+        }
+        if (sqes != MAP_FAILED) {
+            munmap(sqes, ring->sqes_size);
+        }
+        close(ring_fd);
+        free(ring);
+        return NULL;
+    }
+    ring->sqes = sqes;
+    ring->sq_head = ring->sq_ring + params.sq_off.head;
+    ring->sq_tail = ring->sq_ring + params.sq_off.tail;
+    ring->sq_ring_mask = ring->sq_ring + params.sq_off.ring_mask;
+    ring->sq_array = ring->sq_ring + params.sq_off.array;
+    ring->cq_head = ring->cq_ring + params.cq_off.head;
+    ring->cq_tail = ring->cq_ring + params.cq_off.tail;
+    ring->cq_ring_mask = ring->cq_ring + params.cq_off.ring_mask;
+    ring->cqes = ring->cq_ring + params.cq_off.cqes;
+
+    //  With the frames registered, the kernel does not have to map the buffer of every request
+    ring->has_fixed_buffers = 0;
+    struct iovec* buffers = malloc(pager->num_frames * sizeof(struct iovec));
+    for (uint32_t i = 0; i < pager->num_frames; i++) {
+        buffers[i].iov_base = pager->frames[i].page;
+        buffers[i].iov_len = PAGE_SIZE;
+    }
+    if (syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_BUFFERS, buffers, pager->num_frames) == 0) {
+        ring->has_fixed_buffers = 1;
+    }
+    free(buffers);
+    return ring;
+}
+
+void io_ring_close(IoRing* ring) {
+    munmap(ring->sqes, ring->sqes_size);
+    munmap(ring->cq_ring, ring->cq_ring_size);
+    munmap(ring->sq_ring, ring->sq_ring_size);
+    close(ring->ring_fd);
+    free(ring);
+}
+
+/**
+ * @brief This method submits the queued requests and waits until count of them have completed
+ * 
+ * @param ring 
+ * @param count 
+ */
+void io_ring_submit_and_wait(IoRing* ring, uint32_t count) {
+    while (1) {
+        uint32_t num_unsubmitted = *ring->sq_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+        uint32_t num_completed = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE) - *ring->cq_head;
+        if (num_unsubmitted == 0 && num_completed >= count) {
+            return;
+        }
+        uint32_t min_complete = num_completed < count ? count - num_completed : 0;
+        int result = syscall(__NR_io_uring_enter, ring->ring_fd, num_unsubmitted, min_complete, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (result == -1 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            fprintf(stderr, "Error submitting I/O: %d\n", errno);
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+/**
+ * @brief This method reads pages into frames or writes frames out to pages, and returns once all of it is done
+ * With io_uring, every IO_RING_ENTRIES pages cost one submission.
+ * 
+ * @param pager 
+ * @param is_write 
+ * @param frame_indices 
+ * @param page_nums 
+ * @param count 
+ */
+void pager_transfer_pages(Pager* pager, uint8_t is_write, const int32_t* frame_indices, const uint32_t* page_nums, uint32_t count) {
+    IoRing* ring = pager->io_ring;
+    if (ring == NULL) {
+        for (uint32_t i = 0; i < count; i++) {
+            void* page = pager->frames[frame_indices[i]].page;
+            off_t offset = (off_t)page_nums[i] * PAGE_SIZE;
+            ssize_t bytes = is_write ? pwrite(pager->file_descriptor, page, PAGE_SIZE, offset)
+                : pread(pager->file_descriptor, page, PAGE_SIZE, offset);
+            if (bytes != PAGE_SIZE) {
+                fprintf(stderr, "Error %s page %d\n", is_write ? "writing" : "reading", page_nums[i]);
+                exit(EXIT_FAILURE);
+            }
+            pager->stats.io_submissions++;
+        }
+        *(is_write ? &pager->stats.page_writes : &pager->stats.page_reads) += count;
+        return;
+    }
+
+    for (uint32_t start = 0; start < count; start += ring->num_entries) {
+        uint32_t batch_size = count - start < ring->num_entries ? count - start : ring->num_entries;
+        uint32_t tail = *ring->sq_tail;
+        for (uint32_t i = 0; i < batch_size; i++) {
+            uint32_t index = (tail + i) & *ring->sq_ring_mask;
+            int32_t frame_index = frame_indices[start + i];
+            struct io_uring_sqe* sqe = &ring->sqes[index];
+            memset(sqe, 0, sizeof(struct io_uring_sqe));
+            if (ring->has_fixed_buffers) {
+                sqe->opcode = is_write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+                sqe->buf_index = frame_index;
+            } else {
+                sqe->opcode = is_write ? IORING_OP_WRITE : IORING_OP_READ;
+            }
+            sqe->fd = pager->file_descriptor;
+            sqe->off = (uint64_t)page_nums[start + i] * PAGE_SIZE;
+            sqe->addr = (uint64_t)(uintptr_t)pager->frames[frame_index].page;
+            sqe->len = PAGE_SIZE;
+            sqe->user_data = start + i;
+            ring->sq_array[index] = index;
+        }
+        __atomic_store_n(ring->sq_tail, tail + batch_size, __ATOMIC_RELEASE);
+        io_ring_submit_and_wait(ring, batch_size);
+        pager->stats.io_submissions++;
+
+        uint32_t head = *ring->cq_head;
+        for (uint32_t i = 0; i < batch_size; i++) {
+            struct io_uring_cqe* cqe = &ring->cqes[(head + i) & *ring->cq_ring_mask];
+            if (cqe->res != (int32_t)PAGE_SIZE) {
+                fprintf(stderr, "Error %s page %d: %d\n", is_write ? "writing" : "reading", page_nums[cqe->user_data], cqe->res);
+                exit(EXIT_FAILURE);
+            }
+        }
+        __atomic_store_n(ring->cq_head, head + batch_size, __ATOMIC_RELEASE);
+    }
+    *(is_write ? &pager->stats.page_writes : &pager->stats.page_reads) += count;
+}
+#else
+IoRing* io_ring_open(Pager* pager, uint32_t num_entries) {
+    return NULL;
+}
+
+void io_ring_close(IoRing* ring) {
+}
+
+void pager_transfer_pages(Pager* pager, uint8_t is_write, const int32_t* frame_indices, const uint32_t* page_nums, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        void* page = pager->frames[frame_indices[i]].page;
+        off_t offset = (off_t)page_nums[i] * PAGE_SIZE;
+        ssize_t bytes = is_write ? pwrite(pager->file_descriptor, page, PAGE_SIZE, offset)
+            : pread(pager->file_descriptor, page, PAGE_SIZE, offset);
+        if (bytes != PAGE_SIZE) {
+            fprintf(stderr, "Error %s page %d\n", is_write ? "writing" : "reading", page_nums[i]);
+            exit(EXIT_FAILURE);
+        }
+        pager->stats.io_submissions++;
+    }
+    *(is_write ? &pager->stats.page_writes : &pager->stats.page_reads) += count;
+}
+#endif
+
+/**
+ * @brief This method writes frames out to their pages, once the log is durable up to the last change of any of them
+ * 
+ * @param pager 
+ * @param frame_indices 
+ * @param count 
+ */
+void pager_write_frames_locked(Pager* pager, const int32_t* frame_indices, uint32_t count) {
+    uint64_t max_lsn = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        void* page = pager->frames[frame_indices[i]].page;
+        unswizzle_children(pager, page);
+        if (*node_lsn(page) > max_lsn) {
+            max_lsn = *node_lsn(page);
+        }
+    }
+    //  The log has to be durable up to the last change of a page before the page can overwrite its old version
+    if (pager->wal != NULL) {
+        wal_flush(pager->wal, max_lsn + 1);
+    }
+
+    uint32_t page_nums[IO_RING_ENTRIES];
+    for (uint32_t start = 0; start < count; start += IO_RING_ENTRIES) {
+        uint32_t batch_size = count - start < IO_RING_ENTRIES ? count - start : IO_RING_ENTRIES;
+        for (uint32_t i = 0; i < batch_size; i++) {
+            page_nums[i] = pager->frames[frame_indices[start + i]].page_num;
+        }
+        pager_transfer_pages(pager, 1, frame_indices + start, page_nums, batch_size);
+        for (uint32_t i = 0; i < batch_size; i++) {
+            if ((page_nums[i] + 1) * PAGE_SIZE > pager->file_length) {
+                pager->file_length = (page_nums[i] + 1) * PAGE_SIZE;
+            }
+            pager->frames[frame_indices[start + i]].is_dirty = 0;
+        }
+    }
+}
+
+void pager_flush(Pager* pager, uint32_t page_num, uint32_t size) {
+    pthread_mutex_lock(&pager->latch);
+    pager_flush_locked(pager, page_num, size);
+    pthread_mutex_unlock(&pager->latch);
+}
+
+void pager_flush_locked(Pager* pager, uint32_t page_num, uint32_t size) {
+    int32_t frame_index = page_table_lookup(pager, page_num);
+    if (frame_index == -1) {
+        fprintf(stderr, "Tried to flush page %d which is not in the buffer pool\n", page_num);
+        exit(EXIT_FAILURE);
+    }
+    pager_write_frames_locked(pager, &frame_index, 1);
+}
+
+int compare_frames_by_page_num(const void* a, const void* b, void* context) {
+    Pager* pager = context;
+    uint32_t page_num_a = pager->frames[*(const int32_t*)a].page_num;
+    uint32_t page_num_b = pager->frames[*(const int32_t*)b].page_num;
+    return (page_num_a > page_num_b) - (page_num_a < page_num_b);
+}
+
+/**
+ * @brief This method writes out the frames in use in page number order, in batches
+ * 
+ * @param pager 
+ * @param dirty_only Whether frames that have not changed are skipped
+ */
+void pager_flush_frames(Pager* pager, uint8_t dirty_only) {
+    pthread_mutex_lock(&pager->latch);
+    int32_t* frame_indices = malloc(pager->num_frames_used * sizeof(int32_t));
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < pager->num_frames_used; i++) {
+        if (!dirty_only || pager->frames[i].is_dirty) {
+            frame_indices[count++] = i;
+        }
+    }
+    qsort_r(frame_indices, count, sizeof(int32_t), compare_frames_by_page_num, pager);
+    pager_write_frames_locked(pager, frame_indices, count);
+    free(frame_indices);
+    pthread_mutex_unlock(&pager->latch);
+}
+
+/**
+ * @brief This method reads the meta page of an existing file and checks that the file can be opened
+ * 
+ * @param pager 
+ */
+void pager_read_meta_page(Pager* pager) {
+    void* page = pager->meta_page;
+    if (pread(pager->file_descriptor, page, PAGE_SIZE, (off_t)META_PAGE_NUM * PAGE_SIZE) != PAGE_SIZE) {
+        fprintf(stderr, "Error reading the meta page\n");
+        exit(EXIT_FAILURE);
+    }
+    if (*meta_magic(page) != META_MAGIC || *meta_checksum(page) != wal_checksum(page, META_CHECKSUM_OFFSET, 0)) {
+        fprintf(stderr, "The file is not a database file\n");
+        exit(EXIT_FAILURE);
+    }
+    if (*meta_format_version(page) != META_FORMAT_VERSION) {
+        fprintf(stderr, "The file has format version %d, expected %d\n", *meta_format_version(page), META_FORMAT_VERSION);
+        exit(EXIT_FAILURE);
+    }
+    if (*meta_page_size(page) != PAGE_SIZE) {
+        fprintf(stderr, "The file has %d byte pages, this build uses %d byte pages\n", *meta_page_size(page), PAGE_SIZE);
+        exit(EXIT_FAILURE);
+    }
+    pager->root_page_num = *meta_root_page_num(page);
+    pager->num_pages = *meta_num_pages(page);
+    pager->free_list_head = *meta_free_list_head(page);
+    pager->bytes_root_page_num = *meta_bytes_root_page_num(page);
+    pager->unlinked_overflow_page_num = *meta_unlinked_overflow_page_num(page);
+}
+
+/**
+ * @brief This method writes the meta page, the caller syncs the file
+ * 
+ * @param pager 
+ */
+void pager_write_meta_page(Pager* pager) {
+    void* page = pager->meta_page;
+    memset(page, 0, PAGE_SIZE);
+    *meta_magic(page) = META_MAGIC;
+    *meta_format_version(page) = META_FORMAT_VERSION;
+    *meta_page_size(page) = PAGE_SIZE;
+    pthread_mutex_lock(&pager->latch);
+    *meta_root_page_num(page) = pager->root_page_num;
+    *meta_num_pages(page) = pager->num_pages;
+    *meta_free_list_head(page) = pager->free_list_head;
+    *meta_bytes_root_page_num(page) = pager->bytes_root_page_num;
+    *meta_unlinked_overflow_page_num(page) = pager->unlinked_overflow_page_num;
+    pthread_mutex_unlock(&pager->latch);
+    *meta_checksum(page) = wal_checksum(page, META_CHECKSUM_OFFSET, 0);
+    if (pwrite(pager->file_descriptor, page, PAGE_SIZE, (off_t)META_PAGE_NUM * PAGE_SIZE) != PAGE_SIZE) {
+        fprintf(stderr, "Error writing the meta page\n");
+        exit(EXIT_FAILURE);
+    }
+    if (pager->file_length < (META_PAGE_NUM + 1) * PAGE_SIZE) {
+        pager->file_length = (META_PAGE_NUM + 1) * PAGE_SIZE;
+    }
+}
+
+/**
+ * @brief This method writes every page that changed since it was last written, and makes the data file durable
+ * With the log enabled this is a log checkpoint, which also starts the log over.
+ * 
+ * @param pager 
+ */
+void checkpoint(Pager* pager) {
+    if (pager->wal != NULL) {
+        wal_checkpoint(pager);
+        return;
+    }
+    //  Without the write latch the data file could get half of an operation
+    pthread_mutex_lock(&pager->write_latch);
+    pager_flush_frames(pager, 1);
+    pager_write_meta_page(pager);
+    if (fdatasync(pager->file_descriptor) == -1) {
+        fprintf(stderr, "Error syncing the database file\n");
+        exit(EXIT_FAILURE);
+    }
+    pthread_mutex_unlock(&pager->write_latch);
+}
+
+/**
+ * Checkpointer
+ * The checkpointer is a background thread that keeps the number of dirty pages down, so that closing the file,
+ * checkpoints and recovery have less to do. It wakes up CHECKPOINTER_WAKEUPS_PER_SECOND times a second and writes
+ * the next few dirty pages of its sweep through the page numbers, so that it never writes more than
+ * checkpoint_pages_per_second. Once the log is larger than checkpoint_log_size, it takes a checkpoint.
+ */
+/**
+ * @brief This method writes the dirty frames that come next in the sweep of the checkpointer
+ * Pinned frames and frames held by an operation are skipped, since only those are being changed.
+ * 
+ * @param pager 
+ * @param max_pages 
+ * @return uint32_t The number of pages written
+ */
+uint32_t checkpointer_write_batch_locked(Pager* pager, uint32_t max_pages) {
+    int32_t* frame_indices = malloc(pager->num_frames_used * sizeof(int32_t));
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < pager->num_frames_used; i++) {
+        Frame* frame = &pager->frames[i];
+        if (frame->is_dirty && !frame->in_operation && __atomic_load_n(&frame->pin_count, __ATOMIC_SEQ_CST) == 0) {
+            frame_indices[count++] = i;
+        }
+    }
+    qsort_r(frame_indices, count, sizeof(int32_t), compare_frames_by_page_num, pager);
+
+    //  Continue the sweep where the last batch stopped, wrapping around to the first page
+    uint32_t start = 0;
+    while (start < count && pager->frames[frame_indices[start]].page_num < pager->checkpoint_position) {
+        start++;
+    }
+    if (start == count) {
+        start = 0;
+    }
+    uint32_t batch_size = count < max_pages ? count : max_pages;
+    int32_t* batch = malloc(batch_size * sizeof(int32_t));
+    for (uint32_t i = 0; i < batch_size; i++) {
+        batch[i] = frame_indices[(start + i) % count];
+    }
+    if (batch_size > 0) {
+        pager->checkpoint_position = pager->frames[batch[batch_size - 1]].page_num + 1;
+        pager_write_frames_locked(pager, batch, batch_size);
+        pager->stats.background_writes += batch_size;
+    }
+    free(batch);
+    free(frame_indices);
+    return batch_size;
+}
+
+void* checkpointer_main(void* argument) {
+    Pager* pager = argument;
+    uint32_t pages_per_wakeup = (pager->checkpoint_pages_per_second + CHECKPOINTER_WAKEUPS_PER_SECOND - 1) /
+        CHECKPOINTER_WAKEUPS_PER_SECOND;
+    pthread_mutex_lock(&pager->latch);
+    while (!pager->checkpointer_shutdown) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += 1000000000L / CHECKPOINTER_WAKEUPS_PER_SECOND;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&pager->checkpointer_wakeup, &pager->latch, &deadline);
+        if (pager->checkpointer_shutdown) {
+            break;
+        }
+        checkpointer_write_batch_locked(pager, pages_per_wakeup);
+        if (pager->wal != NULL && wal_log_size(pager->wal) >= pager->checkpoint_log_size) {
+            //  The checkpoint takes the write latch, which is taken before the pager latch
+            pthread_mutex_unlock(&pager->latch);
+            wal_checkpoint(pager);
+            pthread_mutex_lock(&pager->latch);
+        }
+    }
+    pthread_mutex_unlock(&pager->latch);
+    return NULL;
+}
+
+void checkpointer_start(Pager* pager) {
+    pager->checkpointer_shutdown = 0;
+    pager->checkpoint_position = 0;
+    pthread_cond_init(&pager->checkpointer_wakeup, NULL);
+    if (pthread_create(&pager->checkpointer_thread, NULL, checkpointer_main, pager) != 0) {
+        fprintf(stderr, "Unable to start the checkpointer\n");
+        exit(EXIT_FAILURE);
+    }
+    pager->checkpointer_running = 1;
+}
+
+void checkpointer_stop(Pager* pager) {
+    if (!pager->checkpointer_running) {
+        return;
+    }
+    pthread_mutex_lock(&pager->latch);
+    pager->checkpointer_shutdown = 1;
+    pthread_cond_signal(&pager->checkpointer_wakeup);
+    pthread_mutex_unlock(&pager->latch);
+    pthread_join(pager->checkpointer_thread, NULL);
+    pthread_cond_destroy(&pager->checkpointer_wakeup);
+    pager->checkpointer_running = 0;
+}
+
+void close_database_file(Pager* pager) {
+    if (pager->snapshots != NULL) {
+        fprintf(stderr, "The snapshots of a pager have to be closed before the pager\n");
+        exit(EXIT_FAILURE);
+    }
+    checkpointer_stop(pager);
+    checkpoint(pager);
+    if (pager->wal != NULL) {
+        wal_close(pager);
+    }
+    if (pager->io_ring != NULL) {
+        io_ring_close(pager->io_ring);
+    }
+    int result = close(pager->file_descriptor);
+    if (result == -1) {
+        fprintf(stderr, "Error closing db file.\n");
+        exit(EXIT_FAILURE);
+    }
+    pthread_mutex_destroy(&pager->latch);
+    pthread_mutex_destroy(&pager->write_latch);
+    pthread_mutex_destroy(&pager->overflow_mutex);
+    pthread_mutex_destroy(&pager->snapshot_mutex);
+    free(pager->page_versions);
+    free(pager->hash_index);
+    free(pager->meta_page);
+    if (pager->mmap_base != NULL) {
+        mmap_close(pager);
+    } else {
+        munmap(pager->frame_buffer, pager->frame_buffer_size);
+        free(pager->frames);
+        free(pager->page_table);
+    }
+    if (pager->operation_trace != NULL) {
+        operation_trace_close(pager->operation_trace);
+    }
+    free(pager->operation_frames);
+    free(pager->tree_stats);
+    free(pager);
+}
+
+uint32_t get_root_page(Pager* pager) {
+    return __atomic_load_n(&pager->root_page_num, __ATOMIC_ACQUIRE);
+}
+
+void set_root_page(Pager* pager, uint32_t root_page_num) {
+    __atomic_store_n(&pager->root_page_num, root_page_num, __ATOMIC_RELEASE);
+    wal_log_set_root(pager, root_page_num);
+}
+
+uint32_t get_bytes_root_page(Pager* pager) {
+    return __atomic_load_n(&pager->bytes_root_page_num, __ATOMIC_ACQUIRE);
+}
+
+void set_bytes_root_page(Pager* pager, uint32_t root_page_num) {
+    __atomic_store_n(&pager->bytes_root_page_num, root_page_num, __ATOMIC_RELEASE);
+    wal_log_set_bytes_root(pager, root_page_num);
+}
+
+/**
+ * @brief This method picks the frame that the next page will be read into
+ * Unused frames are handed out first. Once the pool is full, the clock hand sweeps the frames,
+ * giving every unpinned frame whose reference bit is set a second chance. The first unpinned frame
+ * without a reference bit is the victim, and it is written back if it is dirty.
+ * The caller holds the pager latch, and the victim is returned write latched so that readers that still
+ * reach it through a stale pointer notice that it was reused.
+ * 
+ * @param pager 
+ * @return int32_t -1 if every frame is pinned or held by the current operation
+ */
+int32_t find_victim_frame(Pager* pager) {
+    if (pager->num_frames_used < pager->num_frames) {
+        Frame* frame = &pager->frames[pager->num_frames_used];
+        frame_write_lock(frame);
+        return pager->num_frames_used++;
+    }
+
+    //  Two full sweeps are enough to clear every reference bit, so anything after that means every frame is pinned
+    for (uint32_t i = 0; i < 2 * pager->num_frames; i++) {
+        Frame* frame = &pager->frames[pager->clock_hand];
+        int32_t frame_index = pager->clock_hand;
+        pager->clock_hand = (pager->clock_hand + 1) % pager->num_frames;
+        //  Pages changed by the operation in progress stay resident until it has been logged
+        if (__atomic_load_n(&frame->pin_count, __ATOMIC_SEQ_CST) > 0 || frame->in_operation) {
+            continue;
+        }
+        if (frame->reference_bit) {
+            frame->reference_bit = 0;
+            continue;
+        }
+        if (!frame_try_write_lock(frame)) {
+            continue;
+        }
+        if (!unswizzle_from_parent(pager, frame_index)) {
+            frame_write_unlock(frame);
+            continue;
+        }
+        if (frame->is_dirty) {
+            pager_flush_locked(pager, frame->page_num, PAGE_SIZE);
+            pager->stats.dirty_writebacks++;
+        }
+        unswizzle_children(pager, frame->page);
+        page_table_remove(pager, frame->page_num);
+        pager->stats.evictions++;
+        return frame_index;
+    }
+    return -1;
+}
+
+/**
+ * @brief This method returns the page with the given page number, reading it from the file if it is not in the buffer pool
+ * The page is pinned and stays in the buffer pool until every caller has released it with unpin_page()
+ * 
+ * @param pager 
+ * @param page_num 
+ * @return void* 
+ */
+void* get_page(Pager* pager, uint32_t page_num) {
+    pthread_mutex_lock(&pager->latch);
+    void* page = get_page_locked(pager, page_num);
+    pthread_mutex_unlock(&pager->latch);
+    return page;
+}
+
+void* get_page_locked(Pager* pager, uint32_t page_num) {
+    if (pager->mmap_base != NULL) {
+        return get_mapped_page_locked(pager, page_num);
+    }
+retry:;
+    int32_t frame_index = page_table_lookup(pager, page_num);
+    if (frame_index != -1) {
+        Frame* frame = &pager->frames[frame_index];
+        __atomic_fetch_add(&frame->pin_count, 1, __ATOMIC_SEQ_CST);
+        frame->reference_bit = 1;
+        pager->stats.hits++;
+        return frame->page;
+    }
+
+    frame_index = find_victim_frame(pager);
+    if (frame_index == -1) {
+        //  A reader can not evict the children of nodes that the operation in progress latched, so it waits for
+        //  the operation to release them, and looks the page up again since another thread may have read it
+        if (!pager->in_operation || !pthread_equal(pager->operation_thread, pthread_self())) {
+            pthread_mutex_unlock(&pager->latch);
+            sched_yield();
+            pthread_mutex_lock(&pager->latch);
+            goto retry;
+        }
+        fprintf(stderr, "Every frame in the buffer pool is pinned or held by the current operation\n");
+        exit(EXIT_FAILURE);
+    }
+    pager->stats.misses++;
+    Frame* frame = &pager->frames[frame_index];
+
+    uint32_t num_pages_on_disk = pager->file_length / PAGE_SIZE;
+    if (page_num < num_pages_on_disk) {
+        pager_transfer_pages(pager, 0, &frame_index, &page_num, 1);
+    } else {
+        memset(frame->page, 0, PAGE_SIZE);
+    }
+
+    __atomic_store_n(&frame->page_num, page_num, __ATOMIC_RELAXED);
+    __atomic_store_n(&frame->pin_count, 1, __ATOMIC_SEQ_CST);
+    frame->reference_bit = 1;
+    //  A page that is not on disk yet has to be written out before it can be dropped
+    frame->is_dirty = page_num >= num_pages_on_disk;
+    page_table_insert(pager, page_num, frame_index);
+    frame_write_unlock(frame);
+
+    if (page_num >= pager->num_pages) {
+        pager->num_pages = page_num + 1;
+    }
+    return frame->page;
+}
+
+/**
+ * @brief This method returns a page of the mapping, mapping more of the file first if the page is past its end
+ * 
+ * @param pager 
+ * @param page_num 
+ * @return void* 
+ */
+void* get_mapped_page_locked(Pager* pager, uint32_t page_num) {
+    mmap_grow(pager, page_num + 1);
+    Frame* frame = &pager->frames[page_num];
+    __atomic_fetch_add(&frame->pin_count, 1, __ATOMIC_SEQ_CST);
+    pager->stats.hits++;
+    if (page_num >= pager->num_pages) {
+        //  A page past the last page is new, and whatever the file holds there is stale
+        memset(frame->page, 0, PAGE_SIZE);
+        frame->is_dirty = 1;
+        pager->num_pages = page_num + 1;
+    }
+    return frame->page;
+}
+
+/**
+ * @brief This method starts reading pages that are about to be needed
+ * With io_uring the pages that are not in the buffer pool are read into it unpinned, with one submission for the
+ * whole batch. Otherwise the kernel is asked to read them into the page cache, which direct I/O bypasses, or
+ * into the mapping.
+ * 
+ * @param pager 
+ * @param page_nums 
+ * @param num_pages 
+ */
+void pager_prefetch(Pager* pager, const uint32_t* page_nums, uint32_t num_pages) {
+    if (pager->mmap_base != NULL) {
+        uint32_t num_frames = __atomic_load_n(&pager->num_frames, __ATOMIC_ACQUIRE);
+        for (uint32_t i = 0; i < num_pages; i++) {
+            if (page_nums[i] < num_frames) {
+                madvise(pager->frames[page_nums[i]].page, PAGE_SIZE, MADV_WILLNEED);
+                pager->stats.prefetches++;
+            }
+        }
+        return;
+    }
+    int32_t frame_indices[IO_RING_ENTRIES];
+    uint32_t batch_page_nums[IO_RING_ENTRIES];
+    uint32_t batch_size = 0;
+    pthread_mutex_lock(&pager->latch);
+    uint32_t num_pages_on_disk = pager->file_length / PAGE_SIZE;
+    //  Leave most of the pool to the pages in use, so read-ahead never evicts what it has just read
+    uint32_t max_batch_size = pager->num_frames / 4 < IO_RING_ENTRIES ? pager->num_frames / 4 : IO_RING_ENTRIES;
+    for (uint32_t i = 0; i < num_pages; i++) {
+        uint32_t page_num = page_nums[i];
+        if (page_table_lookup(pager, page_num) != -1 || page_num >= num_pages_on_disk) {
+            continue;
+        }
+        if (pager->io_ring == NULL) {
+            if (!pager->direct_io) {
+                posix_fadvise(pager->file_descriptor, (off_t)page_num * PAGE_SIZE, PAGE_SIZE, POSIX_FADV_WILLNEED);
+                pager->stats.prefetches++;
+            }
+            continue;
+        }
+        if (batch_size == max_batch_size) {
+            break;
+        }
+        int32_t frame_index = find_victim_frame(pager);
+        if (frame_index == -1) {
+            break;
+        }
+        frame_indices[batch_size] = frame_index;
+        batch_page_nums[batch_size++] = page_num;
+    }
+    if (batch_size > 0) {
+        pager_transfer_pages(pager, 0, frame_indices, batch_page_nums, batch_size);
+        for (uint32_t i = 0; i < batch_size; i++) {
+            Frame* frame = &pager->frames[frame_indices[i]];
+            __atomic_store_n(&frame->page_num, batch_page_nums[i], __ATOMIC_RELAXED);
+            __atomic_store_n(&frame->pin_count, 0, __ATOMIC_SEQ_CST);
+            frame->reference_bit = 1;
+            frame->is_dirty = 0;
+            page_table_insert(pager, batch_page_nums[i], frame_indices[i]);
+            frame_write_unlock(frame);
+        }
+        pager->stats.prefetches += batch_size;
+    }
+    pthread_mutex_unlock(&pager->latch);
+}
+
+void unpin_page(Pager* pager, uint32_t page_num) {
+    pthread_mutex_lock(&pager->latch);
+    int32_t frame_index = page_table_lookup(pager, page_num);
+    pthread_mutex_unlock(&pager->latch);
+    if (frame_index == -1) {
+        fprintf(stderr, "Tried to unpin page %d which is not pinned\n", page_num);
+        exit(EXIT_FAILURE);
+    }
+    unpin_node(pager, pager->frames[frame_index].page);
+}
+
+void mark_page_dirty(Pager* pager, uint32_t page_num) {
+    pthread_mutex_lock(&pager->latch);
+    int32_t frame_index = page_table_lookup(pager, page_num);
+    pthread_mutex_unlock(&pager->latch);
+    if (frame_index == -1) {
+        fprintf(stderr, "Tried to mark page %d dirty which is not in the buffer pool\n", page_num);
+        exit(EXIT_FAILURE);
+    }
+    mark_node_dirty(pager, pager->frames[frame_index].page);
+}
+
+/**
+ * @brief This method returns a pinned page for a new node
+ * Pages on the free list are reused before the file is extended
+ * 
+ * @param pager 
+ * @return void* 
+ */
+void* allocate_page(Pager* pager) {
+    pthread_mutex_lock(&pager->latch);
+    uint32_t page_num = pager->free_list_head;
+    if (page_num == INVALID_PAGE_NUM) {
+        void* page = get_page_locked(pager, pager->num_pages);
+        pthread_mutex_unlock(&pager->latch);
+        return page;
+    }
+    void* page = get_page_locked(pager, page_num);
+    if (*node_type(page) != FREE_PAGE) {
+        fprintf(stderr, "The free list is corrupt, page %d is not free\n", page_num);
+        exit(EXIT_FAILURE);
+    }
+    pager->free_list_head = *free_page_next_pointer(page);
+    pthread_mutex_unlock(&pager->latch);
+    wal_log_free_list_head(pager, pager->free_list_head);
+    return page;
+}
+
+/**
+ * @brief This method puts the page of a node that is no longer part of the tree on the free list
+ * 
+ * @param pager 
+ * @param node A pinned node
+ */
+void free_page(Pager* pager, void* node) {
+    latch_node(pager, node);
+    uint32_t page_num = get_node_page_num(pager, node);
+    pthread_mutex_lock(&pager->latch);
+    uint32_t next_page_num = pager->free_list_head;
+    pager->free_list_head = page_num;
+    pager->frames[get_frame_index(pager, node)].swizzled_parent = -1;
+    pthread_mutex_unlock(&pager->latch);
+
+    uint64_t lsn = *node_lsn(node);
+    memset(node, 0, PAGE_SIZE);
+    *(uint32_t*)node_type(node) = FREE_PAGE;
+    *node_lsn(node) = lsn;
+    *free_page_next_pointer(node) = next_page_num;
+    mark_node_dirty(pager, node);
+    wal_log_free_list_head(pager, page_num);
+}
+
+int32_t get_frame_index(Pager* pager, void* node) {
+    return (node - pager->frame_buffer) / PAGE_SIZE;
+}
+
+uint32_t get_node_page_num(Pager* pager, void* node) {
+    return pager->frames[get_frame_index(pager, node)].page_num;
+}
+
+void unpin_node(Pager* pager, void* node) {
+    Frame* frame = &pager->frames[get_frame_index(pager, node)];
+    if (__atomic_fetch_sub(&frame->pin_count, 1, __ATOMIC_SEQ_CST) == 0) {
+        fprintf(stderr, "Tried to unpin page %d which is not pinned\n", frame->page_num);
+        exit(EXIT_FAILURE);
+    }
+}
+
+void mark_node_dirty(Pager* pager, void* node) {
+    Frame* frame = &pager->frames[get_frame_index(pager, node)];
+    frame->is_dirty = 1;
+    if (pager->in_operation) {
+        //  A node that is changed is latched by the operation anyway, so it also stays resident until the commit
+        latch_node(pager, node);
+        if (pager->wal != NULL) {
+            frame->needs_image = 1;
+        }
+    }
+}
+
+BufferPoolStats get_buffer_pool_stats(Pager* pager) {
+    return pager->stats;
+}
+
+void reset_buffer_pool_stats(Pager* pager) {
+    memset(&pager->stats, 0, sizeof(BufferPoolStats));
+}
+
+/**
+ * Tree statistics
+ * The counters are split into TREE_STATS_SHARDS shards, each on its own cache lines, and every thread adds to the
+ * shard it was handed the first time it counted something, so threads on different shards never share a line.
+ * Counters are bumped with a plain load and store instead of a locked add. Two threads only share a shard when there
+ * are more threads than shards, and then an update may be lost now and then.
+ * Reading the stats sums the shards without stopping anyone, so a read taken while operations run may be a few
+ * counts behind.
+ */
+__thread ThreadStats thread_stats;
+__thread int32_t thread_stats_shard = -1;
+uint32_t next_stats_shard = 0;
+
+/**
+ * @brief This method returns the shard of the tree stats that the current thread adds to
+ * 
+ * @param pager 
+ * @return TreeStats* 
+ */
+TreeStats* stats_shard(Pager* pager) {
+    if (thread_stats_shard == -1) {
+        thread_stats_shard = __atomic_fetch_add(&next_stats_shard, 1, __ATOMIC_RELAXED) % TREE_STATS_SHARDS;
+    }
+    return (TreeStats*)((void*)pager->tree_stats + thread_stats_shard * TREE_STATS_SHARD_SIZE);
+}
+
+void stats_shard_add(uint64_t* counter, uint64_t count) {
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + count, __ATOMIC_RELAXED);
+}
+
+uint64_t stats_clock() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+/**
+ * @brief This method is called when an operation starts
+ * 
+ * @param pager 
+ * @return uint64_t The time the operation started, if latencies are tracked
+ */
+uint64_t stats_operation_start(Pager* pager) {
+    return BTREE_STATS && pager->track_latency ? stats_clock() : 0;
+}
+
+/**
+ * @brief This method counts a finished operation, and moves the counters of the thread into the tree stats
+ * 
+ * @param pager 
+ * @param type 
+ * @param start_time What stats_operation_start() returned
+ */
+void stats_operation_finish(Pager* pager, OperationType type, uint64_t start_time) {
+#if BTREE_STATS
+    TreeStats* shard = stats_shard(pager);
+    stats_shard_add(&shard->operations[type], 1);
+    stats_shard_add(&shard->node_visits, thread_stats.node_visits);
+    stats_shard_add(&shard->key_comparisons, thread_stats.key_comparisons);
+    stats_shard_add(&shard->restarts, thread_stats.restarts);
+    stats_shard_add(&shard->buffer_hits, thread_stats.buffer_hits);
+    stats_shard_add(&shard->hash_index_hits, thread_stats.hash_index_hits);
+    stats_shard_add(&shard->hash_index_misses, thread_stats.hash_index_misses);
+    memset(&thread_stats, 0, sizeof(ThreadStats));
+    if (pager->track_latency) {
+        uint64_t latency = stats_clock() - start_time;
+        uint32_t bucket = latency == 0 ? 0 : 63 - __builtin_clzll(latency);
+        if (bucket >= LATENCY_HISTOGRAM_BUCKETS) {
+            bucket = LATENCY_HISTOGRAM_BUCKETS - 1;
+        }
+        stats_shard_add(&shard->latency_histogram[type][bucket], 1);
+    }
+#endif
+}
+
+/**
+ * @brief This method sums the tree stats over all threads
+ * 
+ * @param pager 
+ * @return TreeStats 
+ */
+TreeStats get_tree_stats(Pager* pager) {
+    TreeStats stats;
+    memset(&stats, 0, sizeof(TreeStats));
+    for (uint32_t i = 0; i < TREE_STATS_SHARDS; i++) {
+        uint64_t* shard = (uint64_t*)((void*)pager->tree_stats + i * TREE_STATS_SHARD_SIZE);
+        uint64_t* total = (uint64_t*)&stats;
+        for (uint32_t j = 0; j < sizeof(TreeStats) / sizeof(uint64_t); j++) {
+            total[j] += __atomic_load_n(&shard[j], __ATOMIC_RELAXED);
+        }
+    }
+    pthread_mutex_lock(&pager->latch);
+    stats.page_reads = pager->stats.page_reads;
+    stats.page_writes = pager->stats.page_writes;
+    stats.buffer_hits += pager->stats.hits;
+    stats.buffer_misses = pager->stats.misses;
+    pthread_mutex_unlock(&pager->latch);
+    return stats;
+}
+
+/**
+ * @brief This method clears the tree stats and the buffer pool stats
+ * 
+ * @param pager 
+ */
+void reset_tree_stats(Pager* pager) {
+    memset(pager->tree_stats, 0, TREE_STATS_SHARDS * TREE_STATS_SHARD_SIZE);
+    pthread_mutex_lock(&pager->latch);
+    reset_buffer_pool_stats(pager);
+    pthread_mutex_unlock(&pager->latch);
+}
+
+/**
+ * @brief This method estimates a latency percentile from a histogram
+ * 
+ * @param stats 
+ * @param type 
+ * @param percentile Between 0 and 100
+ * @return uint64_t The upper end of the bucket the percentile falls into, in nanoseconds, or 0 with no operations
+ */
+uint64_t tree_stats_latency_percentile(const TreeStats* stats, OperationType type, double percentile) {
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++) {
+        total += stats->latency_histogram[type][i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(percentile / 100 * total);
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++) {
+        seen += stats->latency_histogram[type][i];
+        if (seen > rank) {
+            return (2ull << i) - 1;
+        }
+    }
+    return (2ull << (LATENCY_HISTOGRAM_BUCKETS - 1)) - 1;
+}
+
+/**
+ * Write-ahead log
+ * Every insert and delete is one operation. The pages an operation changes stay in the buffer pool until it
+ * commits, and each change is logged either as a small record that redo replays on the page, or as an image of
+ * the whole page taken at commit. A page is only written to the data file once the log is durable up to the LSN
+ * in its header, so after a crash the data file and the log together hold every committed operation.
+ */
+typedef enum WalRecordType {
+    WAL_RECORD_PAGE_IMAGE = 1,
+    WAL_RECORD_LEAF_INSERT,
+    WAL_RECORD_LEAF_DELETE,
+    //  Parent pointers are no longer maintained, this record is only skipped when it is found in an older log
+    WAL_RECORD_SET_PARENT,
+    WAL_RECORD_SET_ROOT,
+    WAL_RECORD_COMMIT,
+    WAL_RECORD_CHECKPOINT,
+    WAL_RECORD_SET_FREE_LIST_HEAD,
+    WAL_RECORD_LEAF_UPDATE,
+    WAL_RECORD_SET_BYTES_ROOT,
+    WAL_RECORD_SET_UNLINKED_OVERFLOW_PAGE
+} WalRecordType;
+
+typedef struct {
+    uint64_t lsn;
+    uint32_t size;
+    uint32_t checksum;
+    uint32_t operation_id;
+    uint32_t type;
+    uint32_t page_num;
+    uint32_t reserved;
+} WalRecordHeader;
+
+const uint32_t WAL_RECORD_HEADER_SIZE = sizeof(WalRecordHeader);
+_Static_assert(WAL_BUFFER_SIZE >= 4 * (PAGE_SIZE_KB * 1024 + sizeof(WalRecordHeader)),
+    "The log buffer has to hold several page images");
+
+uint32_t wal_checksum_table[256];
+
+void wal_initialize_checksum_table() {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & -(crc & 1));
+        }
+        wal_checksum_table[i] = crc;
+    }
+}
+
+uint32_t wal_checksum(const void* data, uint32_t size, uint32_t crc) {
+    const uint8_t* bytes = data;
+    crc = ~crc;
+    for (uint32_t i = 0; i < size; i++) {
+        crc = wal_checksum_table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+/**
+ * @brief This method appends a record to the active log buffer and returns its LSN
+ * If the buffer is full, it waits for the flusher to swap it out
+ * 
+ * @param wal 
+ * @param type 
+ * @param page_num 
+ * @param payload 
+ * @param payload_size 
+ * @return uint64_t 
+ */
+uint64_t wal_append(Wal* wal, uint32_t type, uint32_t page_num, const void* payload, uint32_t payload_size) {
+    WalRecordHeader header;
+    header.size = WAL_RECORD_HEADER_SIZE + payload_size;
+    header.checksum = 0;
+    header.operation_id = wal->operation_id;
+    header.type = type;
+    header.page_num = page_num;
+    header.reserved = 0;
+
+    pthread_mutex_lock(&wal->mutex);
+    while (wal->buffer_used + header.size > WAL_BUFFER_SIZE) {
+        if (wal->requested_lsn < wal->next_lsn) {
+            wal->requested_lsn = wal->next_lsn;
+        }
+        pthread_cond_signal(&wal->flush_requested);
+        pthread_cond_wait(&wal->flush_done, &wal->mutex);
+    }
+    header.lsn = wal->next_lsn;
+    header.checksum = wal_checksum(payload, payload_size, wal_checksum(&header, WAL_RECORD_HEADER_SIZE, 0));
+    memcpy(wal->active_buffer + wal->buffer_used, &header, WAL_RECORD_HEADER_SIZE);
+    memcpy(wal->active_buffer + wal->buffer_used + WAL_RECORD_HEADER_SIZE, payload, payload_size);
+    wal->buffer_used += header.size;
+    wal->next_lsn += header.size;
+    wal->stats.records++;
+    wal->stats.bytes += header.size;
+    pthread_mutex_unlock(&wal->mutex);
+    return header.lsn;
+}
+
+/**
+ * @brief This method is the group commit thread
+ * It waits until a commit or a page write asks for the log to be durable, then writes out everything in the
+ * active buffer with a single fdatasync. Commits that arrive while a sync is in progress wait for the next one,
+ * so under load each sync covers many operations.
+ * 
+ * @param argument The log
+ * @return void* 
+ */
+void* wal_flusher_main(void* argument) {
+    Wal* wal = argument;
+    pthread_mutex_lock(&wal->mutex);
+    while (1) {
+        while (!wal->shutdown && wal->requested_lsn <= wal->flushed_lsn) {
+            pthread_cond_wait(&wal->flush_requested, &wal->mutex);
+        }
+        if (wal->requested_lsn <= wal->flushed_lsn) {
+            break;
+        }
+        if (wal->group_commit_delay_us > 0) {
+            //  Give more commits the chance to join this sync
+            pthread_mutex_unlock(&wal->mutex);
+            usleep(wal->group_commit_delay_us);
+            pthread_mutex_lock(&wal->mutex);
+        }
+
+        uint8_t* buffer = wal->active_buffer;
+        uint32_t size = wal->buffer_used;
+        uint64_t start_lsn = wal->buffer_start_lsn;
+        off_t offset = start_lsn - wal->file_start_lsn;
+        wal->active_buffer = wal->flush_buffer;
+        wal->flush_buffer = buffer;
+        wal->buffer_used = 0;
+        wal->buffer_start_lsn = start_lsn + size;
+        pthread_mutex_unlock(&wal->mutex);
+
+        for (uint32_t written = 0; written < size;) {
+            ssize_t bytes_written = pwrite(wal->file_descriptor, buffer + written, size - written, offset + written);
+            if (bytes_written == -1) {
+                fprintf(stderr, "Error writing the log\n");
+                exit(EXIT_FAILURE);
+            }
+            written += bytes_written;
+        }
+        if (fdatasync(wal->file_descriptor) == -1) {
+            fprintf(stderr, "Error syncing the log\n");
+            exit(EXIT_FAILURE);
+        }
+
+        pthread_mutex_lock(&wal->mutex);
+        wal->flushed_lsn = start_lsn + size;
+        wal->stats.syncs++;
+        pthread_cond_broadcast(&wal->flush_done);
+    }
+    pthread_mutex_unlock(&wal->mutex);
+    return NULL;
+}
+
+/**
+ * @brief This method waits until every record before lsn is durable
+ * 
+ * @param wal 
+ * @param lsn 
+ */
+void wal_flush(Wal* wal, uint64_t lsn) {
+    pthread_mutex_lock(&wal->mutex);
+    if (lsn > wal->next_lsn) {
+        lsn = wal->next_lsn;
     }
-    if (num_cells == 0) {
-        return 0;
+    if (wal->requested_lsn < lsn) {
+        wal->requested_lsn = lsn;
+        pthread_cond_signal(&wal->flush_requested);
     }
-    uint32_t min_index = 0;
-    uint32_t one_past_max_index = num_cells;
-
-    //  Perform binary search on an internal node
-    while (node_type != LEAF_NODE && one_past_max_index > min_index) {
-        uint32_t index = (min_index + one_past_max_index) / 2;
-        uint32_t key_at_index = *internal_node_key(*node, index);
-        if (key < key_at_index) {
-            //  search the left side of the node
-            one_past_max_index = index;
-        } else if (key > key_at_index) {
-            //  search the right side of the node
-            min_index = index + 1;
-        } else {
-            *node = *internal_node_right_child_pointer(*node);
-            return binary_search_modify_pointer(node, key);
-        }
+    while (wal->flushed_lsn < lsn) {
+        pthread_cond_wait(&wal->flush_done, &wal->mutex);
     }
+    pthread_mutex_unlock(&wal->mutex);
+}
 
-    //  Decide which child pointer to follow
-    if (node_type == INTERNAL_NODE) {
-        if (min_index < num_cells) {
-            *node = *internal_node_child_pointer(*node, min_index);
-        } else {
-            *node = *internal_node_right_child_pointer(*node);
-        }
-        return binary_search_modify_pointer(node, key);
+void wal_begin_operation(Pager* pager) {
+    Wal* wal = pager->wal;
+    if (wal == NULL) {
+        return;
     }
+    wal->operation_id++;
+    wal->num_operation_records = 0;
+}
 
-    //  Perform binary search on a leaf node
-    while (one_past_max_index != min_index) {
-        uint32_t index = (min_index + one_past_max_index) / 2;
-        uint32_t key_at_index = *leaf_node_key(*node, index);
-        if (key == key_at_index) {
-            return index;
-        }
-        if (key < key_at_index) {
-            one_past_max_index = index;
-        } else {
-            min_index = index + 1;
-        }
+/**
+ * @brief This method logs a change to a node that redo can replay from a small record
+ * The node is marked dirty whether or not the log is enabled. Nothing is logged if the node will be logged as a
+ * whole page anyway.
+ * 
+ * @param pager 
+ * @param node 
+ * @param type 
+ * @param payload 
+ * @param payload_size 
+ */
+void wal_log_node_change(Pager* pager, void* node, uint32_t type, const void* payload, uint32_t payload_size) {
+    int32_t frame_index = get_frame_index(pager, node);
+    Frame* frame = &pager->frames[frame_index];
+    frame->is_dirty = 1;
+    if (pager->wal == NULL || !pager->in_operation || frame->needs_image) {
+        return;
     }
-    return min_index;
+    *node_lsn(node) = wal_append(pager->wal, type, frame->page_num, payload, payload_size);
+    pager->wal->num_operation_records++;
+    //  The node has to stay in the buffer pool until the operation commits
+    latch_node(pager, node);
 }
 
-int binary_search(void* node, uint32_t key) {
-    int node_type = check_type_of_node(node);
-    uint32_t num_cells;
-    if (node_type == LEAF_NODE) {
-        num_cells = *(uint32_t*)leaf_node_num_cells(node);
-    } else if (node_type == INTERNAL_NODE) {
-        num_cells = *(uint32_t*)internal_node_num_keys(node);
+void wal_log_leaf_insert(Pager* pager, void* node, uint32_t key, uint32_t value) {
+    uint32_t payload[2] = { key, value };
+    wal_log_node_change(pager, node, WAL_RECORD_LEAF_INSERT, payload, sizeof(payload));
+}
+
+void wal_log_leaf_delete(Pager* pager, void* node, uint32_t key) {
+    wal_log_node_change(pager, node, WAL_RECORD_LEAF_DELETE, &key, sizeof(key));
+}
+
+void wal_log_leaf_update(Pager* pager, void* node, uint32_t key, uint32_t value) {
+    uint32_t payload[2] = { key, value };
+    wal_log_node_change(pager, node, WAL_RECORD_LEAF_UPDATE, payload, sizeof(payload));
+}
+
+void wal_log_set_root(Pager* pager, uint32_t root_page_num) {
+    if (pager->wal == NULL || !pager->in_operation) {
+        return;
     }
-    if (num_cells == 0) {
+    wal_append(pager->wal, WAL_RECORD_SET_ROOT, root_page_num, NULL, 0);
+    pager->wal->num_operation_records++;
+}
+
+void wal_log_set_bytes_root(Pager* pager, uint32_t root_page_num) {
+    if (pager->wal == NULL || !pager->in_operation) {
+        return;
+    }
+    wal_append(pager->wal, WAL_RECORD_SET_BYTES_ROOT, root_page_num, NULL, 0);
+    pager->wal->num_operation_records++;
+}
+
+void wal_log_free_list_head(Pager* pager, uint32_t page_num) {
+    if (pager->wal == NULL || !pager->in_operation) {
+        return;
+    }
+    wal_append(pager->wal, WAL_RECORD_SET_FREE_LIST_HEAD, page_num, NULL, 0);
+    pager->wal->num_operation_records++;
+}
+
+void wal_log_unlinked_overflow_page(Pager* pager, uint32_t page_num) {
+    if (pager->wal == NULL || !pager->in_operation) {
+        return;
+    }
+    wal_append(pager->wal, WAL_RECORD_SET_UNLINKED_OVERFLOW_PAGE, page_num, NULL, 0);
+    pager->wal->num_operation_records++;
+}
+
+/**
+ * @brief This method logs the whole page held by a frame and stamps the page with the LSN of the record
+ * 
+ * @param pager 
+ * @param frame_index 
+ */
+void wal_log_page_image(Pager* pager, int32_t frame_index) {
+    Wal* wal = pager->wal;
+    void* page = pager->frames[frame_index].page;
+    void* image = wal->scratch_page;
+    memcpy(image, page, PAGE_SIZE);
+    //  Swizzled child pointers only mean something to this process, so the image gets page numbers
+    if (*node_type(image) == INTERNAL_NODE) {
+        uint32_t num_keys = *internal_node_num_keys(image);
+        for (uint32_t i = 0; i <= num_keys; i++) {
+            uint32_t* child_pointer = internal_node_child_at(image, i);
+            *child_pointer = get_child_page_num(pager, *child_pointer);
+        }
+    }
+    *node_lsn(page) = wal_append(wal, WAL_RECORD_PAGE_IMAGE, pager->frames[frame_index].page_num, image, PAGE_SIZE);
+    wal->num_operation_records++;
+}
+
+/**
+ * @brief This method logs the pages that the operation changed as a whole, then its commit record
+ * The frames stay latched by the operation, end_operation() releases them before it waits for the commit.
+ * 
+ * @param pager 
+ * @return uint64_t The LSN the log has to be durable up to for the operation to be committed, 0 if there is none
+ */
+uint64_t wal_commit_operation(Pager* pager) {
+    Wal* wal = pager->wal;
+    if (wal == NULL) {
         return 0;
     }
-    uint32_t min_index = 0;
-    uint32_t one_past_max_index = num_cells;
-
-    while (node_type != LEAF_NODE && one_past_max_index > min_index) {
-        uint32_t index = (min_index + one_past_max_index) / 2;
-        uint32_t key_at_index = *internal_node_key(node, index);
-        if (key < key_at_index) {
-            //  search the left side of the node
-            one_past_max_index = index;
-        } else if (key > key_at_index) {
-            //  search the right side of the node
-            min_index = index + 1;
-        } else {
-            //  get the page the left child pointer points to
-            node = *internal_node_child_pointer(node, index);
-            node_type = check_type_of_node(node);
-            if (node_type == INTERNAL_NODE) {
-                num_cells = *(uint32_t*)internal_node_num_keys(node);
-                min_index = 0;
-            } else {
-                break;
-            }
+    for (uint32_t i = 0; i < pager->num_operation_frames; i++) {
+        int32_t frame_index = pager->operation_frames[i];
+        if (pager->frames[frame_index].needs_image) {
+            wal_log_page_image(pager, frame_index);
         }
     }
+    if (wal->num_operation_records == 0) {
+        return 0;
+    }
+    uint64_t commit_lsn = wal_append(wal, WAL_RECORD_COMMIT, INVALID_PAGE_NUM, NULL, 0);
+    return commit_lsn + WAL_RECORD_HEADER_SIZE;
+}
 
-    //  If the node is still an internal node, call binary_search with the right child pointer
-    //  If the node is a leaf node, find the key and return the index
-    if (node_type == INTERNAL_NODE) {
-        return binary_search(*internal_node_right_child_pointer(node), key);
+/**
+ * @brief This method waits for a commit with synchronous commit, otherwise it hands the commit to the flusher, which
+ * makes it durable within the group commit delay
+ * 
+ * @param pager 
+ * @param commit_lsn 
+ */
+void wal_wait_for_commit(Pager* pager, uint64_t commit_lsn) {
+    Wal* wal = pager->wal;
+    if (wal == NULL || commit_lsn == 0) {
+        return;
+    }
+    if (wal->synchronous_commit) {
+        wal_flush(wal, commit_lsn);
     } else {
-        while (one_past_max_index != min_index) {
-            uint32_t index = (min_index + one_past_max_index) / 2;
-            uint32_t key_at_index = *leaf_node_key(node, index);
-            if (key == key_at_index) {
-                return index;
-            }
-            if (key < key_at_index) {
-                one_past_max_index = index;
-            } else {
-                min_index = index + 1;
-            }
+        pthread_mutex_lock(&wal->mutex);
+        if (wal->requested_lsn < commit_lsn) {
+            wal->requested_lsn = commit_lsn;
+            pthread_cond_signal(&wal->flush_requested);
         }
-        return min_index;
+        pthread_mutex_unlock(&wal->mutex);
+    }
+    pthread_mutex_lock(&wal->mutex);
+    wal->stats.commits++;
+    pthread_mutex_unlock(&wal->mutex);
+}
+
+/**
+ * @brief This method waits until every committed operation is durable
+ * 
+ * @param pager 
+ */
+void pager_sync(Pager* pager) {
+    if (pager->wal != NULL) {
+        wal_flush(pager->wal, pager->wal->next_lsn);
+    }
+}
+
+/**
+ * @brief This method reads the record at an offset of the log into header and payload
+ * 
+ * @param wal 
+ * @param offset 
+ * @param header 
+ * @param payload Has to hold a page
+ * @return int 1 if a whole record with a valid checksum was read, 0 at the end of the log
+ */
+int wal_read_record(Wal* wal, off_t offset, WalRecordHeader* header, void* payload) {
+    if (pread(wal->file_descriptor, header, WAL_RECORD_HEADER_SIZE, offset) != WAL_RECORD_HEADER_SIZE) {
+        return 0;
+    }
+    if (header->size < WAL_RECORD_HEADER_SIZE || header->size > WAL_RECORD_HEADER_SIZE + PAGE_SIZE) {
+        return 0;
+    }
+    uint32_t payload_size = header->size - WAL_RECORD_HEADER_SIZE;
+    if (pread(wal->file_descriptor, payload, payload_size, offset + WAL_RECORD_HEADER_SIZE) != payload_size) {
+        return 0;
     }
+    WalRecordHeader unchecked_header = *header;
+    unchecked_header.checksum = 0;
+    uint32_t checksum = wal_checksum(payload, payload_size, wal_checksum(&unchecked_header, WAL_RECORD_HEADER_SIZE, 0));
+    return checksum == header->checksum;
 }
 
+int compare_operation_ids(const void* a, const void* b) {
+    uint32_t first = *(const uint32_t*)a;
+    uint32_t second = *(const uint32_t*)b;
+    return (first > second) - (first < second);
+}
 
 /**
- * @brief This method is responsible for searching for a key in the B+ tree
- * It handles two cases, one where the node passed is an internal node and the other where it is a leaf node
+ * @brief This method brings the data file up to date with the log
+ * The first pass finds the end of the log, which is the first torn or out of sequence record, and the operations
+ * that committed. The second pass replays the changes of committed operations on every page that has not seen
+ * them yet, going by the LSN in the page header.
  * 
  * @param pager 
- * @param key 
- * @return int 
  */
-int search(Pager* pager, uint32_t key) {
-    //  get the root node
-    printf("\n");
-    void* node = get_page(pager, pager->root_page_num);
-    printf("The root node is %p\n", node);
+void wal_recover(Pager* pager) {
+    Wal* wal = pager->wal;
+    WalRecordHeader header;
+    void* payload = malloc(PAGE_SIZE);
 
-    int node_type = check_type_of_node(node);
+    uint32_t* committed = NULL;
+    uint32_t num_committed = 0;
+    uint32_t committed_capacity = 0;
+    off_t end_offset = 0;
+    uint64_t end_lsn = 0;
+    while (wal_read_record(wal, end_offset, &header, payload)) {
+        if (end_offset == 0) {
+            wal->file_start_lsn = header.lsn;
+        } else if (header.lsn != end_lsn) {
+            break;
+        }
+        if (header.type == WAL_RECORD_COMMIT) {
+            if (num_committed == committed_capacity) {
+                committed_capacity = committed_capacity == 0 ? 1024 : 2 * committed_capacity;
+                committed = realloc(committed, committed_capacity * sizeof(uint32_t));
+            }
+            committed[num_committed++] = header.operation_id;
+        }
+        end_offset += header.size;
+        end_lsn = header.lsn + header.size;
+    }
+    qsort(committed, num_committed, sizeof(uint32_t), compare_operation_ids);
 
-    if (node_type == INTERNAL_NODE) {
-        uint32_t num_keys = *(uint32_t*)internal_node_num_keys(node);
-        uint32_t key_index = binary_search_modify_pointer(&node, key);
-        if (key_index == -1) {
-            return -1;
+    //  Everything before the end of the log is durable already, so pages can be written back during redo
+    wal->next_lsn = end_lsn;
+    wal->flushed_lsn = end_lsn;
+    wal->requested_lsn = end_lsn;
+    wal->buffer_start_lsn = end_lsn;
+
+    for (off_t offset = 0; offset < end_offset; offset += header.size) {
+        wal_read_record(wal, offset, &header, payload);
+        uint32_t* fields = payload;
+        if (header.type == WAL_RECORD_CHECKPOINT) {
+            pager->root_page_num = fields[0];
+            if (fields[1] > pager->num_pages) {
+                pager->num_pages = fields[1];
+            }
+            pager->free_list_head = fields[2];
+            pager->bytes_root_page_num = fields[3];
+            pager->unlinked_overflow_page_num = fields[4];
+            continue;
         }
-        uint32_t key_at_index = *leaf_node_key(node, key_index);
-        if (key_at_index != key) {
-            return -1;
+        if (header.type == WAL_RECORD_COMMIT || header.type == WAL_RECORD_SET_PARENT) {
+            continue;
         }
-        uintptr_t** key_pointer_address = leaf_node_key_pointer(node, key_index);
-        uintptr_t* value = *key_pointer_address;
-        printf("The value is %d\n", *(uint32_t*)value);
-        return 1;
-    } else if (node_type == LEAF_NODE) {
-        uint32_t num_cells = *(uint32_t*)leaf_node_num_cells(node);
-        uint32_t key_index = binary_search(node, key);
-        if (key_index == -1) {
-            return -1;
+        if (bsearch(&header.operation_id, committed, num_committed, sizeof(uint32_t), compare_operation_ids) == NULL) {
+            continue;
         }
-        uint32_t key_at_index = *leaf_node_key(node, key_index);
-        if (key_at_index != key) {
-            return -1;
+        if (header.type == WAL_RECORD_SET_ROOT) {
+            pager->root_page_num = header.page_num;
+            continue;
         }
-        uintptr_t** key_pointer_address = leaf_node_key_pointer(node, key_index);
-        uintptr_t* value = *key_pointer_address;
-        printf("The value is %d\n", *(uint32_t*)value);
-        return 1;
-    } else {
-        printf("Unknown node type.\n");
-        exit(1);
+        if (header.type == WAL_RECORD_SET_FREE_LIST_HEAD) {
+            pager->free_list_head = header.page_num;
+            continue;
+        }
+        if (header.type == WAL_RECORD_SET_BYTES_ROOT) {
+            pager->bytes_root_page_num = header.page_num;
+            continue;
+        }
+        if (header.type == WAL_RECORD_SET_UNLINKED_OVERFLOW_PAGE) {
+            pager->unlinked_overflow_page_num = header.page_num;
+            continue;
+        }
+
+        void* node = get_page(pager, header.page_num);
+        if (*node_lsn(node) < header.lsn) {
+            switch (header.type) {
+                case WAL_RECORD_PAGE_IMAGE:
+                    memcpy(node, payload, PAGE_SIZE);
+                    break;
+                case WAL_RECORD_LEAF_INSERT:
+                    _insert_key_value_pair_to_leaf_node(node, fields[0], fields[1]);
+                    break;
+                case WAL_RECORD_LEAF_DELETE:
+                    _delete_key_from_leaf_node(node, binary_search(node, fields[0]));
+                    break;
+                case WAL_RECORD_LEAF_UPDATE:
+                    *leaf_node_value(node, binary_search(node, fields[0])) = fields[1];
+                    break;
+            }
+            *node_lsn(node) = header.lsn;
+            mark_node_dirty(pager, node);
+            wal->stats.recovered_records++;
+        }
+        unpin_node(pager, node);
     }
+    TRACE_INFO("Recovered %lu log records\n", wal->stats.recovered_records);
+
+    free(committed);
+    free(payload);
 }
 
-Pager* open_database_file(const char* filename) {
-    int fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
-    if (fd == -1) {
-        fprintf(stderr, "Unable to open file\n");
+/**
+ * @brief This method writes every dirty page to the data file, syncs it and starts the log over with a checkpoint
+ * record that holds the root page, the number of pages, the head of the free list, the root of the byte tree and
+ * the overflow chain that no leaf refers to
+ * It takes the write latch, so it must not be called from within an operation
+ * 
+ * @param pager 
+ */
+void wal_checkpoint(Pager* pager) {
+    Wal* wal = pager->wal;
+    if (wal == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&pager->write_latch);
+    wal_flush(wal, wal->next_lsn);
+    pager_flush_frames(pager, 1);
+    pager_write_meta_page(pager);
+    if (fdatasync(pager->file_descriptor) == -1) {
+        fprintf(stderr, "Error syncing the database file\n");
         exit(EXIT_FAILURE);
     }
-    off_t file_length = lseek(fd, 0, SEEK_END);
-
-    Pager* pager = malloc(sizeof(Pager));
-    pager->file_descriptor = fd;
-    pager->file_length = file_length;
-    pager->num_pages = file_length / PAGE_SIZE;
-    pager->root_page_num = 0;
 
-    for(uint32_t i = 0; i < MAX_NUM_OF_PAGES; i++) {
-        pager->pages[i] = NULL;
+    //  Every logged change is in the data file now, so the log can start over. LSNs keep counting up, since the
+    //  pages hold LSNs from before the checkpoint.
+    pthread_mutex_lock(&wal->mutex);
+    if (ftruncate(wal->file_descriptor, 0) == -1) {
+        fprintf(stderr, "Error truncating the log\n");
+        exit(EXIT_FAILURE);
     }
-    return pager;
+    wal->file_start_lsn = wal->next_lsn;
+    pthread_mutex_unlock(&wal->mutex);
+
+    uint32_t payload[5] = { pager->root_page_num, pager->num_pages, pager->free_list_head, pager->bytes_root_page_num,
+        pager->unlinked_overflow_page_num };
+    uint64_t lsn = wal_append(wal, WAL_RECORD_CHECKPOINT, INVALID_PAGE_NUM, payload, sizeof(payload));
+    wal_flush(wal, lsn + WAL_RECORD_HEADER_SIZE + sizeof(payload));
+    pthread_mutex_unlock(&pager->write_latch);
 }
 
-void pager_flush(Pager* pager, uint32_t page_num, uint32_t size) {
-    if (pager->pages[page_num] == NULL) {
-        fprintf(stderr, "Tried to flush null page\n");
+uint64_t wal_log_size(Wal* wal) {
+    pthread_mutex_lock(&wal->mutex);
+    uint64_t size = wal->next_lsn - wal->file_start_lsn;
+    pthread_mutex_unlock(&wal->mutex);
+    return size;
+}
+
+/**
+ * @brief This method opens the log next to the database file, recovers from it and starts the flusher
+ * 
+ * @param pager 
+ * @param filename The database file, the log is called <filename>-wal
+ * @param options 
+ */
+void wal_open(Pager* pager, const char* filename, PagerOptions* options) {
+    char* log_filename = malloc(strlen(filename) + sizeof("-wal"));
+    sprintf(log_filename, "%s-wal", filename);
+    int fd = open(log_filename, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+    free(log_filename);
+    if (fd == -1) {
+        fprintf(stderr, "Unable to open the log file\n");
         exit(EXIT_FAILURE);
     }
-    off_t offset = lseek(pager->file_descriptor, page_num * PAGE_SIZE, SEEK_SET);
-    if (offset == -1) {
-        fprintf(stderr, "Error seeking: %d", page_num * PAGE_SIZE);
+
+    Wal* wal = calloc(1, sizeof(Wal));
+    wal->file_descriptor = fd;
+    pthread_mutex_init(&wal->mutex, NULL);
+    pthread_cond_init(&wal->flush_requested, NULL);
+    pthread_cond_init(&wal->flush_done, NULL);
+    wal->active_buffer = malloc(WAL_BUFFER_SIZE);
+    wal->flush_buffer = malloc(WAL_BUFFER_SIZE);
+    wal->synchronous_commit = options->synchronous_commit;
+    wal->group_commit_delay_us = options->group_commit_delay_us;
+    wal->scratch_page = malloc(PAGE_SIZE);
+    pager->wal = wal;
+
+    wal_recover(pager);
+    if (pthread_create(&wal->flusher_thread, NULL, wal_flusher_main, wal) != 0) {
+        fprintf(stderr, "Unable to start the log flusher\n");
         exit(EXIT_FAILURE);
     }
-    ssize_t bytes_written = write(pager->file_descriptor, pager->pages[page_num], size);
-    if (bytes_written == -1) {
-        fprintf(stderr, "Error writing: %d", size);
+    wal_checkpoint(pager);
+}
+
+void wal_close(Pager* pager) {
+    Wal* wal = pager->wal;
+    pthread_mutex_lock(&wal->mutex);
+    wal->shutdown = 1;
+    pthread_cond_signal(&wal->flush_requested);
+    pthread_mutex_unlock(&wal->mutex);
+    pthread_join(wal->flusher_thread, NULL);
+
+    close(wal->file_descriptor);
+    pthread_mutex_destroy(&wal->mutex);
+    pthread_cond_destroy(&wal->flush_requested);
+    pthread_cond_destroy(&wal->flush_done);
+    free(wal->active_buffer);
+    free(wal->flush_buffer);
+    free(wal->scratch_page);
+    free(wal);
+    pager->wal = NULL;
+}
+
+WalStats get_wal_stats(Pager* pager) {
+    WalStats stats;
+    memset(&stats, 0, sizeof(WalStats));
+    if (pager->wal != NULL) {
+        pthread_mutex_lock(&pager->wal->mutex);
+        stats = pager->wal->stats;
+        pthread_mutex_unlock(&pager->wal->mutex);
+    }
+    return stats;
+}
+
+/**
+ * Operation trace
+ * A trace starts with its magic and format version. Every record is the type of the operation, the time since the
+ * previous record in nanoseconds as a varint, and the arguments of the operation:
+ * - get and delete: the key
+ * - insert, upsert and insert if absent: the key and the value
+ * - batch lookup: the number of keys as a varint, then the keys
+ * - scan: the key the cursor was opened at, then the number of entries read forward and backward as varints
+ * - byte tree get and delete: the size of the key as a varint, then the key
+ * - byte tree put: the key as for a get, then the size of the value as a varint
+ * - byte tree scan: the key the cursor was opened at as for a get, then the number of entries read as a varint
+ * The keys and values of the 32-bit tree take 4 bytes each, in the byte order of the machine. A scan is recorded when its cursor is closed,
+ * since only then is it known how far it went. The values of the byte tree are not recorded, only their sizes. Bulk
+ * loads are not traced.
+ */
+const uint32_t OPERATION_TRACE_MAGIC = 0x45435254;
+const uint32_t OPERATION_TRACE_VERSION = 1;
+const uint32_t OPERATION_TRACE_HEADER_SIZE = 2 * sizeof(uint32_t);
+#define OPERATION_TRACE_MAX_RECORD_SIZE 32
+
+uint32_t varint_encode(uint8_t* buffer, uint64_t value) {
+    uint32_t size = 0;
+    while (value >= 0x80) {
+        buffer[size++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    buffer[size++] = (uint8_t)value;
+    return size;
+}
+
+/**
+ * @brief This method opens a file to trace the operations of a pager into, replacing what the file held
+ * 
+ * @param filename 
+ * @return OperationTrace* 
+ */
+OperationTrace* operation_trace_open(const char* filename) {
+    int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+    if (fd == -1) {
+        fprintf(stderr, "Unable to open the operation trace %s\n", filename);
         exit(EXIT_FAILURE);
     }
-    return;
+    OperationTrace* trace = malloc(sizeof(OperationTrace));
+    trace->file_descriptor = fd;
+    pthread_mutex_init(&trace->mutex, NULL);
+    trace->buffer = malloc(OPERATION_TRACE_BUFFER_SIZE);
+    memcpy(trace->buffer, &OPERATION_TRACE_MAGIC, sizeof(uint32_t));
+    memcpy(trace->buffer + sizeof(uint32_t), &OPERATION_TRACE_VERSION, sizeof(uint32_t));
+    trace->buffer_used = OPERATION_TRACE_HEADER_SIZE;
+    trace->start_time = stats_clock();
+    trace->last_time = trace->start_time;
+    return trace;
 }
 
-void close_database_file(Pager* pager) {
-    for(uint32_t i = 0; i < MAX_NUM_OF_PAGES; i++) {
-        if (pager->pages[i] == NULL) {
-            continue;
+void operation_trace_flush_locked(OperationTrace* trace) {
+    uint32_t written = 0;
+    while (written < trace->buffer_used) {
+        ssize_t bytes = write(trace->file_descriptor, trace->buffer + written, trace->buffer_used - written);
+        if (bytes <= 0) {
+            fprintf(stderr, "Error writing the operation trace\n");
+            exit(EXIT_FAILURE);
         }
-        pager_flush(pager, i, PAGE_SIZE);
-        free(pager->pages[i]);
-        pager->pages[i] = NULL;
+        written += bytes;
     }
-    int result = close(pager->file_descriptor);
-    if (result == -1) {
-        fprintf(stderr, "Error closing db file.\n");
+    trace->buffer_used = 0;
+}
+
+void operation_trace_close(OperationTrace* trace) {
+    operation_trace_flush_locked(trace);
+    if (close(trace->file_descriptor) == -1) {
+        fprintf(stderr, "Error closing the operation trace\n");
         exit(EXIT_FAILURE);
     }
-    for(uint32_t i = 0; i < MAX_NUM_OF_PAGES; i++) {
-        free(pager->pages[i]);
+    pthread_mutex_destroy(&trace->mutex);
+    free(trace->buffer);
+    free(trace);
+}
+
+void operation_trace_append_locked(OperationTrace* trace, const void* data, uint32_t size) {
+    while (size > 0) {
+        if (trace->buffer_used == OPERATION_TRACE_BUFFER_SIZE) {
+            operation_trace_flush_locked(trace);
+        }
+        uint32_t chunk_size = OPERATION_TRACE_BUFFER_SIZE - trace->buffer_used;
+        chunk_size = size < chunk_size ? size : chunk_size;
+        memcpy(trace->buffer + trace->buffer_used, data, chunk_size);
+        trace->buffer_used += chunk_size;
+        data += chunk_size;
+        size -= chunk_size;
     }
-    free(pager);
 }
 
-uint32_t get_root_page(Pager* pager) {
-    return pager->root_page_num;
+/**
+ * @brief This method starts a record with its type and the time since the previous record
+ * The time is taken under the mutex, so the times of the records never go backwards
+ * 
+ * @param trace 
+ * @param type 
+ * @param record 
+ * @return uint32_t The size of what was written to the record
+ */
+uint32_t operation_trace_start_record_locked(OperationTrace* trace, TracedOperationType type, uint8_t* record) {
+    uint64_t now = stats_clock();
+    record[0] = type;
+    uint32_t size = 1 + varint_encode(record + 1, now - trace->last_time);
+    trace->last_time = now;
+    return size;
 }
 
-void set_root_page(Pager* pager, uint32_t root_page_num) {
-    pager->root_page_num = root_page_num;
+/**
+ * @brief This method traces a single key operation, if the pager traces its operations
+ * 
+ * @param pager 
+ * @param type 
+ * @param key 
+ * @param value Ignored for gets and deletes
+ */
+void operation_trace_record(Pager* pager, TracedOperationType type, uint32_t key, uint32_t value) {
+    OperationTrace* trace = pager->operation_trace;
+    if (trace == NULL) {
+        return;
+    }
+    uint8_t record[OPERATION_TRACE_MAX_RECORD_SIZE];
+    pthread_mutex_lock(&trace->mutex);
+    uint32_t size = operation_trace_start_record_locked(trace, type, record);
+    memcpy(record + size, &key, sizeof(uint32_t));
+    size += sizeof(uint32_t);
+    if (type != TRACED_GET && type != TRACED_DELETE) {
+        memcpy(record + size, &value, sizeof(uint32_t));
+        size += sizeof(uint32_t);
+    }
+    operation_trace_append_locked(trace, record, size);
+    pthread_mutex_unlock(&trace->mutex);
 }
 
-void* get_page(Pager* pager, uint32_t page_num) {
-    if (pager->pages[page_num] == NULL) {
-        void* page = malloc(PAGE_SIZE);
-        uint32_t num_pages = pager->file_length / PAGE_SIZE;
-        
-        if (page_num <= num_pages) {
-            lseek(pager->file_descriptor, page_num * PAGE_SIZE, SEEK_SET);
-            ssize_t bytes_read = read(pager->file_descriptor, page, PAGE_SIZE);
-            if (bytes_read == -1) {
-                fprintf(stderr, "Error reading file: %d", page_num);
-                exit(EXIT_FAILURE);
-            }
+void operation_trace_record_multi_get(Pager* pager, const uint32_t* keys, uint32_t num_keys) {
+    OperationTrace* trace = pager->operation_trace;
+    if (trace == NULL) {
+        return;
+    }
+    uint8_t record[OPERATION_TRACE_MAX_RECORD_SIZE];
+    pthread_mutex_lock(&trace->mutex);
+    uint32_t size = operation_trace_start_record_locked(trace, TRACED_MULTI_GET, record);
+    size += varint_encode(record + size, num_keys);
+    operation_trace_append_locked(trace, record, size);
+    operation_trace_append_locked(trace, keys, num_keys * sizeof(uint32_t));
+    pthread_mutex_unlock(&trace->mutex);
+}
+
+void operation_trace_record_scan(Pager* pager, uint32_t key, uint32_t num_next, uint32_t num_prev) {
+    OperationTrace* trace = pager->operation_trace;
+    if (trace == NULL) {
+        return;
+    }
+    uint8_t record[OPERATION_TRACE_MAX_RECORD_SIZE];
+    pthread_mutex_lock(&trace->mutex);
+    uint32_t size = operation_trace_start_record_locked(trace, TRACED_SCAN, record);
+    memcpy(record + size, &key, sizeof(uint32_t));
+    size += sizeof(uint32_t);
+    size += varint_encode(record + size, num_next);
+    size += varint_encode(record + size, num_prev);
+    operation_trace_append_locked(trace, record, size);
+    pthread_mutex_unlock(&trace->mutex);
+}
+
+/**
+ * @brief This method traces an operation on the byte tree, if the pager traces its operations
+ * 
+ * @param pager 
+ * @param type 
+ * @param key 
+ * @param key_size 
+ * @param count The size of the value of a put, or the number of entries a scan read, ignored otherwise
+ */
+void operation_trace_record_bytes(Pager* pager, TracedOperationType type, const void* key, uint32_t key_size,
+    uint32_t count) {
+    OperationTrace* trace = pager->operation_trace;
+    if (trace == NULL) {
+        return;
+    }
+    uint8_t record[OPERATION_TRACE_MAX_RECORD_SIZE];
+    pthread_mutex_lock(&trace->mutex);
+    uint32_t size = operation_trace_start_record_locked(trace, type, record);
+    size += varint_encode(record + size, key_size);
+    operation_trace_append_locked(trace, record, size);
+    operation_trace_append_locked(trace, key, key_size);
+    if (type == TRACED_PUT_BYTES || type == TRACED_SCAN_BYTES) {
+        size = varint_encode(record, count);
+        operation_trace_append_locked(trace, record, size);
+    }
+    pthread_mutex_unlock(&trace->mutex);
+}
+
+/**
+ * @brief This method reads a whole trace into memory, so that replaying it does not wait for the file
+ * 
+ * @param filename 
+ * @return OperationTraceReader* 
+ */
+OperationTraceReader* operation_trace_reader_open(const char* filename) {
+    int fd = open(filename, O_RDONLY);
+    struct stat file_stat;
+    if (fd == -1 || fstat(fd, &file_stat) == -1) {
+        fprintf(stderr, "Unable to open the operation trace %s\n", filename);
+        exit(EXIT_FAILURE);
+    }
+    OperationTraceReader* reader = calloc(1, sizeof(OperationTraceReader));
+    reader->size = file_stat.st_size;
+    reader->data = malloc(reader->size > 0 ? reader->size : 1);
+    uint64_t bytes_read = 0;
+    while (bytes_read < reader->size) {
+        ssize_t bytes = read(fd, reader->data + bytes_read, reader->size - bytes_read);
+        if (bytes <= 0) {
+            fprintf(stderr, "Error reading the operation trace %s\n", filename);
+            exit(EXIT_FAILURE);
         }
-        pager->pages[page_num] = page;
+        bytes_read += bytes;
+    }
+    close(fd);
+
+    uint32_t magic;
+    uint32_t version;
+    if (reader->size < OPERATION_TRACE_HEADER_SIZE) {
+        fprintf(stderr, "%s is not an operation trace\n", filename);
+        exit(EXIT_FAILURE);
+    }
+    memcpy(&magic, reader->data, sizeof(uint32_t));
+    memcpy(&version, reader->data + sizeof(uint32_t), sizeof(uint32_t));
+    if (magic != OPERATION_TRACE_MAGIC || version != OPERATION_TRACE_VERSION) {
+        fprintf(stderr, "%s is not an operation trace of version %u\n", filename, OPERATION_TRACE_VERSION);
+        exit(EXIT_FAILURE);
+    }
+    reader->position = OPERATION_TRACE_HEADER_SIZE;
+    return reader;
+}
 
-        if (page_num >= pager->num_pages) {
-            pager->num_pages = page_num + 1;
+void operation_trace_read_bytes(OperationTraceReader* reader, void* destination, uint64_t size) {
+    if (reader->size - reader->position < size) {
+        fprintf(stderr, "The operation trace is truncated at byte %lu\n", reader->position);
+        exit(EXIT_FAILURE);
+    }
+    memcpy(destination, reader->data + reader->position, size);
+    reader->position += size;
+}
+
+uint64_t operation_trace_read_varint(OperationTraceReader* reader) {
+    uint64_t value = 0;
+    for (uint32_t shift = 0; shift < 64; shift += 7) {
+        uint8_t byte;
+        operation_trace_read_bytes(reader, &byte, 1);
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if (byte < 0x80) {
+            return value;
         }
     }
-    return pager->pages[page_num];
+    fprintf(stderr, "The operation trace has a malformed varint at byte %lu\n", reader->position);
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * @brief This method reads the next operation of a trace
+ * 
+ * @param reader 
+ * @param operation Set to the operation, with its time counted from the start of the trace
+ * @return int 0 at the end of the trace
+ */
+int operation_trace_read(OperationTraceReader* reader, TracedOperation* operation) {
+    if (reader->position == reader->size) {
+        return 0;
+    }
+    uint8_t type;
+    operation_trace_read_bytes(reader, &type, 1);
+    reader->time += operation_trace_read_varint(reader);
+    memset(operation, 0, sizeof(TracedOperation));
+    operation->type = type;
+    operation->time = reader->time;
+    switch (type) {
+        case TRACED_GET:
+        case TRACED_DELETE:
+            operation_trace_read_bytes(reader, &operation->key, sizeof(uint32_t));
+            break;
+        case TRACED_INSERT:
+        case TRACED_UPSERT:
+        case TRACED_INSERT_IF_ABSENT:
+            operation_trace_read_bytes(reader, &operation->key, sizeof(uint32_t));
+            operation_trace_read_bytes(reader, &operation->value, sizeof(uint32_t));
+            break;
+        case TRACED_MULTI_GET:
+            operation->num_keys = operation_trace_read_varint(reader);
+            if (operation->num_keys > reader->keys_capacity) {
+                reader->keys_capacity = operation->num_keys;
+                reader->keys = realloc(reader->keys, reader->keys_capacity * sizeof(uint32_t));
+            }
+            operation_trace_read_bytes(reader, reader->keys, operation->num_keys * sizeof(uint32_t));
+            operation->keys = reader->keys;
+            break;
+        case TRACED_SCAN:
+            operation_trace_read_bytes(reader, &operation->key, sizeof(uint32_t));
+            operation->num_next = operation_trace_read_varint(reader);
+            operation->num_prev = operation_trace_read_varint(reader);
+            break;
+        case TRACED_GET_BYTES:
+        case TRACED_PUT_BYTES:
+        case TRACED_DELETE_BYTES:
+        case TRACED_SCAN_BYTES:
+            operation->key_size = operation_trace_read_varint(reader);
+            if (reader->size - reader->position < operation->key_size) {
+                fprintf(stderr, "The operation trace is truncated at byte %lu\n", reader->position);
+                exit(EXIT_FAILURE);
+            }
+            //  The whole trace is in memory, so the key is read in place
+            operation->key_bytes = reader->data + reader->position;
+            reader->position += operation->key_size;
+            if (type == TRACED_PUT_BYTES) {
+                operation->value_size = operation_trace_read_varint(reader);
+            } else if (type == TRACED_SCAN_BYTES) {
+                operation->num_next = operation_trace_read_varint(reader);
+            }
+            break;
+        default:
+            fprintf(stderr, "Unknown operation %u in the operation trace at byte %lu\n", type, reader->position - 1);
+            exit(EXIT_FAILURE);
+    }
+    return 1;
+}
+
+void operation_trace_reader_close(OperationTraceReader* reader) {
+    free(reader->data);
+    free(reader->keys);
+    free(reader);
 }
 
-void print_internal_node(void* node) {
+void print_internal_node(Pager* pager, void* node) {
     printf("Printing internal node\n");
     uint32_t num_keys = *internal_node_num_keys(node);
     printf("The number of cells is %d\n", num_keys);
-    for (uint32_t i = 0; i < num_keys; i++) {
-        printf("The key is %d\n", *internal_node_key(node, i));
-        printf("The child pointer is %p\n", internal_node_child_pointer(node, i));
-        print_node(*internal_node_child_pointer(node, i));
+    for (uint32_t i = 0; i <= num_keys; i++) {
+        if (i < num_keys) {
+            printf("The key is %d\n", *internal_node_key(node, i));
+            printf("The child pointer is page %d\n", get_child_page_num(pager, *internal_node_child_pointer(node, i)));
+        } else {
+            printf("The right child pointer is page %d\n", get_child_page_num(pager, *internal_node_right_child_pointer(node)));
+        }
+        void* child_node = get_child_node(pager, node, internal_node_child_at(node, i));
+        print_node(pager, child_node);
+        unpin_node(pager, child_node);
     }
-    printf("The right child pointer is %p\n", internal_node_right_child_pointer(node));
-    print_node(*internal_node_right_child_pointer(node));
 }
 
 void print_leaf_node(void* node) {
@@ -782,17 +6799,16 @@ void print_leaf_node(void* node) {
     printf("The number of cells is %d\n", num_cells);
     for (uint32_t i = 0; i < num_cells; i++) {
         printf("The key is %d\n", *leaf_node_key(node, i));
-        printf("The value is %d\n", *(uint32_t*)*leaf_node_key_pointer(node, i));
+        printf("The value is %d\n", *leaf_node_value(node, i));
     }
 }
 
-void print_node(void* node) {
+void print_node(Pager* pager, void* node) {
     printf("Printing node\n");
-    uint32_t num_cells = *(uint32_t*)leaf_node_num_cells(node);
     int node_type = check_type_of_node(node);
     if (node_type == INTERNAL_NODE) {
         //  print internal node
-        print_internal_node(node);
+        print_internal_node(pager, node);
     } else if (node_type == LEAF_NODE) {
         //  print leaf node
         print_leaf_node(node);
@@ -804,9 +6820,12 @@ void print_all_pages(Pager* pager) {
     printf("Printing all pages\n");
     uint32_t root_page_num = pager->root_page_num;
     void* root_node = get_page(pager, root_page_num);
-    print_node(root_node);
+    print_node(pager, root_node);
+    unpin_node(pager, root_node);
 }
 
+//  The library is built with BTREE_LIBRARY defined, which leaves this demo out
+#ifndef BTREE_LIBRARY
 int main() {
     Pager* pager = open_database_file("test.db");
     insert(pager, 3, 3);
@@ -819,4 +6838,5 @@ int main() {
     print_all_pages(pager);
     close_database_file(pager);
     return 0;
-}
\ No newline at end of file
+}
+#endif
@@ -1,22 +1,633 @@
 #include <stdint.h>
+#include <pthread.h>
 
-#define MAX_NUM_OF_PAGES 100
+#define DEFAULT_BUFFER_POOL_SIZE 1024
+#define SWIZZLED_POINTER_FLAG 0x80000000u
+#define INVALID_PAGE_NUM UINT32_MAX
+#define DEFAULT_READAHEAD_PAGES 8
+#define MAX_READAHEAD_PAGES 64
+#define WAL_BUFFER_SIZE (1 << 20)
+#define IO_RING_ENTRIES 64
+#define DEFAULT_CHECKPOINT_PAGES_PER_SECOND 1024
+#define DEFAULT_CHECKPOINT_LOG_SIZE (64 << 20)
+#define CHECKPOINTER_WAKEUPS_PER_SECOND 10
+#define MAX_TREE_HEIGHT 16
+#define MAX_OPERATION_FRAMES (4 * MAX_TREE_HEIGHT + 4)
+#define MULTI_GET_GROUP_SIZE 16
+#define DEFAULT_MMAP_RESERVE_SIZE (1ull << 36)
+#define MMAP_EXTENT_PAGES 4096
+#define HUGE_PAGE_SIZE (2u << 20)
+#define LATENCY_HISTOGRAM_BUCKETS 40
+#define TREE_STATS_SHARDS 16
+#define OPERATION_TRACE_BUFFER_SIZE (64 << 10)
+
+/**
+ * Tracing
+ * TRACE_INFO reports events that happen once in a while, like recovery and bulk loads, and TRACE_DEBUG follows the
+ * tree through every step of an operation. Both compile to nothing above BTREE_TRACE_LEVEL, which is quiet when
+ * NDEBUG is defined. The arguments are still type checked.
+ */
+#define TRACE_LEVEL_NONE 0
+#define TRACE_LEVEL_INFO 1
+#define TRACE_LEVEL_DEBUG 2
+
+#ifndef BTREE_TRACE_LEVEL
+#ifdef NDEBUG
+#define BTREE_TRACE_LEVEL TRACE_LEVEL_NONE
+#else
+#define BTREE_TRACE_LEVEL TRACE_LEVEL_DEBUG
+#endif
+#endif
+
+#define TRACE(level, ...) \
+    do { \
+        if ((level) <= BTREE_TRACE_LEVEL) { \
+            printf(__VA_ARGS__); \
+        } \
+    } while (0)
+#define TRACE_INFO(...) TRACE(TRACE_LEVEL_INFO, __VA_ARGS__)
+#define TRACE_DEBUG(...) TRACE(TRACE_LEVEL_DEBUG, __VA_ARGS__)
+
+/**
+ * Statistics of the tree are on unless BTREE_STATS is defined as 0
+ */
+#ifndef BTREE_STATS
+#define BTREE_STATS 1
+#endif
+
+/**
+ * A frame is a slot in the buffer pool that can hold one page
+ * Frames that hash to the same bucket of the page table are chained through next_in_bucket
+ * The version is the optimistic latch of the node held by the frame, it is odd while the node is being changed
+ */
+typedef struct {
+    uint64_t version;
+    uint32_t page_num;
+    uint32_t pin_count;
+    uint8_t is_dirty;
+    uint8_t reference_bit;
+    int32_t next_in_bucket;
+    int32_t swizzled_parent;
+    uint8_t in_operation;
+    uint8_t needs_image;
+    void* page;
+} Frame;
+
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    uint64_t dirty_writebacks;
+    uint64_t swizzled_hits;
+    uint64_t prefetches;
+    uint64_t io_submissions;
+    uint64_t background_writes;
+    uint64_t page_reads;
+    uint64_t page_writes;
+} BufferPoolStats;
+
+typedef enum {
+    OPERATION_GET,
+    OPERATION_INSERT,
+    OPERATION_DELETE,
+    OPERATION_MULTI_GET,
+    OPERATION_SCAN,
+    NUM_OPERATION_TYPES
+} OperationType;
+
+/**
+ * Counters of the tree, summed over all threads by get_tree_stats()
+ * Bucket i of a latency histogram counts the operations that took between 2^i and 2^(i+1) - 1 nanoseconds.
+ * Latencies are only measured when PagerOptions.track_latency is set. The buffer pool fields are taken from
+ * BufferPoolStats, with the hits of optimistic reads added in.
+ */
+typedef struct {
+    uint64_t operations[NUM_OPERATION_TYPES];
+    uint64_t node_visits;
+    uint64_t key_comparisons;
+    uint64_t restarts;
+    uint64_t leaf_splits;
+    uint64_t internal_splits;
+    uint64_t root_splits;
+    uint64_t leaf_merges;
+    uint64_t internal_merges;
+    uint64_t borrows;
+    uint64_t root_collapses;
+    uint64_t fast_appends;
+    uint64_t page_versions;
+    uint64_t hash_index_hits;
+    uint64_t hash_index_misses;
+    uint64_t page_reads;
+    uint64_t page_writes;
+    uint64_t buffer_hits;
+    uint64_t buffer_misses;
+    uint64_t latency_histogram[NUM_OPERATION_TYPES][LATENCY_HISTOGRAM_BUCKETS];
+} TreeStats;
+
+#define TREE_STATS_SHARD_SIZE ((sizeof(TreeStats) + 63) / 64 * 64)
+
+/**
+ * The counters that are bumped on every node an operation reads. They are kept per thread and moved into the tree
+ * stats when an operation finishes, see stats_operation_finish()
+ */
+typedef struct {
+    uint64_t node_visits;
+    uint64_t key_comparisons;
+    uint64_t restarts;
+    uint64_t buffer_hits;
+    uint64_t hash_index_hits;
+    uint64_t hash_index_misses;
+} ThreadStats;
+
+extern __thread ThreadStats thread_stats;
+
+#if BTREE_STATS
+#define STATS_COUNT(field, count) (thread_stats.field += (count))
+#define STATS_ADD(pager, field, count) stats_shard_add(&stats_shard(pager)->field, (count))
+#else
+#define STATS_COUNT(field, count) ((void)(count))
+#define STATS_ADD(pager, field, count) ((void)(count))
+#endif
+
+typedef struct {
+    uint64_t records;
+    uint64_t bytes;
+    uint64_t commits;
+    uint64_t syncs;
+    uint64_t recovered_records;
+} WalStats;
+
+/**
+ * The write-ahead log of a pager
+ * Records are appended to the active buffer by the thread that modifies the tree. The flusher thread swaps the
+ * buffers, writes the full one out and syncs the log, so every commit that arrived in the meantime is made durable
+ * by the same fdatasync. An LSN is the position of a record in the log, counted from the creation of the log.
+ */
+typedef struct {
+    int file_descriptor;
+    pthread_t flusher_thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t flush_requested;
+    pthread_cond_t flush_done;
+    uint8_t* active_buffer;
+    uint8_t* flush_buffer;
+    uint32_t buffer_used;
+    uint64_t buffer_start_lsn;
+    uint64_t file_start_lsn;
+    uint64_t next_lsn;
+    uint64_t flushed_lsn;
+    uint64_t requested_lsn;
+    uint8_t shutdown;
+    uint8_t synchronous_commit;
+    uint32_t group_commit_delay_us;
+    uint32_t operation_id;
+    uint32_t num_operation_records;
+    void* scratch_page;
+    WalStats stats;
+} Wal;
+
+typedef enum {
+    IO_BACKEND_AUTO,
+    IO_BACKEND_PREAD,
+    IO_BACKEND_IO_URING
+} IoBackend;
+
+typedef enum {
+    HUGE_PAGES_TRANSPARENT,
+    HUGE_PAGES_EXPLICIT,
+    HUGE_PAGES_NONE
+} HugePageMode;
+
+typedef enum {
+    TRACED_GET = 1,
+    TRACED_INSERT,
+    TRACED_UPSERT,
+    TRACED_INSERT_IF_ABSENT,
+    TRACED_DELETE,
+    TRACED_MULTI_GET,
+    TRACED_SCAN,
+    TRACED_GET_BYTES,
+    TRACED_PUT_BYTES,
+    TRACED_DELETE_BYTES,
+    TRACED_SCAN_BYTES
+} TracedOperationType;
+
+/**
+ * A binary trace of the operations called on a pager, for replaying them later, see operation_trace_open()
+ * Threads append their records under the mutex, so the trace is one sequence in the order the operations arrived.
+ */
+typedef struct {
+    int file_descriptor;
+    pthread_mutex_t mutex;
+    uint8_t* buffer;
+    uint32_t buffer_used;
+    uint64_t start_time;
+    uint64_t last_time;
+} OperationTrace;
+
+/**
+ * One operation read back from a trace
+ * The keys of a batch lookup stay valid until the next operation is read. A scan returned num_next entries going
+ * forward and num_prev going backward from key. An operation on the byte tree has its key in key_bytes, which stays
+ * valid until the reader is closed, and a put has the size of its value in value_size.
+ */
+typedef struct {
+    TracedOperationType type;
+    uint64_t time;
+    uint32_t key;
+    uint32_t value;
+    uint32_t num_keys;
+    const uint32_t* keys;
+    uint32_t num_next;
+    uint32_t num_prev;
+    const uint8_t* key_bytes;
+    uint32_t key_size;
+    uint32_t value_size;
+} TracedOperation;
+
+typedef struct {
+    uint8_t* data;
+    uint64_t size;
+    uint64_t position;
+    uint64_t time;
+    uint32_t* keys;
+    uint32_t keys_capacity;
+} OperationTraceReader;
+
+/**
+ * An io_uring instance of a pager, driven through the raw system calls
+ * It is only used under the pager latch. The frames of the buffer pool are registered with it, so reads and writes
+ * of pages go straight to and from the frames.
+ */
+typedef struct {
+    int ring_fd;
+    uint32_t num_entries;
+    void* sq_ring;
+    size_t sq_ring_size;
+    void* cq_ring;
+    size_t cq_ring_size;
+    uint32_t* sq_head;
+    uint32_t* sq_tail;
+    uint32_t* sq_ring_mask;
+    uint32_t* sq_array;
+    uint32_t* cq_head;
+    uint32_t* cq_tail;
+    uint32_t* cq_ring_mask;
+    struct io_uring_sqe* sqes;
+    size_t sqes_size;
+    struct io_uring_cqe* cqes;
+    uint8_t has_fixed_buffers;
+} IoRing;
+
+/**
+ * Orders the keys of the byte tree like memcmp(), see compare_bytes() for the default
+ */
+typedef int (*KeyComparator)(const void* a, uint32_t a_size, const void* b, uint32_t b_size);
 
+typedef struct {
+    uint32_t buffer_pool_size;
+    uint8_t swizzle_pointers;
+    uint32_t readahead_pages;
+    uint8_t wal_enabled;
+    uint8_t synchronous_commit;
+    uint32_t group_commit_delay_us;
+    IoBackend io_backend;
+    uint8_t direct_io;
+    uint32_t checkpoint_pages_per_second;
+    uint64_t checkpoint_log_size;
+    HugePageMode huge_pages;
+    uint8_t memory_mapped;
+    uint64_t mmap_reserve_size;
+    uint8_t track_latency;
+    const char* operation_trace_filename;
+    KeyComparator key_comparator;
+    uint64_t hash_index_size;
+} PagerOptions;
+
+/**
+ * An entry of the adaptive hash index, see hash_index_get()
+ * count is how often key was looked up by a descent. page_num is INVALID_PAGE_NUM until the key is hot enough.
+ */
+typedef struct {
+    uint32_t key;
+    uint32_t page_num;
+    uint16_t cell_num;
+    uint16_t count;
+} HashIndexEntry;
+
+/**
+ * The nodes a writer descended through, from the root at level 0 down to a leaf
+ * child_indices[i] is the index of nodes[i] in nodes[i - 1]
+ */
+typedef struct {
+    void* nodes[MAX_TREE_HEIGHT];
+    uint32_t child_indices[MAX_TREE_HEIGHT];
+    uint32_t depth;
+} TreePath;
+
+/**
+ * The pager latch guards the page table, the clock and the frame bookkeeping, and is held across the I/O of a miss.
+ * Writers are serialized by the write latch, and an operation keeps the frames of the nodes it changes write
+ * latched until it ends. Readers take neither, they validate node versions instead.
+ * The checkpointer sweeps the dirty frames in page number order, writing a few of them on every wakeup.
+ * When the file is memory mapped, the frames cover the mapping instead of a buffer pool, see mmap_open().
+ */
 typedef struct {
     int file_descriptor;
     uint32_t file_length;
     uint32_t num_pages;
-    void* pages[MAX_NUM_OF_PAGES];
     uint32_t root_page_num;
+    uint32_t bytes_root_page_num;
+    KeyComparator compare_keys;
+    uint32_t num_frames;
+    uint32_t num_frames_used;
+    uint32_t clock_hand;
+    uint8_t swizzle_pointers;
+    uint32_t readahead_pages;
+    Frame* frames;
+    void* frame_buffer;
+    size_t frame_buffer_size;
+    int32_t* page_table;
+    uint32_t page_table_mask;
+    BufferPoolStats stats;
+    pthread_mutex_t latch;
+    pthread_mutex_t write_latch;
+    uint8_t in_operation;
+    pthread_t operation_thread;
+    uint32_t* operation_frames;
+    uint32_t num_operation_frames;
+    TreePath path;
+    uint32_t append_leaf_page_num;
+    Wal* wal;
+    IoRing* io_ring;
+    uint8_t direct_io;
+    pthread_t checkpointer_thread;
+    pthread_cond_t checkpointer_wakeup;
+    uint8_t checkpointer_running;
+    uint8_t checkpointer_shutdown;
+    uint32_t checkpoint_pages_per_second;
+    uint64_t checkpoint_log_size;
+    uint32_t checkpoint_position;
+    void* meta_page;
+    uint32_t free_list_head;
+    uint32_t unlinked_overflow_page_num;
+    pthread_mutex_t overflow_mutex;
+    void* mmap_base;
+    uint32_t mmap_max_pages;
+    TreeStats* tree_stats;
+    uint8_t track_latency;
+    OperationTrace* operation_trace;
+    struct Snapshot* snapshots;
+    uint64_t snapshot_epoch;
+    pthread_mutex_t snapshot_mutex;
+    struct PageVersion** page_versions;
+    uint32_t num_page_versions;
+    HashIndexEntry* hash_index;
+    uint32_t hash_index_mask;
 } Pager;
 
+/**
+ * A read-only view of the tree as it was when it was opened, see snapshot_open()
+ * The pages of the view are the pages of the file, except for the pages that changed since, which are read from
+ * their saved versions. A snapshot is read by one thread at a time.
+ */
+typedef struct Snapshot {
+    Pager* pager;
+    uint64_t epoch;
+    uint32_t root_page_num;
+    uint32_t bytes_root_page_num;
+    uint32_t num_pages;
+    void* page;
+    struct Snapshot* next;
+} Snapshot;
+
+/**
+ * The image a page had before its first change after a snapshot was opened
+ * epoch is the epoch of the newest open snapshot when the image was saved. A snapshot reads the version of a page
+ * with the smallest epoch that is not older than its own.
+ */
+typedef struct PageVersion {
+    uint32_t page_num;
+    uint64_t epoch;
+    void* page;
+    struct PageVersion* next;
+} PageVersion;
+
+typedef struct {
+    Pager* pager;
+    void* node;
+    uint64_t version;
+    uint32_t cell_num;
+    uint32_t boundary_key;
+    uint8_t past_last_key;
+    uint32_t readahead_pages[MAX_READAHEAD_PAGES];
+    uint32_t num_readahead_pages;
+    uint32_t next_readahead_page;
+    uint32_t trace_key;
+    uint32_t num_next;
+    uint32_t num_prev;
+} Cursor;
+
+typedef struct {
+    Snapshot* snapshot;
+    void* node;
+    uint32_t cell_num;
+} SnapshotCursor;
+
+/**
+ * A cursor over the byte tree, see bytes_cursor_open()
+ * The leaf the cursor is in is not pinned, it is kept as a frame and the version the frame had. frame_index is -1
+ * when the cursor has to go back to the tree for key.
+ */
+typedef struct {
+    Pager* pager;
+    int32_t frame_index;
+    uint64_t version;
+    uint32_t cell_num;
+    uint8_t* key;
+    uint32_t key_size;
+    uint8_t* next_key;
+    uint8_t inclusive;
+    uint8_t* trace_key;
+    uint32_t trace_key_size;
+    uint32_t num_next;
+} BytesCursor;
+
+typedef enum {
+    KEY_SEARCH_AUTO,
+    KEY_SEARCH_SCALAR,
+    KEY_SEARCH_SSE42,
+    KEY_SEARCH_AVX2
+} KeySearchKernel;
+
+void set_key_search_kernel(KeySearchKernel kernel);
+KeySearchKernel get_key_search_kernel();
+uint32_t key_lower_bound(const uint32_t* keys, uint32_t num_keys, uint32_t key);
+
 int binary_search(void* node, uint32_t key);
-int binary_search_modify_pointer(void** node, uint32_t key);
 int search(Pager* pager, uint32_t key);
+void insert(Pager* pager, uint32_t key, uint32_t value);
+void delete(Pager* pager, uint32_t key);
+
+int bt_get(Pager* pager, uint32_t key, uint32_t* value);
+int bt_upsert(Pager* pager, uint32_t key, uint32_t value);
+int bt_insert_if_absent(Pager* pager, uint32_t key, uint32_t value);
+int bt_delete(Pager* pager, uint32_t key);
+uint32_t bt_multi_get(Pager* pager, const uint32_t* keys, uint32_t num_keys, uint32_t* values, uint8_t* found);
+
+void* descend_to_leaf(Pager* pager, uint32_t key, uint8_t initialize_empty_root);
+void* find_append_leaf(Pager* pager, uint32_t key);
+void* descend_to_leaf_for_insert(Pager* pager, uint32_t key);
+int is_on_right_edge(Pager* pager, void* node);
+void release_path(Pager* pager);
+uint32_t get_path_level(Pager* pager, void* node);
+void* get_parent_node(Pager* pager, void* node, uint32_t* child_index);
+void push_root_onto_path(Pager* pager, void* new_root);
+
+#define BULK_LOAD_MAX_LEVELS 16
+
+typedef struct {
+    int (*next)(void* context, uint32_t* key, uint32_t* value);
+    void* context;
+} BulkLoadIterator;
+
+void bulk_load(Pager* pager, BulkLoadIterator* iterator, double fill_factor);
+
+Cursor* cursor_open(Pager* pager, uint32_t lo);
+int cursor_next(Cursor* cursor, uint32_t* key, uint32_t* value);
+int cursor_prev(Cursor* cursor, uint32_t* key, uint32_t* value);
+void cursor_close(Cursor* cursor);
+
+int compare_bytes(const void* a, uint32_t a_size, const void* b, uint32_t b_size);
+int bt_put_bytes(Pager* pager, const void* key, uint32_t key_size, const void* value, uint32_t value_size);
+int bt_get_bytes(Pager* pager, const void* key, uint32_t key_size, void* value, uint32_t value_capacity,
+    uint32_t* value_size);
+int bt_delete_bytes(Pager* pager, const void* key, uint32_t key_size);
+BytesCursor* bytes_cursor_open(Pager* pager, const void* lo, uint32_t lo_size);
+int bytes_cursor_next(BytesCursor* cursor, const void** key, uint32_t* key_size, void* value, uint32_t value_capacity,
+    uint32_t* value_size);
+void bytes_cursor_close(BytesCursor* cursor);
+
+int hash_index_get(Pager* pager, uint32_t key, uint32_t* value);
+void hash_index_record(Pager* pager, uint32_t key, uint32_t page_num, uint32_t cell_num);
+void hash_index_invalidate(Pager* pager, uint32_t key);
+void hash_index_remove(Pager* pager, uint32_t key);
+void hash_index_clear(Pager* pager);
+
+Snapshot* snapshot_open(Pager* pager);
+void snapshot_close(Snapshot* snapshot);
+void snapshot_read_page(Snapshot* snapshot, uint32_t page_num, void* page);
+int snapshot_get(Snapshot* snapshot, uint32_t key, uint32_t* value);
+SnapshotCursor* snapshot_cursor_open(Snapshot* snapshot, uint32_t lo);
+int snapshot_cursor_next(SnapshotCursor* cursor, uint32_t* key, uint32_t* value);
+void snapshot_cursor_close(SnapshotCursor* cursor);
+void snapshot_save_page_version(Pager* pager, Frame* frame);
+void compact_bytes_node(void* node);
+uint16_t bytes_node_allocate_cell(void* node, uint16_t size);
+uint32_t bytes_node_search(Pager* pager, void* node, const void* key, uint32_t key_size, int upper_bound, int* found);
+void* bytes_descend_to_leaf(Pager* pager, const void* key, uint32_t key_size, uint8_t create_empty_root);
+int32_t bytes_descend_optimistic(Pager* pager, const void* key, uint32_t key_size, uint64_t* version);
+void bytes_split_node(Pager* pager, void* node, uint32_t cell_num, const void* cell, uint32_t cell_size);
+void bytes_node_insert_cell(Pager* pager, void* node, uint32_t cell_num, const void* cell, uint32_t cell_size);
+uint32_t bytes_write_overflow_chain(Pager* pager, const void* value, uint32_t value_size);
+uint64_t bytes_free_overflow_chain(Pager* pager, uint32_t page_num, uint64_t commit_lsn);
+
+Pager* open_database_file(const char* filename);
+Pager* open_database_file_with_options(const char* filename, PagerOptions* options);
+void close_database_file(Pager* pager);
+PagerOptions default_pager_options();
+void* frame_arena_allocate(size_t size, HugePageMode mode, size_t* mapped_size);
+void frame_arena_interleave(void* start, size_t length);
+void buffer_pool_open(Pager* pager, PagerOptions* options);
+void mmap_open(Pager* pager, PagerOptions* options);
+void mmap_grow(Pager* pager, uint32_t num_pages);
+void mmap_close(Pager* pager);
+
+uint64_t frame_read_version(Frame* frame);
+int frame_validate_version(Frame* frame, uint64_t version);
+int frame_try_write_lock(Frame* frame);
+void frame_write_lock(Frame* frame);
+void frame_write_unlock(Frame* frame);
+int32_t page_table_lookup_optimistic(Pager* pager, uint32_t page_num, uint64_t* version);
+int32_t fix_page_optimistic(Pager* pager, uint32_t page_num, uint64_t* version);
+
+void begin_operation(Pager* pager);
+void latch_node(Pager* pager, void* node);
+void end_operation(Pager* pager);
+uint64_t release_operation(Pager* pager);
 
 void* get_page(Pager* pager, uint32_t page_num);
+void* get_page_locked(Pager* pager, uint32_t page_num);
+void* get_mapped_page_locked(Pager* pager, uint32_t page_num);
+void pager_prefetch(Pager* pager, const uint32_t* page_nums, uint32_t num_pages);
+void unpin_page(Pager* pager, uint32_t page_num);
+void mark_page_dirty(Pager* pager, uint32_t page_num);
+void* allocate_page(Pager* pager);
+void free_page(Pager* pager, void* node);
+int32_t get_frame_index(Pager* pager, void* node);
+uint32_t get_node_page_num(Pager* pager, void* node);
+void unpin_node(Pager* pager, void* node);
+void mark_node_dirty(Pager* pager, void* node);
+void* get_child_node(Pager* pager, void* node, uint32_t* child_pointer);
+uint32_t get_child_page_num(Pager* pager, uint32_t child_pointer);
+uint32_t is_swizzled(uint32_t child_pointer);
+void pager_flush(Pager* pager, uint32_t page_num, uint32_t size);
+void pager_flush_locked(Pager* pager, uint32_t page_num, uint32_t size);
+void pager_flush_frames(Pager* pager, uint8_t dirty_only);
+void checkpoint(Pager* pager);
+void pager_read_meta_page(Pager* pager);
+void pager_write_meta_page(Pager* pager);
+void checkpointer_start(Pager* pager);
+void checkpointer_stop(Pager* pager);
+uint32_t checkpointer_write_batch_locked(Pager* pager, uint32_t max_pages);
+
+IoRing* io_ring_open(Pager* pager, uint32_t num_entries);
+void io_ring_close(IoRing* ring);
+void pager_transfer_pages(Pager* pager, uint8_t is_write, const int32_t* frame_indices, const uint32_t* page_nums, uint32_t count);
+BufferPoolStats get_buffer_pool_stats(Pager* pager);
+void reset_buffer_pool_stats(Pager* pager);
+uint64_t stats_operation_start(Pager* pager);
+void stats_operation_finish(Pager* pager, OperationType type, uint64_t start_time);
+TreeStats* stats_shard(Pager* pager);
+void stats_shard_add(uint64_t* counter, uint64_t count);
+TreeStats get_tree_stats(Pager* pager);
+void reset_tree_stats(Pager* pager);
+uint64_t tree_stats_latency_percentile(const TreeStats* stats, OperationType type, double percentile);
 void set_root_page(Pager* pager, uint32_t root_page_num);
 uint32_t get_root_page(Pager* pager);
+void set_bytes_root_page(Pager* pager, uint32_t root_page_num);
+uint32_t get_bytes_root_page(Pager* pager);
+
+void wal_open(Pager* pager, const char* filename, PagerOptions* options);
+void wal_close(Pager* pager);
+void wal_begin_operation(Pager* pager);
+uint64_t wal_commit_operation(Pager* pager);
+void wal_wait_for_commit(Pager* pager, uint64_t commit_lsn);
+void wal_log_leaf_insert(Pager* pager, void* node, uint32_t key, uint32_t value);
+void wal_log_leaf_delete(Pager* pager, void* node, uint32_t key);
+void wal_log_leaf_update(Pager* pager, void* node, uint32_t key, uint32_t value);
+void wal_log_set_root(Pager* pager, uint32_t root_page_num);
+void wal_log_set_bytes_root(Pager* pager, uint32_t root_page_num);
+void wal_log_free_list_head(Pager* pager, uint32_t page_num);
+void wal_log_unlinked_overflow_page(Pager* pager, uint32_t page_num);
+void wal_flush(Wal* wal, uint64_t lsn);
+void wal_checkpoint(Pager* pager);
+uint64_t wal_log_size(Wal* wal);
+void wal_initialize_checksum_table();
+uint32_t wal_checksum(const void* data, uint32_t size, uint32_t crc);
+void pager_sync(Pager* pager);
+WalStats get_wal_stats(Pager* pager);
+
+OperationTrace* operation_trace_open(const char* filename);
+void operation_trace_close(OperationTrace* trace);
+void operation_trace_record(Pager* pager, TracedOperationType type, uint32_t key, uint32_t value);
+void operation_trace_record_multi_get(Pager* pager, const uint32_t* keys, uint32_t num_keys);
+void operation_trace_record_scan(Pager* pager, uint32_t key, uint32_t num_next, uint32_t num_prev);
+void operation_trace_record_bytes(Pager* pager, TracedOperationType type, const void* key, uint32_t key_size,
+    uint32_t count);
+OperationTraceReader* operation_trace_reader_open(const char* filename);
+int operation_trace_read(OperationTraceReader* reader, TracedOperation* operation);
+void operation_trace_reader_close(OperationTraceReader* reader);
 
 void initialize_leaf_node(void* node);
 void initialize_internal_node(void* node);
@@ -26,6 +637,11 @@ void initialize_internal_node(void* node);
         uint32_t: _insert_into_leaf, void*: _insert_into_internal)(pager, node, key, value)
 
 void _insert_into_leaf(Pager* pager, void* node, uint32_t key, uint32_t value);
-void _insert_into_internal(Pager* pager, void* node, uint32_t key, void* child_pointer);
+void _insert_key_value_pair_to_leaf_node(void* node, uint32_t key, uint32_t value);
+void _insert_into_internal(Pager* pager, void* node, uint32_t key, void* child_node);
+void _delete_key_from_leaf_node(void* node, uint32_t key_index);
+void _delete_key_from_internal_node(void* node, uint32_t key_index);
+void rebalance_leaf_node(Pager* pager, void* node);
+void rebalance_internal_node(Pager* pager, void* node);
 
-void print_node(void* node);
\ No newline at end of file
+void print_node(Pager* pager, void* node);
@@ -0,0 +1,675 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "b-tree-impl.h"
+
+/**
+ * Benchmark driver
+ * A run loads records keys into a fresh tree, brings the cache to the requested state and then runs operations
+ * operations drawn from a workload mix, the way the YCSB core workloads do. Every operation is timed, and the run
+ * is reported as one JSON object per line, so that runs can be collected and compared by scripts.
+ *
+ * Record r has the key r. Inserts during a run add the records after the loaded ones, in order.
+ */
+typedef enum {
+    BENCH_READ,
+    BENCH_UPDATE,
+    BENCH_INSERT,
+    BENCH_SCAN,
+    BENCH_READ_MODIFY_WRITE,
+    NUM_BENCH_OPERATIONS
+} BenchOperation;
+
+static const char* operation_names[NUM_BENCH_OPERATIONS] = {"read", "update", "insert", "scan", "read_modify_write"};
+
+typedef enum {
+    KEYS_UNIFORM,
+    KEYS_ZIPFIAN,
+    KEYS_SEQUENTIAL,
+    KEYS_LATEST
+} KeyDistribution;
+
+static const char* distribution_names[] = {"uniform", "zipfian", "sequential", "latest"};
+
+typedef enum {
+    LOAD_RANDOM,
+    LOAD_SEQUENTIAL,
+    LOAD_BULK
+} LoadMode;
+
+static const char* load_mode_names[] = {"random", "sequential", "bulk"};
+
+typedef struct {
+    const char* name;
+    double proportions[NUM_BENCH_OPERATIONS];
+    KeyDistribution distribution;
+} Workload;
+
+/**
+ * The YCSB core workloads, and one that only loads
+ */
+static const Workload workloads[] = {
+    {"A", {0.5, 0.5, 0, 0, 0}, KEYS_ZIPFIAN},
+    {"B", {0.95, 0.05, 0, 0, 0}, KEYS_ZIPFIAN},
+    {"C", {1, 0, 0, 0, 0}, KEYS_ZIPFIAN},
+    {"D", {0.95, 0, 0.05, 0, 0}, KEYS_LATEST},
+    {"E", {0, 0, 0.05, 0.95, 0}, KEYS_ZIPFIAN},
+    {"F", {0.5, 0, 0, 0, 0.5}, KEYS_ZIPFIAN},
+    {"load", {0, 0, 0, 0, 0}, KEYS_UNIFORM},
+};
+
+typedef struct {
+    Workload workload;
+    uint64_t num_records;
+    uint64_t num_operations;
+    uint32_t num_threads;
+    uint32_t max_scan_length;
+    double zipfian_constant;
+    LoadMode load_mode;
+    double fill_factor;
+    uint8_t cold_cache;
+    uint64_t seed;
+    const char* filename;
+    const char* output_filename;
+    const char* trace_filename;
+    uint8_t text_output;
+    uint8_t keep_file;
+    const char* wal_mode;
+    PagerOptions options;
+} BenchConfig;
+
+/**
+ * The Zipfian generator of Gray et al., "Quickly generating billion-record synthetic databases", as used by YCSB
+ * Rank 0 is the most popular item.
+ */
+typedef struct {
+    uint64_t num_items;
+    double theta;
+    double alpha;
+    double zetan;
+    double eta;
+} Zipfian;
+
+void zipfian_init(Zipfian* zipfian, uint64_t num_items, double theta) {
+    double zetan = 0;
+    for (uint64_t i = 1; i <= num_items; i++) {
+        zetan += 1 / pow((double)i, theta);
+    }
+    double zeta2 = 1 + 1 / pow(2, theta);
+    zipfian->num_items = num_items;
+    zipfian->theta = theta;
+    zipfian->alpha = 1 / (1 - theta);
+    zipfian->zetan = zetan;
+    zipfian->eta = (1 - pow(2.0 / num_items, 1 - theta)) / (1 - zeta2 / zetan);
+}
+
+uint64_t zipfian_next(const Zipfian* zipfian, double uniform) {
+    double uz = uniform * zipfian->zetan;
+    if (uz < 1) {
+        return 0;
+    }
+    if (uz < 1 + pow(0.5, zipfian->theta)) {
+        return 1;
+    }
+    uint64_t rank = (uint64_t)(zipfian->num_items * pow(zipfian->eta * uniform - zipfian->eta + 1, zipfian->alpha));
+    return rank < zipfian->num_items ? rank : zipfian->num_items - 1;
+}
+
+/**
+ * @brief This method spreads Zipfian ranks over the records, so that the popular records are not all neighbours
+ */
+uint64_t fnv_hash(uint64_t value) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (int i = 0; i < 8; i++) {
+        hash ^= value & 0xff;
+        hash *= 0x100000001b3ull;
+        value >>= 8;
+    }
+    return hash;
+}
+
+uint64_t random_next(uint64_t* state) {
+    //  splitmix64
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+double random_uniform(uint64_t* state) {
+    return (random_next(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+uint64_t now_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+static Zipfian zipfian;
+static uint64_t next_insert_record;
+
+typedef struct {
+    const BenchConfig* config;
+    Pager* pager;
+    uint32_t thread_id;
+    uint64_t num_operations;
+    uint64_t random_state;
+    uint64_t sequential_record;
+    uint32_t* latencies;
+    uint8_t* operations;
+    uint64_t not_found;
+} BenchThread;
+
+uint64_t choose_record(BenchThread* thread) {
+    uint64_t num_records = __atomic_load_n(&next_insert_record, __ATOMIC_RELAXED);
+    switch (thread->config->workload.distribution) {
+        case KEYS_ZIPFIAN:
+            return fnv_hash(zipfian_next(&zipfian, random_uniform(&thread->random_state))) % num_records;
+        case KEYS_LATEST: {
+            uint64_t offset = zipfian_next(&zipfian, random_uniform(&thread->random_state));
+            return offset < num_records ? num_records - 1 - offset : 0;
+        }
+        case KEYS_SEQUENTIAL:
+            return thread->sequential_record++ % num_records;
+        default:
+            return random_next(&thread->random_state) % num_records;
+    }
+}
+
+BenchOperation choose_operation(BenchThread* thread) {
+    double choice = random_uniform(&thread->random_state);
+    const double* proportions = thread->config->workload.proportions;
+    for (uint32_t i = 0; i < NUM_BENCH_OPERATIONS; i++) {
+        if (choice < proportions[i]) {
+            return i;
+        }
+        choice -= proportions[i];
+    }
+    return BENCH_READ;
+}
+
+void run_operation(BenchThread* thread, BenchOperation operation) {
+    Pager* pager = thread->pager;
+    uint32_t value;
+    if (operation == BENCH_INSERT) {
+        uint64_t record = __atomic_fetch_add(&next_insert_record, 1, __ATOMIC_RELAXED);
+        bt_upsert(pager, (uint32_t)record, (uint32_t)record);
+        return;
+    }
+    uint32_t key = (uint32_t)choose_record(thread);
+    switch (operation) {
+        case BENCH_READ:
+            thread->not_found += bt_get(pager, key, &value) != 1;
+            break;
+        case BENCH_UPDATE:
+            bt_upsert(pager, key, (uint32_t)random_next(&thread->random_state));
+            break;
+        case BENCH_SCAN: {
+            uint32_t length = 1 + random_next(&thread->random_state) % thread->config->max_scan_length;
+            Cursor* cursor = cursor_open(pager, key);
+            uint32_t found_key;
+            for (uint32_t i = 0; i < length && cursor_next(cursor, &found_key, &value); i++) {
+            }
+            cursor_close(cursor);
+            break;
+        }
+        case BENCH_READ_MODIFY_WRITE:
+            if (bt_get(pager, key, &value) == 1) {
+                bt_upsert(pager, key, value + 1);
+            } else {
+                thread->not_found++;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+void* bench_thread_main(void* argument) {
+    BenchThread* thread = argument;
+    for (uint64_t i = 0; i < thread->num_operations; i++) {
+        BenchOperation operation = choose_operation(thread);
+        uint64_t start = now_ns();
+        run_operation(thread, operation);
+        uint64_t latency = now_ns() - start;
+        thread->latencies[i] = latency < UINT32_MAX ? (uint32_t)latency : UINT32_MAX;
+        thread->operations[i] = operation;
+    }
+    return NULL;
+}
+
+typedef struct {
+    uint64_t next_key;
+    uint64_t num_records;
+} BulkLoadContext;
+
+int next_bulk_load_record(void* context, uint32_t* key, uint32_t* value) {
+    BulkLoadContext* load = context;
+    if (load->next_key >= load->num_records) {
+        return 0;
+    }
+    *key = (uint32_t)load->next_key;
+    *value = (uint32_t)load->next_key;
+    load->next_key++;
+    return 1;
+}
+
+/**
+ * @brief This method fills the tree with the records of the benchmark
+ *
+ * @param config
+ * @param pager
+ * @return double The time the load took, in seconds
+ */
+double load_records(const BenchConfig* config, Pager* pager) {
+    uint64_t start = now_ns();
+    if (config->load_mode == LOAD_BULK) {
+        BulkLoadContext context = {0, config->num_records};
+        BulkLoadIterator iterator = {next_bulk_load_record, &context};
+        bulk_load(pager, &iterator, config->fill_factor);
+    } else if (config->load_mode == LOAD_SEQUENTIAL) {
+        for (uint64_t record = 0; record < config->num_records; record++) {
+            bt_upsert(pager, (uint32_t)record, (uint32_t)record);
+        }
+    } else {
+        uint32_t* order = malloc(config->num_records * sizeof(uint32_t));
+        for (uint64_t i = 0; i < config->num_records; i++) {
+            order[i] = (uint32_t)i;
+        }
+        uint64_t random_state = config->seed;
+        for (uint64_t i = config->num_records; i > 1; i--) {
+            uint64_t j = random_next(&random_state) % i;
+            uint32_t swap = order[i - 1];
+            order[i - 1] = order[j];
+            order[j] = swap;
+        }
+        start = now_ns();
+        for (uint64_t i = 0; i < config->num_records; i++) {
+            bt_upsert(pager, order[i], order[i]);
+        }
+        free(order);
+    }
+    return (now_ns() - start) / 1e9;
+}
+
+/**
+ * @brief This method brings the cache to the state the run asks for
+ * A warm cache has read every node once since the load. A cold cache starts from a closed file whose pages have
+ * been dropped from the page cache of the operating system.
+ *
+ * @param config
+ * @param pager
+ * @return Pager* The pager to run with, which is a new one for a cold cache
+ */
+Pager* prepare_cache(BenchConfig* config, Pager* pager) {
+    if (!config->cold_cache) {
+        uint32_t key;
+        uint32_t value;
+        Cursor* cursor = cursor_open(pager, 0);
+        while (cursor_next(cursor, &key, &value)) {
+        }
+        cursor_close(cursor);
+        return pager;
+    }
+    //  The trace carries on across the reopen, instead of being started over
+    OperationTrace* trace = pager->operation_trace;
+    pager->operation_trace = NULL;
+    close_database_file(pager);
+    int fd = open(config->filename, O_RDONLY);
+    if (fd == -1 || fdatasync(fd) == -1 || posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) != 0) {
+        fprintf(stderr, "Unable to drop %s from the page cache\n", config->filename);
+        exit(EXIT_FAILURE);
+    }
+    close(fd);
+    pager = open_database_file_with_options(config->filename, &config->options);
+    pager->operation_trace = trace;
+    return pager;
+}
+
+int compare_latencies(const void* a, const void* b) {
+    uint32_t first = *(const uint32_t*)a;
+    uint32_t second = *(const uint32_t*)b;
+    return (first > second) - (first < second);
+}
+
+/**
+ * @brief This method returns a percentile of sorted latencies, by the nearest rank
+ */
+uint32_t latency_percentile(const uint32_t* sorted_latencies, uint64_t count, double percentile) {
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)ceil(percentile / 100 * count);
+    return sorted_latencies[rank == 0 ? 0 : rank - 1];
+}
+
+void print_latencies(FILE* output, const BenchConfig* config, const char* name, uint32_t* latencies, uint64_t count) {
+    qsort(latencies, count, sizeof(uint32_t), compare_latencies);
+    if (config->text_output) {
+        fprintf(output, "%-18s %10lu ops  p50 %8u ns  p99 %8u ns  p99.9 %8u ns  max %8u ns\n", name, count,
+            latency_percentile(latencies, count, 50), latency_percentile(latencies, count, 99),
+            latency_percentile(latencies, count, 99.9), count > 0 ? latencies[count - 1] : 0);
+        return;
+    }
+    fprintf(output, "\"%s\":{\"count\":%lu,\"p50_ns\":%u,\"p99_ns\":%u,\"p999_ns\":%u,\"max_ns\":%u}", name, count,
+        latency_percentile(latencies, count, 50), latency_percentile(latencies, count, 99),
+        latency_percentile(latencies, count, 99.9), count > 0 ? latencies[count - 1] : 0);
+}
+
+void print_report(const BenchConfig* config, double load_seconds, double run_seconds, BenchThread* threads,
+    const TreeStats* stats) {
+    FILE* output = stdout;
+    if (config->output_filename != NULL) {
+        output = fopen(config->output_filename, "a");
+        if (output == NULL) {
+            fprintf(stderr, "Unable to open %s\n", config->output_filename);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    //  Gather the latencies of all threads, overall and by operation
+    uint64_t total = 0;
+    uint64_t not_found = 0;
+    for (uint32_t t = 0; t < config->num_threads; t++) {
+        total += threads[t].num_operations;
+        not_found += threads[t].not_found;
+    }
+    uint32_t* all_latencies = malloc((total > 0 ? total : 1) * sizeof(uint32_t));
+    uint32_t* operation_latencies[NUM_BENCH_OPERATIONS];
+    uint64_t operation_counts[NUM_BENCH_OPERATIONS] = {0};
+    for (uint32_t i = 0; i < NUM_BENCH_OPERATIONS; i++) {
+        operation_latencies[i] = malloc((total > 0 ? total : 1) * sizeof(uint32_t));
+    }
+    uint64_t count = 0;
+    for (uint32_t t = 0; t < config->num_threads; t++) {
+        for (uint64_t i = 0; i < threads[t].num_operations; i++) {
+            uint8_t operation = threads[t].operations[i];
+            all_latencies[count++] = threads[t].latencies[i];
+            operation_latencies[operation][operation_counts[operation]++] = threads[t].latencies[i];
+        }
+    }
+
+    double load_rate = load_seconds > 0 ? config->num_records / load_seconds : 0;
+    double run_rate = run_seconds > 0 ? total / run_seconds : 0;
+    if (config->text_output) {
+        fprintf(output, "workload %s, %s keys, %lu records, %lu operations, %u threads, %s cache\n",
+            config->workload.name, distribution_names[config->workload.distribution], config->num_records, total,
+            config->num_threads, config->cold_cache ? "cold" : "warm");
+        fprintf(output, "load (%s): %.3f s, %.0f ops/s\n", load_mode_names[config->load_mode], load_seconds, load_rate);
+        if (total > 0) {
+            fprintf(output, "run: %.3f s, %.0f ops/s, %lu keys not found\n", run_seconds, run_rate, not_found);
+            print_latencies(output, config, "all", all_latencies, total);
+            for (uint32_t i = 0; i < NUM_BENCH_OPERATIONS; i++) {
+                if (operation_counts[i] > 0) {
+                    print_latencies(output, config, operation_names[i], operation_latencies[i], operation_counts[i]);
+                }
+            }
+        }
+        fprintf(output, "tree: %lu node visits, %lu key comparisons, %lu restarts, %lu leaf splits, "
+            "%lu page reads, %lu page writes, %lu buffer hits, %lu buffer misses, %lu hash index hits, "
+            "%lu hash index misses\n", stats->node_visits, stats->key_comparisons, stats->restarts,
+            stats->leaf_splits, stats->page_reads, stats->page_writes, stats->buffer_hits, stats->buffer_misses,
+            stats->hash_index_hits, stats->hash_index_misses);
+    } else {
+        fprintf(output, "{\"workload\":\"%s\",\"distribution\":\"%s\",\"records\":%lu,\"operations\":%lu,"
+            "\"threads\":%u,\"cache\":\"%s\",\"buffer_pool_size\":%u,\"memory_mapped\":%u,\"swizzle_pointers\":%u,"
+            "\"wal\":\"%s\",", config->workload.name, distribution_names[config->workload.distribution],
+            config->num_records, total, config->num_threads, config->cold_cache ? "cold" : "warm",
+            config->options.buffer_pool_size, config->options.memory_mapped, config->options.swizzle_pointers,
+            config->wal_mode);
+        fprintf(output, "\"load\":{\"mode\":\"%s\",\"seconds\":%.6f,\"ops_per_sec\":%.1f},",
+            load_mode_names[config->load_mode], load_seconds, load_rate);
+        fprintf(output, "\"run\":{\"seconds\":%.6f,\"ops_per_sec\":%.1f,\"not_found\":%lu,", run_seconds, run_rate,
+            not_found);
+        print_latencies(output, config, "latency", all_latencies, total);
+        fprintf(output, ",\"by_operation\":{");
+        int first = 1;
+        for (uint32_t i = 0; i < NUM_BENCH_OPERATIONS; i++) {
+            if (operation_counts[i] > 0) {
+                fprintf(output, first ? "" : ",");
+                print_latencies(output, config, operation_names[i], operation_latencies[i], operation_counts[i]);
+                first = 0;
+            }
+        }
+        fprintf(output, "}},\"tree\":{\"node_visits\":%lu,\"key_comparisons\":%lu,\"restarts\":%lu,"
+            "\"leaf_splits\":%lu,\"internal_splits\":%lu,\"leaf_merges\":%lu,\"page_reads\":%lu,\"page_writes\":%lu,"
+            "\"buffer_hits\":%lu,\"buffer_misses\":%lu,\"hash_index_hits\":%lu,\"hash_index_misses\":%lu}}\n",
+            stats->node_visits, stats->key_comparisons, stats->restarts, stats->leaf_splits, stats->internal_splits,
+            stats->leaf_merges, stats->page_reads, stats->page_writes, stats->buffer_hits, stats->buffer_misses,
+            stats->hash_index_hits, stats->hash_index_misses);
+    }
+
+    free(all_latencies);
+    for (uint32_t i = 0; i < NUM_BENCH_OPERATIONS; i++) {
+        free(operation_latencies[i]);
+    }
+    if (output != stdout) {
+        fclose(output);
+    }
+}
+
+void print_usage(const char* program) {
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  --workload=A|B|C|D|E|F|load   YCSB core workload, or only the load phase (A)\n"
+        "  --distribution=uniform|zipfian|sequential|latest   overrides the key distribution of the workload\n"
+        "  --read=P --update=P --insert=P --scan=P --rmw=P   overrides the operation mix, as fractions\n"
+        "  --records=N (1000000)  --operations=N (1000000)  --threads=N (1)\n"
+        "  --scan-length=N (100)  --zipfian-constant=X (0.99)  --seed=N (1)\n"
+        "  --load=random|sequential|bulk (random)  --fill-factor=X (1.0, for bulk loads)\n"
+        "  --cache=warm|cold (warm)\n"
+        "  --pool=N (65536 frames)  --mmap  --swizzle  --wal=off|async|sync (off)  --direct-io\n"
+        "  --huge-pages=transparent|explicit|none  --io=auto|pread|io_uring\n"
+        "  --hash-index=BYTES (0)   adaptive hash index over the hot keys, of at most BYTES\n"
+        "  --db=PATH (btree_bench.db)  --keep  --output=PATH (appends)  --format=json|text (json)\n"
+        "  --trace=PATH   records the load and the run as an operation trace, for btree_replay\n",
+        program);
+}
+
+const char* option_value(const char* argument, const char* name) {
+    size_t length = strlen(name);
+    if (strncmp(argument, name, length) == 0 && argument[length] == '=') {
+        return argument + length + 1;
+    }
+    return NULL;
+}
+
+int parse_name(const char* value, const char** names, int num_names, const char* option) {
+    for (int i = 0; i < num_names; i++) {
+        if (strcmp(value, names[i]) == 0) {
+            return i;
+        }
+    }
+    fprintf(stderr, "Unknown value %s for %s\n", value, option);
+    exit(EXIT_FAILURE);
+}
+
+void parse_arguments(int argc, char** argv, BenchConfig* config) {
+    config->workload = workloads[0];
+    config->num_records = 1000000;
+    config->num_operations = 1000000;
+    config->num_threads = 1;
+    config->max_scan_length = 100;
+    config->zipfian_constant = 0.99;
+    config->load_mode = LOAD_RANDOM;
+    config->fill_factor = 1.0;
+    config->cold_cache = 0;
+    config->seed = 1;
+    config->filename = "btree_bench.db";
+    config->output_filename = NULL;
+    config->text_output = 0;
+    config->keep_file = 0;
+    config->trace_filename = NULL;
+    config->wal_mode = "off";
+    config->options = default_pager_options();
+    config->options.buffer_pool_size = 65536;
+    config->options.wal_enabled = 0;
+
+    int distribution = -1;
+    int has_mix = 0;
+    double mix[NUM_BENCH_OPERATIONS] = {0};
+    static const char* mix_options[NUM_BENCH_OPERATIONS] = {"--read", "--update", "--insert", "--scan", "--rmw"};
+    static const char* workload_names[] = {"A", "B", "C", "D", "E", "F", "load"};
+    static const char* cache_names[] = {"warm", "cold"};
+    static const char* wal_names[] = {"off", "async", "sync"};
+    static const char* huge_page_names[] = {"transparent", "explicit", "none"};
+    static const char* io_names[] = {"auto", "pread", "io_uring"};
+    static const char* format_names[] = {"json", "text"};
+
+    for (int i = 1; i < argc; i++) {
+        const char* argument = argv[i];
+        const char* value;
+        int is_mix = 0;
+        for (uint32_t j = 0; j < NUM_BENCH_OPERATIONS; j++) {
+            if ((value = option_value(argument, mix_options[j])) != NULL) {
+                mix[j] = atof(value);
+                has_mix = is_mix = 1;
+            }
+        }
+        if (is_mix) {
+            continue;
+        }
+        if ((value = option_value(argument, "--workload")) != NULL) {
+            config->workload = workloads[parse_name(value, workload_names, 7, "--workload")];
+        } else if ((value = option_value(argument, "--distribution")) != NULL) {
+            distribution = parse_name(value, distribution_names, 4, "--distribution");
+        } else if ((value = option_value(argument, "--records")) != NULL) {
+            config->num_records = strtoull(value, NULL, 10);
+        } else if ((value = option_value(argument, "--operations")) != NULL) {
+            config->num_operations = strtoull(value, NULL, 10);
+        } else if ((value = option_value(argument, "--threads")) != NULL) {
+            config->num_threads = atoi(value);
+        } else if ((value = option_value(argument, "--scan-length")) != NULL) {
+            config->max_scan_length = atoi(value);
+        } else if ((value = option_value(argument, "--zipfian-constant")) != NULL) {
+            config->zipfian_constant = atof(value);
+        } else if ((value = option_value(argument, "--seed")) != NULL) {
+            config->seed = strtoull(value, NULL, 10);
+        } else if ((value = option_value(argument, "--load")) != NULL) {
+            config->load_mode = parse_name(value, load_mode_names, 3, "--load");
+        } else if ((value = option_value(argument, "--fill-factor")) != NULL) {
+            config->fill_factor = atof(value);
+        } else if ((value = option_value(argument, "--cache")) != NULL) {
+            config->cold_cache = parse_name(value, cache_names, 2, "--cache");
+        } else if ((value = option_value(argument, "--pool")) != NULL) {
+            config->options.buffer_pool_size = atoi(value);
+        } else if ((value = option_value(argument, "--hash-index")) != NULL) {
+            config->options.hash_index_size = strtoull(value, NULL, 10);
+        } else if (strcmp(argument, "--mmap") == 0) {
+            config->options.memory_mapped = 1;
+        } else if (strcmp(argument, "--swizzle") == 0) {
+            config->options.swizzle_pointers = 1;
+        } else if ((value = option_value(argument, "--wal")) != NULL) {
+            int wal = parse_name(value, wal_names, 3, "--wal");
+            config->wal_mode = wal_names[wal];
+            config->options.wal_enabled = wal != 0;
+            config->options.synchronous_commit = wal == 2;
+        } else if (strcmp(argument, "--direct-io") == 0) {
+            config->options.direct_io = 1;
+        } else if ((value = option_value(argument, "--huge-pages")) != NULL) {
+            config->options.huge_pages = parse_name(value, huge_page_names, 3, "--huge-pages");
+        } else if ((value = option_value(argument, "--io")) != NULL) {
+            config->options.io_backend = parse_name(value, io_names, 3, "--io");
+        } else if ((value = option_value(argument, "--db")) != NULL) {
+            config->filename = value;
+        } else if (strcmp(argument, "--keep") == 0) {
+            config->keep_file = 1;
+        } else if ((value = option_value(argument, "--output")) != NULL) {
+            config->output_filename = value;
+        } else if ((value = option_value(argument, "--format")) != NULL) {
+            config->text_output = parse_name(value, format_names, 2, "--format");
+        } else if ((value = option_value(argument, "--trace")) != NULL) {
+            config->trace_filename = value;
+        } else {
+            print_usage(argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (distribution != -1) {
+        config->workload.distribution = distribution;
+    }
+    if (has_mix) {
+        memcpy(config->workload.proportions, mix, sizeof(mix));
+        config->workload.name = "custom";
+    }
+    if (strcmp(config->workload.name, "load") == 0) {
+        config->num_operations = 0;
+    }
+    if (config->trace_filename != NULL && config->load_mode == LOAD_BULK) {
+        fprintf(stderr, "Bulk loads are not traced, so --trace needs a random or sequential load\n");
+        exit(EXIT_FAILURE);
+    }
+    if (config->num_records == 0 || config->num_records > UINT32_MAX || config->num_threads == 0 ||
+        config->max_scan_length == 0) {
+        fprintf(stderr, "The benchmark needs between 1 and %u records, at least one thread and a scan length\n",
+            UINT32_MAX);
+        exit(EXIT_FAILURE);
+    }
+}
+
+int main(int argc, char** argv) {
+    BenchConfig config;
+    parse_arguments(argc, argv, &config);
+
+    char log_filename[4096];
+    snprintf(log_filename, sizeof(log_filename), "%s-wal", config.filename);
+    unlink(config.filename);
+    unlink(log_filename);
+    Pager* pager = open_database_file_with_options(config.filename, &config.options);
+    if (config.trace_filename != NULL) {
+        pager->operation_trace = operation_trace_open(config.trace_filename);
+    }
+    double load_seconds = load_records(&config, pager);
+    next_insert_record = config.num_records;
+    if (config.workload.distribution == KEYS_ZIPFIAN || config.workload.distribution == KEYS_LATEST) {
+        zipfian_init(&zipfian, config.num_records, config.zipfian_constant);
+    }
+    pager = prepare_cache(&config, pager);
+    reset_tree_stats(pager);
+
+    BenchThread* threads = malloc(config.num_threads * sizeof(BenchThread));
+    pthread_t* thread_ids = malloc(config.num_threads * sizeof(pthread_t));
+    for (uint32_t t = 0; t < config.num_threads; t++) {
+        BenchThread* thread = &threads[t];
+        thread->config = &config;
+        thread->pager = pager;
+        thread->thread_id = t;
+        thread->num_operations = config.num_operations / config.num_threads +
+            (t < config.num_operations % config.num_threads);
+        thread->random_state = config.seed * 1000003 + t;
+        thread->sequential_record = config.num_records / config.num_threads * t;
+        thread->latencies = malloc((thread->num_operations > 0 ? thread->num_operations : 1) * sizeof(uint32_t));
+        thread->operations = malloc(thread->num_operations > 0 ? thread->num_operations : 1);
+        thread->not_found = 0;
+    }
+    uint64_t start = now_ns();
+    for (uint32_t t = 0; t < config.num_threads; t++) {
+        pthread_create(&thread_ids[t], NULL, bench_thread_main, &threads[t]);
+    }
+    for (uint32_t t = 0; t < config.num_threads; t++) {
+        pthread_join(thread_ids[t], NULL);
+    }
+    double run_seconds = (now_ns() - start) / 1e9;
+
+    TreeStats stats = get_tree_stats(pager);
+    print_report(&config, load_seconds, run_seconds, threads, &stats);
+    close_database_file(pager);
+    if (!config.keep_file) {
+        unlink(config.filename);
+        unlink(log_filename);
+    }
+    for (uint32_t t = 0; t < config.num_threads; t++) {
+        free(threads[t].latencies);
+        free(threads[t].operations);
+    }
+    free(threads);
+    free(thread_ids);
+    return 0;
+}
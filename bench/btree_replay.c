@@ -0,0 +1,482 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "b-tree-impl.h"
+
+/**
+ * Trace replay
+ * A replay re-executes an operation trace, captured by a pager opened with an operation_trace_filename, against a
+ * fresh database file or a copy of a snapshot of one. The whole trace is decoded before the replay starts, so that
+ * reading it is not timed. Operations run one after the other, either back to back or each at the time it was
+ * recorded, and the replay is reported the way btree_bench reports a run. A trace only has the sizes of the values
+ * put into the byte tree, so the replay puts values of those sizes filled with a pattern.
+ */
+static const char* operation_names[] = {"", "get", "insert", "upsert", "insert_if_absent", "delete", "multi_get",
+    "scan", "get_bytes", "put_bytes", "delete_bytes", "scan_bytes"};
+#define NUM_OPERATION_NAMES (sizeof(operation_names) / sizeof(operation_names[0]))
+
+typedef struct {
+    const char* trace_filename;
+    const char* filename;
+    const char* snapshot_filename;
+    const char* output_filename;
+    const char* wal_mode;
+    int recorded_timing;
+    int text_output;
+    int keep_file;
+    PagerOptions options;
+} ReplayConfig;
+
+typedef struct {
+    TracedOperation* operations;
+    uint64_t num_operations;
+    uint32_t* keys;
+    uint64_t num_keys;
+    uint8_t* key_bytes;
+    uint64_t key_bytes_size;
+} Trace;
+
+/**
+ * Where a replayed operation puts its results, and where the values of byte tree puts come from
+ */
+typedef struct {
+    uint32_t* values;
+    uint8_t* found;
+    uint8_t* value_bytes;
+    uint32_t value_capacity;
+} ReplayBuffers;
+
+uint64_t now_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+/**
+ * @brief This method decodes a whole trace. The keys of batch lookups are gathered in one array, and the keys of
+ * each batch point into it once the trace is read, since the array moves while it grows. The keys of byte tree
+ * operations are gathered the same way.
+ */
+Trace load_trace(const char* filename) {
+    Trace trace = {0};
+    uint64_t operations_capacity = 1024;
+    uint64_t keys_capacity = 1024;
+    uint64_t key_bytes_capacity = 1024;
+    trace.operations = malloc(operations_capacity * sizeof(TracedOperation));
+    trace.keys = malloc(keys_capacity * sizeof(uint32_t));
+    trace.key_bytes = malloc(key_bytes_capacity);
+    OperationTraceReader* reader = operation_trace_reader_open(filename);
+    TracedOperation operation;
+    while (operation_trace_read(reader, &operation)) {
+        if (trace.num_operations == operations_capacity) {
+            operations_capacity *= 2;
+            trace.operations = realloc(trace.operations, operations_capacity * sizeof(TracedOperation));
+        }
+        if (operation.type == TRACED_MULTI_GET) {
+            while (trace.num_keys + operation.num_keys > keys_capacity) {
+                keys_capacity *= 2;
+                trace.keys = realloc(trace.keys, keys_capacity * sizeof(uint32_t));
+            }
+            memcpy(trace.keys + trace.num_keys, operation.keys, operation.num_keys * sizeof(uint32_t));
+            //  Remember the offset of the keys until the array stops moving
+            operation.keys = (const uint32_t*)(uintptr_t)trace.num_keys;
+            trace.num_keys += operation.num_keys;
+        }
+        if (operation.key_bytes != NULL) {
+            while (trace.key_bytes_size + operation.key_size > key_bytes_capacity) {
+                key_bytes_capacity *= 2;
+                trace.key_bytes = realloc(trace.key_bytes, key_bytes_capacity);
+            }
+            memcpy(trace.key_bytes + trace.key_bytes_size, operation.key_bytes, operation.key_size);
+            operation.key_bytes = (const uint8_t*)(uintptr_t)trace.key_bytes_size;
+            trace.key_bytes_size += operation.key_size;
+        }
+        trace.operations[trace.num_operations++] = operation;
+    }
+    operation_trace_reader_close(reader);
+    for (uint64_t i = 0; i < trace.num_operations; i++) {
+        if (trace.operations[i].type == TRACED_MULTI_GET) {
+            trace.operations[i].keys = trace.keys + (uintptr_t)trace.operations[i].keys;
+        }
+        if (trace.operations[i].type >= TRACED_GET_BYTES) {
+            trace.operations[i].key_bytes = trace.key_bytes + (uintptr_t)trace.operations[i].key_bytes;
+        }
+    }
+    return trace;
+}
+
+void copy_file(const char* source, const char* destination) {
+    int source_fd = open(source, O_RDONLY);
+    int destination_fd = open(destination, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+    if (source_fd == -1 || destination_fd == -1) {
+        fprintf(stderr, "Unable to copy %s to %s\n", source, destination);
+        exit(EXIT_FAILURE);
+    }
+    char buffer[1 << 16];
+    ssize_t bytes;
+    while ((bytes = read(source_fd, buffer, sizeof(buffer))) > 0) {
+        if (write(destination_fd, buffer, bytes) != bytes) {
+            fprintf(stderr, "Unable to copy %s to %s\n", source, destination);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (bytes == -1 || fsync(destination_fd) == -1) {
+        fprintf(stderr, "Unable to copy %s to %s\n", source, destination);
+        exit(EXIT_FAILURE);
+    }
+    close(source_fd);
+    close(destination_fd);
+}
+
+/**
+ * @brief This method waits until the time an operation was recorded at, relative to the start of the replay.
+ * Long waits sleep, and the last stretch spins, since sleeps overshoot by tens of microseconds
+ */
+void wait_until(uint64_t deadline) {
+    const uint64_t spin_ns = 100000;
+    uint64_t now = now_ns();
+    if (deadline > now + spin_ns) {
+        uint64_t sleep_ns = deadline - now - spin_ns;
+        struct timespec duration = {sleep_ns / 1000000000ull, sleep_ns % 1000000000ull};
+        nanosleep(&duration, NULL);
+    }
+    while (now_ns() < deadline) {
+    }
+}
+
+/**
+ * @brief This method executes one traced operation
+ *
+ * @return int 0 if the operation missed its key, or found none of its keys
+ */
+int replay_operation(Pager* pager, const TracedOperation* operation, ReplayBuffers* buffers) {
+    uint32_t key;
+    uint32_t value;
+    const void* key_bytes;
+    uint32_t key_size;
+    uint32_t value_size;
+    switch (operation->type) {
+        case TRACED_GET:
+            return bt_get(pager, operation->key, &value) != -1;
+        case TRACED_INSERT:
+            insert(pager, operation->key, operation->value);
+            return 1;
+        case TRACED_UPSERT:
+            bt_upsert(pager, operation->key, operation->value);
+            return 1;
+        case TRACED_INSERT_IF_ABSENT:
+            return bt_insert_if_absent(pager, operation->key, operation->value) == 1;
+        case TRACED_DELETE:
+            return bt_delete(pager, operation->key) == 1;
+        case TRACED_MULTI_GET:
+            return bt_multi_get(pager, operation->keys, operation->num_keys, buffers->values, buffers->found) > 0;
+        case TRACED_SCAN: {
+            Cursor* cursor = cursor_open(pager, operation->key);
+            uint32_t num_read = 0;
+            for (uint32_t i = 0; i < operation->num_next && cursor_next(cursor, &key, &value); i++) {
+                num_read++;
+            }
+            for (uint32_t i = 0; i < operation->num_prev && cursor_prev(cursor, &key, &value); i++) {
+                num_read++;
+            }
+            cursor_close(cursor);
+            return num_read == operation->num_next + operation->num_prev;
+        }
+        case TRACED_GET_BYTES:
+            return bt_get_bytes(pager, operation->key_bytes, operation->key_size, buffers->value_bytes,
+                buffers->value_capacity, &value_size) == 1;
+        case TRACED_PUT_BYTES:
+            bt_put_bytes(pager, operation->key_bytes, operation->key_size, buffers->value_bytes,
+                operation->value_size);
+            return 1;
+        case TRACED_DELETE_BYTES:
+            return bt_delete_bytes(pager, operation->key_bytes, operation->key_size) == 1;
+        case TRACED_SCAN_BYTES: {
+            BytesCursor* cursor = bytes_cursor_open(pager, operation->key_bytes, operation->key_size);
+            uint32_t num_read = 0;
+            while (num_read < operation->num_next && bytes_cursor_next(cursor, &key_bytes, &key_size,
+                buffers->value_bytes, buffers->value_capacity, &value_size)) {
+                num_read++;
+            }
+            bytes_cursor_close(cursor);
+            return num_read == operation->num_next;
+        }
+    }
+    return 0;
+}
+
+int compare_latencies(const void* a, const void* b) {
+    uint32_t first = *(const uint32_t*)a;
+    uint32_t second = *(const uint32_t*)b;
+    return (first > second) - (first < second);
+}
+
+/**
+ * @brief This method returns a percentile of sorted latencies, by the nearest rank
+ */
+uint32_t latency_percentile(const uint32_t* sorted_latencies, uint64_t count, double percentile) {
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)ceil(percentile / 100 * count);
+    return sorted_latencies[rank == 0 ? 0 : rank - 1];
+}
+
+void print_latencies(FILE* output, const ReplayConfig* config, const char* name, uint32_t* latencies,
+    uint64_t count) {
+    qsort(latencies, count, sizeof(uint32_t), compare_latencies);
+    if (config->text_output) {
+        fprintf(output, "%-18s %10lu ops  p50 %8u ns  p99 %8u ns  p99.9 %8u ns  max %8u ns\n", name, count,
+            latency_percentile(latencies, count, 50), latency_percentile(latencies, count, 99),
+            latency_percentile(latencies, count, 99.9), count > 0 ? latencies[count - 1] : 0);
+        return;
+    }
+    fprintf(output, "\"%s\":{\"count\":%lu,\"p50_ns\":%u,\"p99_ns\":%u,\"p999_ns\":%u,\"max_ns\":%u}", name, count,
+        latency_percentile(latencies, count, 50), latency_percentile(latencies, count, 99),
+        latency_percentile(latencies, count, 99.9), count > 0 ? latencies[count - 1] : 0);
+}
+
+void print_report(const ReplayConfig* config, const Trace* trace, const uint32_t* latencies, double run_seconds,
+    uint64_t missed, uint64_t max_lag_ns, const TreeStats* stats) {
+    FILE* output = stdout;
+    if (config->output_filename != NULL) {
+        output = fopen(config->output_filename, "a");
+        if (output == NULL) {
+            fprintf(stderr, "Unable to open %s\n", config->output_filename);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    uint64_t total = trace->num_operations;
+    uint32_t* all_latencies = malloc((total > 0 ? total : 1) * sizeof(uint32_t));
+    uint32_t* operation_latencies[NUM_OPERATION_NAMES];
+    uint64_t operation_counts[NUM_OPERATION_NAMES] = {0};
+    for (uint32_t i = 0; i < NUM_OPERATION_NAMES; i++) {
+        operation_latencies[i] = malloc((total > 0 ? total : 1) * sizeof(uint32_t));
+    }
+    for (uint64_t i = 0; i < total; i++) {
+        uint8_t type = trace->operations[i].type;
+        all_latencies[i] = latencies[i];
+        operation_latencies[type][operation_counts[type]++] = latencies[i];
+    }
+
+    double run_rate = run_seconds > 0 ? total / run_seconds : 0;
+    const char* timing = config->recorded_timing ? "recorded" : "full";
+    const char* start = config->snapshot_filename != NULL ? config->snapshot_filename : "fresh";
+    if (config->text_output) {
+        fprintf(output, "replay of %s, %lu operations from %s, %s timing\n", config->trace_filename, total, start,
+            timing);
+        fprintf(output, "run: %.3f s, %.0f ops/s, %lu operations missed their keys", run_seconds, run_rate, missed);
+        if (config->recorded_timing) {
+            fprintf(output, ", fell up to %lu ns behind the trace", max_lag_ns);
+        }
+        fprintf(output, "\n");
+        if (total > 0) {
+            print_latencies(output, config, "all", all_latencies, total);
+            for (uint32_t i = 1; i < NUM_OPERATION_NAMES; i++) {
+                if (operation_counts[i] > 0) {
+                    print_latencies(output, config, operation_names[i], operation_latencies[i], operation_counts[i]);
+                }
+            }
+        }
+        fprintf(output, "tree: %lu node visits, %lu key comparisons, %lu restarts, %lu leaf splits, "
+            "%lu page reads, %lu page writes, %lu buffer hits, %lu buffer misses\n", stats->node_visits,
+            stats->key_comparisons, stats->restarts, stats->leaf_splits, stats->page_reads, stats->page_writes,
+            stats->buffer_hits, stats->buffer_misses);
+    } else {
+        fprintf(output, "{\"trace\":\"%s\",\"start\":\"%s\",\"timing\":\"%s\",\"operations\":%lu,"
+            "\"buffer_pool_size\":%u,\"memory_mapped\":%u,\"swizzle_pointers\":%u,\"wal\":\"%s\",",
+            config->trace_filename, start, timing, total, config->options.buffer_pool_size,
+            config->options.memory_mapped, config->options.swizzle_pointers, config->wal_mode);
+        fprintf(output, "\"run\":{\"seconds\":%.6f,\"ops_per_sec\":%.1f,\"missed\":%lu,\"max_lag_ns\":%lu,",
+            run_seconds, run_rate, missed, max_lag_ns);
+        print_latencies(output, config, "latency", all_latencies, total);
+        fprintf(output, ",\"by_operation\":{");
+        int first = 1;
+        for (uint32_t i = 1; i < NUM_OPERATION_NAMES; i++) {
+            if (operation_counts[i] > 0) {
+                fprintf(output, first ? "" : ",");
+                print_latencies(output, config, operation_names[i], operation_latencies[i], operation_counts[i]);
+                first = 0;
+            }
+        }
+        fprintf(output, "}},\"tree\":{\"node_visits\":%lu,\"key_comparisons\":%lu,\"restarts\":%lu,"
+            "\"leaf_splits\":%lu,\"internal_splits\":%lu,\"leaf_merges\":%lu,\"page_reads\":%lu,\"page_writes\":%lu,"
+            "\"buffer_hits\":%lu,\"buffer_misses\":%lu}}\n", stats->node_visits, stats->key_comparisons,
+            stats->restarts, stats->leaf_splits, stats->internal_splits, stats->leaf_merges, stats->page_reads,
+            stats->page_writes, stats->buffer_hits, stats->buffer_misses);
+    }
+
+    free(all_latencies);
+    for (uint32_t i = 0; i < NUM_OPERATION_NAMES; i++) {
+        free(operation_latencies[i]);
+    }
+    if (output != stdout) {
+        fclose(output);
+    }
+}
+
+void print_usage(const char* program) {
+    fprintf(stderr,
+        "Usage: %s TRACE [options]\n"
+        "  --snapshot=PATH   replays against a copy of this database file instead of a fresh one\n"
+        "  --timing=full|recorded (full)   back to back, or each operation at the time it was recorded\n"
+        "  --pool=N (65536 frames)  --mmap  --swizzle  --wal=off|async|sync (off)  --direct-io\n"
+        "  --db=PATH (btree_replay.db)  --keep  --output=PATH (appends)  --format=json|text (json)\n",
+        program);
+}
+
+const char* option_value(const char* argument, const char* name) {
+    size_t length = strlen(name);
+    if (strncmp(argument, name, length) == 0 && argument[length] == '=') {
+        return argument + length + 1;
+    }
+    return NULL;
+}
+
+int parse_name(const char* value, const char** names, int num_names, const char* option) {
+    for (int i = 0; i < num_names; i++) {
+        if (strcmp(value, names[i]) == 0) {
+            return i;
+        }
+    }
+    fprintf(stderr, "Unknown value %s for %s\n", value, option);
+    exit(EXIT_FAILURE);
+}
+
+void parse_arguments(int argc, char** argv, ReplayConfig* config) {
+    config->trace_filename = NULL;
+    config->filename = "btree_replay.db";
+    config->snapshot_filename = NULL;
+    config->output_filename = NULL;
+    config->wal_mode = "off";
+    config->recorded_timing = 0;
+    config->text_output = 0;
+    config->keep_file = 0;
+    config->options = default_pager_options();
+    config->options.buffer_pool_size = 65536;
+    config->options.wal_enabled = 0;
+
+    static const char* timing_names[] = {"full", "recorded"};
+    static const char* wal_names[] = {"off", "async", "sync"};
+    static const char* format_names[] = {"json", "text"};
+    for (int i = 1; i < argc; i++) {
+        const char* argument = argv[i];
+        const char* value;
+        if ((value = option_value(argument, "--snapshot")) != NULL) {
+            config->snapshot_filename = value;
+        } else if ((value = option_value(argument, "--timing")) != NULL) {
+            config->recorded_timing = parse_name(value, timing_names, 2, "--timing");
+        } else if ((value = option_value(argument, "--pool")) != NULL) {
+            config->options.buffer_pool_size = atoi(value);
+        } else if (strcmp(argument, "--mmap") == 0) {
+            config->options.memory_mapped = 1;
+        } else if (strcmp(argument, "--swizzle") == 0) {
+            config->options.swizzle_pointers = 1;
+        } else if ((value = option_value(argument, "--wal")) != NULL) {
+            int wal = parse_name(value, wal_names, 3, "--wal");
+            config->wal_mode = wal_names[wal];
+            config->options.wal_enabled = wal != 0;
+            config->options.synchronous_commit = wal == 2;
+        } else if (strcmp(argument, "--direct-io") == 0) {
+            config->options.direct_io = 1;
+        } else if ((value = option_value(argument, "--db")) != NULL) {
+            config->filename = value;
+        } else if (strcmp(argument, "--keep") == 0) {
+            config->keep_file = 1;
+        } else if ((value = option_value(argument, "--output")) != NULL) {
+            config->output_filename = value;
+        } else if ((value = option_value(argument, "--format")) != NULL) {
+            config->text_output = parse_name(value, format_names, 2, "--format");
+        } else if (argument[0] != '-' && config->trace_filename == NULL) {
+            config->trace_filename = argument;
+        } else {
+            print_usage(argv[0]);
+            exit(strcmp(argument, "--help") == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+        }
+    }
+    if (config->trace_filename == NULL) {
+        print_usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+}
+
+int main(int argc, char** argv) {
+    ReplayConfig config;
+    parse_arguments(argc, argv, &config);
+    Trace trace = load_trace(config.trace_filename);
+
+    char log_filename[4096];
+    snprintf(log_filename, sizeof(log_filename), "%s-wal", config.filename);
+    unlink(config.filename);
+    unlink(log_filename);
+    if (config.snapshot_filename != NULL) {
+        //  A snapshot that was not checkpointed has part of its pages in its log
+        char snapshot_log_filename[4096];
+        snprintf(snapshot_log_filename, sizeof(snapshot_log_filename), "%s-wal", config.snapshot_filename);
+        copy_file(config.snapshot_filename, config.filename);
+        if (access(snapshot_log_filename, F_OK) == 0) {
+            copy_file(snapshot_log_filename, log_filename);
+        }
+    }
+    Pager* pager = open_database_file_with_options(config.filename, &config.options);
+    reset_tree_stats(pager);
+
+    uint32_t* latencies = malloc((trace.num_operations > 0 ? trace.num_operations : 1) * sizeof(uint32_t));
+    //  Gets copy at most as much of a value as the largest put, or 64 KB of values the trace did not put
+    uint32_t max_keys = 1;
+    ReplayBuffers buffers = {0};
+    buffers.value_capacity = 1 << 16;
+    for (uint64_t i = 0; i < trace.num_operations; i++) {
+        if (trace.operations[i].num_keys > max_keys) {
+            max_keys = trace.operations[i].num_keys;
+        }
+        if (trace.operations[i].value_size > buffers.value_capacity) {
+            buffers.value_capacity = trace.operations[i].value_size;
+        }
+    }
+    buffers.values = malloc(max_keys * sizeof(uint32_t));
+    buffers.found = malloc(max_keys);
+    buffers.value_bytes = malloc(buffers.value_capacity);
+    for (uint32_t i = 0; i < buffers.value_capacity; i++) {
+        buffers.value_bytes[i] = i * 31;
+    }
+    uint64_t missed = 0;
+    uint64_t max_lag_ns = 0;
+    uint64_t start = now_ns();
+    for (uint64_t i = 0; i < trace.num_operations; i++) {
+        const TracedOperation* operation = &trace.operations[i];
+        if (config.recorded_timing) {
+            wait_until(start + operation->time);
+        }
+        uint64_t operation_start = now_ns();
+        if (config.recorded_timing && operation_start - start > operation->time + max_lag_ns) {
+            max_lag_ns = operation_start - start - operation->time;
+        }
+        missed += !replay_operation(pager, operation, &buffers);
+        uint64_t latency = now_ns() - operation_start;
+        latencies[i] = latency > UINT32_MAX ? UINT32_MAX : latency;
+    }
+    double run_seconds = (now_ns() - start) / 1e9;
+
+    TreeStats stats = get_tree_stats(pager);
+    print_report(&config, &trace, latencies, run_seconds, missed, max_lag_ns, &stats);
+    close_database_file(pager);
+    if (!config.keep_file) {
+        unlink(config.filename);
+        unlink(log_filename);
+    }
+    free(latencies);
+    free(buffers.values);
+    free(buffers.found);
+    free(buffers.value_bytes);
+    free(trace.operations);
+    free(trace.keys);
+    free(trace.key_bytes);
+    return 0;
+}
@@ -0,0 +1,1153 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+#include "b-tree-impl.h"
+
+/**
+ * Tests of the tree through its public interface
+ * Every test runs against the pager configuration named on the command line, see configure_pager(). The tests
+ * stop at the first failed check and print where it failed.
+ */
+#define CHECK(condition, ...) \
+    do { \
+        if (!(condition)) { \
+            fprintf(stderr, "%s:%d: check failed: ", __FILE__, __LINE__); \
+            fprintf(stderr, __VA_ARGS__); \
+            fprintf(stderr, "\n"); \
+            exit(EXIT_FAILURE); \
+        } \
+    } while (0)
+
+#define NUM_RECOVERY_ACKS 2000
+
+//  The layout constants are defined in b-tree-impl.c
+extern const uint32_t LEAF_NODE_MAX_CELLS;
+extern const uint32_t INTERNAL_NODE_MAX_KEYS;
+
+static PagerOptions options;
+static char database_filename[256];
+
+void configure_pager(const char* config) {
+    options = default_pager_options();
+    options.synchronous_commit = 0;
+    if (strcmp(config, "pool") == 0) {
+        options.buffer_pool_size = 16;
+    } else if (strcmp(config, "swizzle") == 0) {
+        options.buffer_pool_size = 16;
+        options.swizzle_pointers = 1;
+    } else if (strcmp(config, "mmap") == 0) {
+        options.memory_mapped = 1;
+        options.mmap_reserve_size = 1ull << 30;
+    } else if (strcmp(config, "no-wal") == 0) {
+        options.buffer_pool_size = 64;
+        options.wal_enabled = 0;
+    } else {
+        fprintf(stderr, "Unknown configuration %s\n", config);
+        exit(EXIT_FAILURE);
+    }
+    snprintf(database_filename, sizeof(database_filename), "btree_test_%s.db", config);
+}
+
+Pager* open_fresh_database() {
+    char log_filename[300];
+    snprintf(log_filename, sizeof(log_filename), "%s-wal", database_filename);
+    unlink(database_filename);
+    unlink(log_filename);
+    return open_database_file_with_options(database_filename, &options);
+}
+
+void check_no_pinned_frames(Pager* pager) {
+    if (pager->mmap_base != NULL) {
+        return;
+    }
+    for (uint32_t i = 0; i < pager->num_frames; i++) {
+        CHECK(pager->frames[i].pin_count == 0, "frame %u is still pinned", i);
+    }
+}
+
+/**
+ * @brief This method checks that a full scan returns exactly the keys of the model, in order, both ways
+ *
+ * @param pager
+ * @param model The value of every key, or -1 for a key that is not in the tree
+ * @param num_keys
+ */
+void check_scan_matches_model(Pager* pager, const int64_t* model, uint32_t num_keys) {
+    uint32_t expected_key = 0;
+    uint32_t key;
+    uint32_t value;
+    Cursor* cursor = cursor_open(pager, 0);
+    while (cursor_next(cursor, &key, &value)) {
+        while (expected_key < num_keys && model[expected_key] == -1) {
+            expected_key++;
+        }
+        CHECK(key == expected_key, "scan returned %u, expected %u", key, expected_key);
+        CHECK(value == model[key], "scan returned value %u for key %u, expected %ld", value, key, (long)model[key]);
+        expected_key++;
+    }
+    while (expected_key < num_keys && model[expected_key] == -1) {
+        expected_key++;
+    }
+    CHECK(expected_key == num_keys, "scan ended before key %u", expected_key);
+
+    int64_t previous_key = num_keys;
+    while (cursor_prev(cursor, &key, &value)) {
+        CHECK(key < previous_key && model[key] != -1, "backward scan returned %u after %ld", key, (long)previous_key);
+        for (int64_t k = key + 1; k < previous_key; k++) {
+            CHECK(model[k] == -1, "backward scan skipped %ld", (long)k);
+        }
+        previous_key = key;
+    }
+    cursor_close(cursor);
+}
+
+/**
+ * @brief This method runs random gets, upserts, conditional inserts and deletes against a model of the tree,
+ * first growing the tree and then shrinking it, and checks the tree again after reopening the file
+ */
+void test_operations_match_model() {
+    const uint32_t num_keys = 20000;
+    const uint32_t num_operations = 300000;
+    Pager* pager = open_fresh_database();
+    int64_t* model = malloc(num_keys * sizeof(int64_t));
+    for (uint32_t i = 0; i < num_keys; i++) {
+        model[i] = -1;
+    }
+
+    srand(7);
+    for (uint32_t op = 0; op < num_operations; op++) {
+        uint32_t key = rand() % num_keys;
+        uint32_t value = rand();
+        uint32_t choice = rand() % 10;
+        uint32_t found_value;
+        int shrinking = op > num_operations / 2;
+        int result;
+        int expected;
+        if (choice < 3) {
+            result = bt_upsert(pager, key, value);
+            expected = model[key] == -1 ? 1 : 0;
+            model[key] = value;
+        } else if (choice < 5) {
+            result = bt_insert_if_absent(pager, key, value);
+            expected = model[key] == -1 ? 1 : -1;
+            if (expected == 1) {
+                model[key] = value;
+            }
+        } else if (choice < (shrinking ? 9u : 6u)) {
+            result = bt_delete(pager, key);
+            expected = model[key] == -1 ? -1 : 1;
+            model[key] = -1;
+        } else {
+            result = bt_get(pager, key, &found_value);
+            expected = model[key] == -1 ? -1 : 1;
+            CHECK(result != 1 || found_value == model[key], "get %u returned %u, expected %ld", key, found_value,
+                (long)model[key]);
+        }
+        CHECK(result == expected, "operation %u on key %u returned %d, expected %d", op, key, result, expected);
+    }
+    check_no_pinned_frames(pager);
+    check_scan_matches_model(pager, model, num_keys);
+    close_database_file(pager);
+
+    pager = open_database_file_with_options(database_filename, &options);
+    for (uint32_t key = 0; key < num_keys; key++) {
+        uint32_t value;
+        int result = bt_get(pager, key, &value);
+        CHECK(result == (model[key] == -1 ? -1 : 1), "key %u after reopening", key);
+        CHECK(result != 1 || value == model[key], "value of key %u after reopening", key);
+    }
+    check_scan_matches_model(pager, model, num_keys);
+    close_database_file(pager);
+    free(model);
+    printf("ok operations match model\n");
+}
+
+/**
+ * @brief This method checks that every key can be deleted again, and that the pages of the tree are reused
+ */
+void test_delete_everything() {
+    const uint32_t num_keys = 30000;
+    Pager* pager = open_fresh_database();
+    uint32_t num_pages = 0;
+    for (uint32_t round = 0; round < 3; round++) {
+        for (uint32_t i = 0; i < num_keys; i++) {
+            bt_upsert(pager, (i * 7919) % num_keys, i);
+        }
+        //  Later rounds build the same tree again out of the pages the first one freed
+        if (round == 0) {
+            num_pages = pager->num_pages;
+        }
+        CHECK(pager->num_pages == num_pages, "the file grew from %u to %u pages in round %u instead of reusing them",
+            num_pages, pager->num_pages, round);
+        for (uint32_t i = 0; i < num_keys; i++) {
+            CHECK(bt_delete(pager, (i * 104729) % num_keys) == 1, "delete %u in round %u", (i * 104729) % num_keys, round);
+        }
+        Cursor* cursor = cursor_open(pager, 0);
+        uint32_t key;
+        uint32_t value;
+        CHECK(!cursor_next(cursor, &key, &value), "key %u is left after deleting everything", key);
+        cursor_close(cursor);
+    }
+    check_no_pinned_frames(pager);
+    close_database_file(pager);
+    printf("ok delete everything\n");
+}
+
+/**
+ * @brief This method checks a cursor that starts in the middle of the tree, between keys and past the end
+ */
+void test_cursor_bounds() {
+    Pager* pager = open_fresh_database();
+    for (uint32_t i = 0; i < 10000; i++) {
+        bt_upsert(pager, i * 10, i);
+    }
+    uint32_t key;
+    uint32_t value;
+    Cursor* cursor = cursor_open(pager, 12345);
+    CHECK(cursor_next(cursor, &key, &value) && key == 12350, "first key at or after 12345");
+    CHECK(cursor_prev(cursor, &key, &value) && key == 12350, "cursor_prev after cursor_next");
+    CHECK(cursor_prev(cursor, &key, &value) && key == 12340, "key before 12350");
+    cursor_close(cursor);
+
+    cursor = cursor_open(pager, 99991);
+    CHECK(!cursor_next(cursor, &key, &value), "key %u past the end", key);
+    CHECK(cursor_prev(cursor, &key, &value) && key == 99990, "last key");
+    cursor_close(cursor);
+    check_no_pinned_frames(pager);
+    close_database_file(pager);
+    printf("ok cursor bounds\n");
+}
+
+uint32_t bulk_load_next_key;
+
+int next_bulk_load_entry(void* context, uint32_t* key, uint32_t* value) {
+    uint32_t num_entries = *(uint32_t*)context;
+    if (bulk_load_next_key >= num_entries) {
+        return 0;
+    }
+    *key = bulk_load_next_key * 3;
+    *value = bulk_load_next_key;
+    bulk_load_next_key++;
+    return 1;
+}
+
+/**
+ * @brief This method bulk loads a tree and then deletes its largest keys one by one, which rebalances the nodes on
+ * the right edge of every level against their left siblings
+ * 
+ * @param num_entries 
+ * @param fill_factor 
+ * @param num_deletes 
+ */
+void check_bulk_load_right_edge(uint32_t num_entries, double fill_factor, uint32_t num_deletes) {
+    Pager* pager = open_fresh_database();
+    BulkLoadIterator iterator = {next_bulk_load_entry, &num_entries};
+    bulk_load_next_key = 0;
+    bulk_load(pager, &iterator, fill_factor);
+    uint32_t value;
+    for (uint32_t i = num_entries; i > num_entries - num_deletes; i--) {
+        CHECK(bt_delete(pager, (i - 1) * 3) == 1, "key %u of %u loaded at %.2f was not deleted", (i - 1) * 3,
+            num_entries, fill_factor);
+        CHECK(i == 1 || (bt_get(pager, (i - 2) * 3, &value) == 1 && value == i - 2),
+            "key %u is missing after deleting key %u", (i - 2) * 3, (i - 1) * 3);
+    }
+    uint32_t key;
+    uint32_t count = 0;
+    Cursor* cursor = cursor_open(pager, 0);
+    while (cursor_next(cursor, &key, &value)) {
+        CHECK(key == count * 3 && value == count, "entry %u is %u = %u", count, key, value);
+        count++;
+    }
+    cursor_close(cursor);
+    CHECK(count == num_entries - num_deletes, "scanned %u of %u entries", count, num_entries - num_deletes);
+    check_no_pinned_frames(pager);
+    close_database_file(pager);
+}
+
+void test_bulk_load() {
+    uint32_t num_entries = 200000;
+    Pager* pager = open_fresh_database();
+    BulkLoadIterator iterator = {next_bulk_load_entry, &num_entries};
+    bulk_load_next_key = 0;
+    uint32_t empty_root_page_num = pager->root_page_num;
+    bulk_load(pager, &iterator, 0.9);
+    CHECK(pager->root_page_num != empty_root_page_num && pager->free_list_head == empty_root_page_num,
+        "the empty root page %u was not freed", empty_root_page_num);
+    for (uint32_t i = 0; i < num_entries; i += 97) {
+        uint32_t value;
+        CHECK(bt_get(pager, i * 3, &value) == 1 && value == i, "bulk loaded key %u", i * 3);
+        CHECK(bt_get(pager, i * 3 + 1, &value) == -1, "key %u was never loaded", i * 3 + 1);
+    }
+    //  The loaded tree takes inserts like any other
+    for (uint32_t i = 0; i < 1000; i++) {
+        CHECK(bt_insert_if_absent(pager, i * 3 + 1, i) == 1, "insert %u into a bulk loaded tree", i * 3 + 1);
+    }
+    uint32_t key;
+    uint32_t value;
+    uint32_t count = 0;
+    Cursor* cursor = cursor_open(pager, 0);
+    while (cursor_next(cursor, &key, &value)) {
+        count++;
+    }
+    cursor_close(cursor);
+    CHECK(count == num_entries + 1000, "scanned %u entries", count);
+    close_database_file(pager);
+
+    //  Tiny nodes give every level a last node that starts a new parent on its own, for every way a load can end
+    for (uint32_t i = 1; i <= 120; i++) {
+        check_bulk_load_right_edge(i, 0.01, i);
+    }
+    //  Full nodes end with a parent that has no room for its last child
+    uint32_t num_full_entries = LEAF_NODE_MAX_CELLS * (INTERNAL_NODE_MAX_KEYS + 1) + 1;
+    check_bulk_load_right_edge(num_full_entries, 1, 3 * LEAF_NODE_MAX_CELLS);
+    printf("ok bulk load\n");
+}
+
+void test_multi_get() {
+    Pager* pager = open_fresh_database();
+    uint32_t values[4096];
+    uint8_t found[4096];
+    uint32_t keys[4096];
+    CHECK(bt_multi_get(pager, keys, 0, values, found) == 0, "lookup of no keys");
+    keys[0] = 5;
+    CHECK(bt_multi_get(pager, keys, 1, values, found) == 0 && !found[0], "lookup in an empty tree");
+
+    for (uint32_t i = 0; i < 50000; i++) {
+        bt_upsert(pager, i * 2, i + 1);
+    }
+    srand(11);
+    uint32_t expected_found = 0;
+    for (uint32_t i = 0; i < 4096; i++) {
+        //  Duplicates and missing keys are mixed in
+        keys[i] = i % 7 == 0 ? keys[i / 2] : (uint32_t)rand() % 100010;
+        expected_found += keys[i] % 2 == 0 && keys[i] < 100000;
+    }
+    CHECK(bt_multi_get(pager, keys, 4096, values, found) == expected_found, "number of keys found");
+    for (uint32_t i = 0; i < 4096; i++) {
+        uint32_t value;
+        int result = bt_get(pager, keys[i], &value);
+        CHECK(found[i] == (result == 1), "key %u found by one lookup but not the other", keys[i]);
+        CHECK(!found[i] || values[i] == value, "value of key %u", keys[i]);
+    }
+    close_database_file(pager);
+    printf("ok multi get\n");
+}
+
+typedef struct {
+    Pager* pager;
+    uint32_t num_keys;
+    volatile int* stop;
+    unsigned seed;
+    int failures;
+} ReaderContext;
+
+void* reader_main(void* argument) {
+    ReaderContext* context = argument;
+    while (!*context->stop) {
+        uint32_t key = (rand_r(&context->seed) % context->num_keys) * 2;
+        uint32_t value;
+        if (rand_r(&context->seed) % 8 == 0) {
+            //  The even keys never change, so a scan has to return all of them in a row
+            Cursor* cursor = cursor_open(context->pager, key);
+            uint32_t expected_key = key;
+            uint32_t found_key;
+            for (uint32_t i = 0; i < 200 && cursor_next(cursor, &found_key, &value); i++) {
+                if (found_key % 2 == 1) {
+                    continue;
+                }
+                context->failures += found_key != expected_key || value != found_key + 1;
+                expected_key = found_key + 2;
+            }
+            cursor_close(cursor);
+        } else {
+            context->failures += bt_get(context->pager, key, &value) != 1 || value != key + 1;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief This method runs lock-free readers of a fixed set of keys while a writer inserts and deletes other keys
+ * around them, splitting and merging the nodes the readers go through
+ */
+void test_concurrent_readers() {
+    const uint32_t num_keys = 20000;
+    const uint32_t num_readers = 3;
+    Pager* pager = open_fresh_database();
+    for (uint32_t i = 0; i < num_keys; i++) {
+        bt_upsert(pager, i * 2, i * 2 + 1);
+    }
+    volatile int stop = 0;
+    pthread_t threads[num_readers];
+    ReaderContext contexts[num_readers];
+    for (uint32_t i = 0; i < num_readers; i++) {
+        contexts[i] = (ReaderContext){pager, num_keys, &stop, i + 1, 0};
+        pthread_create(&threads[i], NULL, reader_main, &contexts[i]);
+    }
+    for (uint32_t round = 0; round < 3; round++) {
+        for (uint32_t i = 0; i < num_keys; i++) {
+            bt_upsert(pager, i * 2 + 1, i);
+        }
+        for (uint32_t i = 0; i < num_keys; i++) {
+            bt_delete(pager, i * 2 + 1);
+        }
+    }
+    stop = 1;
+    for (uint32_t i = 0; i < num_readers; i++) {
+        pthread_join(threads[i], NULL);
+        CHECK(contexts[i].failures == 0, "reader %u saw %d wrong results", i, contexts[i].failures);
+    }
+    close_database_file(pager);
+    printf("ok concurrent readers\n");
+}
+
+/**
+ * @brief This method kills a process that is writing with synchronous commits, and checks that every write it
+ * acknowledged survives the crash
+ */
+void test_recovery_after_crash() {
+    if (!options.wal_enabled) {
+        return;
+    }
+    open_fresh_database();
+    int pipe_descriptors[2];
+    CHECK(pipe(pipe_descriptors) == 0, "pipe");
+    pid_t child = fork();
+    CHECK(child != -1, "fork");
+    if (child == 0) {
+        close(pipe_descriptors[0]);
+        PagerOptions child_options = options;
+        child_options.synchronous_commit = 1;
+        Pager* pager = open_database_file_with_options(database_filename, &child_options);
+        for (uint32_t i = 0;; i++) {
+            uint32_t key = (i * 7919) % 100000;
+            bt_upsert(pager, key, i);
+            if (i % 3 == 2) {
+                bt_delete(pager, (key * 31) % 100000);
+            }
+            if (write(pipe_descriptors[1], &i, sizeof(i)) != sizeof(i)) {
+                _exit(EXIT_FAILURE);
+            }
+        }
+    }
+    close(pipe_descriptors[1]);
+    uint32_t acknowledged = 0;
+    uint32_t last_acknowledged = 0;
+    while (acknowledged < NUM_RECOVERY_ACKS && read(pipe_descriptors[0], &last_acknowledged, sizeof(uint32_t)) == sizeof(uint32_t)) {
+        acknowledged++;
+    }
+    CHECK(acknowledged == NUM_RECOVERY_ACKS, "the writer stopped after %u operations", acknowledged);
+    kill(child, SIGKILL);
+    waitpid(child, NULL, 0);
+    //  The writer may have acknowledged more operations than were read before it was killed
+    while (read(pipe_descriptors[0], &last_acknowledged, sizeof(uint32_t)) == sizeof(uint32_t)) {
+        acknowledged++;
+    }
+    close(pipe_descriptors[0]);
+
+    //  Replay the acknowledged operations on a model, the one after them may or may not have made it
+    int64_t* model = malloc(100000 * sizeof(int64_t));
+    for (uint32_t i = 0; i < 100000; i++) {
+        model[i] = -1;
+    }
+    for (uint32_t i = 0; i <= last_acknowledged; i++) {
+        uint32_t key = (i * 7919) % 100000;
+        model[key] = i;
+        if (i % 3 == 2) {
+            model[(key * 31) % 100000] = -1;
+        }
+    }
+    uint32_t next_key = ((last_acknowledged + 1) * 7919) % 100000;
+    uint32_t next_deleted_key = (last_acknowledged + 1) % 3 == 2 ? (next_key * 31) % 100000 : UINT32_MAX;
+
+    Pager* pager = open_database_file_with_options(database_filename, &options);
+    for (uint32_t key = 0; key < 100000; key++) {
+        if (key == next_key || key == next_deleted_key) {
+            continue;
+        }
+        uint32_t value;
+        int result = bt_get(pager, key, &value);
+        CHECK(result == (model[key] == -1 ? -1 : 1), "key %u after recovery", key);
+        CHECK(result != 1 || value == model[key], "value of key %u after recovery", key);
+    }
+    close_database_file(pager);
+    free(model);
+    printf("ok recovery after crash\n");
+}
+
+void test_stats() {
+    //  A few leaves' worth, so the leaves and the root split whatever the page size
+    const uint32_t num_keys = 4 * LEAF_NODE_MAX_CELLS;
+    Pager* pager = open_fresh_database();
+    reset_tree_stats(pager);
+    for (uint32_t i = 0; i < num_keys; i++) {
+        bt_upsert(pager, i, i);
+    }
+    uint32_t value;
+    for (uint32_t i = 0; i < 1000; i++) {
+        bt_get(pager, i, &value);
+    }
+    bt_delete(pager, 1);
+    TreeStats stats = get_tree_stats(pager);
+#if BTREE_STATS
+    CHECK(stats.operations[OPERATION_INSERT] == num_keys, "%lu inserts", stats.operations[OPERATION_INSERT]);
+    CHECK(stats.operations[OPERATION_GET] == 1000, "%lu gets", stats.operations[OPERATION_GET]);
+    CHECK(stats.operations[OPERATION_DELETE] == 1, "%lu deletes", stats.operations[OPERATION_DELETE]);
+    CHECK(stats.leaf_splits > 0 && stats.root_splits > 0, "no splits were counted");
+    CHECK(stats.node_visits > num_keys + 1001, "%lu node visits", stats.node_visits);
+    CHECK(stats.key_comparisons > stats.node_visits, "%lu key comparisons", stats.key_comparisons);
+#endif
+    reset_tree_stats(pager);
+    stats = get_tree_stats(pager);
+    CHECK(stats.operations[OPERATION_GET] == 0 && stats.node_visits == 0, "stats were not reset");
+    close_database_file(pager);
+    printf("ok stats\n");
+}
+
+/**
+ * @brief This method appends keys in order, which should fill the leaves instead of leaving them half empty, and
+ * then mixes in deletes of the largest key and inserts below it to check that appends still land in the right leaf
+ */
+void test_sorted_append() {
+    const uint32_t num_appends = 100000;
+    const uint32_t num_keys = 2 * num_appends + 1000;
+    Pager* pager = open_fresh_database();
+    reset_tree_stats(pager);
+    int64_t* model = malloc(num_keys * sizeof(int64_t));
+    for (uint32_t i = 0; i < num_keys; i++) {
+        model[i] = -1;
+    }
+    for (uint32_t i = 0; i < num_appends; i++) {
+        insert(pager, 2 * i, i);
+        model[2 * i] = i;
+    }
+    uint32_t num_leaves = (num_appends + LEAF_NODE_MAX_CELLS - 1) / LEAF_NODE_MAX_CELLS;
+    CHECK(pager->num_pages < num_leaves * 105 / 100 + 3, "%u pages for %u full leaves", pager->num_pages,
+        num_leaves);
+#if BTREE_STATS
+    TreeStats stats = get_tree_stats(pager);
+    CHECK(stats.fast_appends > num_appends * 9 / 10, "%lu of %u appends skipped the descent", stats.fast_appends,
+        num_appends);
+#endif
+
+    srand(21);
+    uint32_t next_key = 2 * num_appends;
+    for (uint32_t i = 0; i < 1000; i++) {
+        uint32_t choice = rand() % 3;
+        if (choice == 0) {
+            uint32_t key = 2 * (rand() % num_appends) + 1;
+            bt_upsert(pager, key, key);
+            model[key] = key;
+        } else if (choice == 1) {
+            next_key--;
+            while (model[next_key] == -1) {
+                next_key--;
+            }
+            bt_delete(pager, next_key);
+            model[next_key] = -1;
+        } else {
+            bt_insert_if_absent(pager, next_key, i);
+            model[next_key] = i;
+            next_key++;
+        }
+    }
+    check_scan_matches_model(pager, model, num_keys);
+    check_no_pinned_frames(pager);
+    close_database_file(pager);
+    free(model);
+    printf("ok sorted append\n");
+}
+
+/**
+ * @brief This method checks that a trace records every operation with its arguments, in order, including the ones
+ * written out when the trace buffer filled up
+ */
+void test_operation_trace() {
+    char trace_filename[300];
+    snprintf(trace_filename, sizeof(trace_filename), "%s.trace", database_filename);
+    options.operation_trace_filename = trace_filename;
+    Pager* pager = open_fresh_database();
+    options.operation_trace_filename = NULL;
+    const uint32_t num_upserts = 20000;
+    for (uint32_t i = 0; i < num_upserts; i++) {
+        bt_upsert(pager, i, i * 3);
+    }
+    uint32_t key;
+    uint32_t value;
+    insert(pager, num_upserts, 1);
+    bt_insert_if_absent(pager, 5, 2);
+    bt_get(pager, 7, &value);
+    bt_delete(pager, 9);
+    uint32_t keys[3] = {30, 10, 20};
+    uint32_t values[3];
+    uint8_t found[3];
+    bt_multi_get(pager, keys, 3, values, found);
+    Cursor* cursor = cursor_open(pager, 100);
+    for (uint32_t i = 0; i < 3; i++) {
+        cursor_next(cursor, &key, &value);
+    }
+    cursor_prev(cursor, &key, &value);
+    cursor_close(cursor);
+    //  Large enough to overflow whatever the page size
+    uint8_t value_bytes[20000] = {0};
+    uint32_t value_size;
+    bt_put_bytes(pager, "apple", 5, value_bytes, 3);
+    bt_put_bytes(pager, "banana", 6, value_bytes, sizeof(value_bytes));
+    bt_get_bytes(pager, "apple", 5, value_bytes, sizeof(value_bytes), &value_size);
+    bt_delete_bytes(pager, "apple", 5);
+    BytesCursor* bytes_cursor = bytes_cursor_open(pager, "b", 1);
+    const void* key_bytes;
+    uint32_t key_size;
+    bytes_cursor_next(bytes_cursor, &key_bytes, &key_size, NULL, 0, &value_size);
+    bytes_cursor_close(bytes_cursor);
+    close_database_file(pager);
+
+    OperationTraceReader* reader = operation_trace_reader_open(trace_filename);
+    TracedOperation operation;
+    uint64_t previous_time = 0;
+    for (uint32_t i = 0; i < num_upserts; i++) {
+        CHECK(operation_trace_read(reader, &operation), "the trace ends after %u upserts", i);
+        CHECK(operation.type == TRACED_UPSERT && operation.key == i && operation.value == i * 3,
+            "operation %u is %u(%u, %u)", i, operation.type, operation.key, operation.value);
+        CHECK(operation.time >= previous_time, "operation %u goes back in time", i);
+        previous_time = operation.time;
+    }
+    CHECK(operation_trace_read(reader, &operation) && operation.type == TRACED_INSERT &&
+        operation.key == num_upserts && operation.value == 1, "the insert was not traced");
+    CHECK(operation_trace_read(reader, &operation) && operation.type == TRACED_INSERT_IF_ABSENT &&
+        operation.key == 5 && operation.value == 2, "the insert if absent was not traced");
+    CHECK(operation_trace_read(reader, &operation) && operation.type == TRACED_GET && operation.key == 7,
+        "the get was not traced");
+    CHECK(operation_trace_read(reader, &operation) && operation.type == TRACED_DELETE && operation.key == 9,
+        "the delete was not traced");
+    CHECK(operation_trace_read(reader, &operation) && operation.type == TRACED_MULTI_GET &&
+        operation.num_keys == 3 && memcmp(operation.keys, keys, sizeof(keys)) == 0,
+        "the batch lookup was not traced");
+    CHECK(operation_trace_read(reader, &operation) && operation.type == TRACED_SCAN && operation.key == 100 &&
+        operation.num_next == 3 && operation.num_prev == 1, "the scan was not traced");
+    CHECK(operation_trace_read(reader, &operation) && operation.type == TRACED_PUT_BYTES &&
+        operation.key_size == 5 && memcmp(operation.key_bytes, "apple", 5) == 0 && operation.value_size == 3,
+        "the byte tree put was not traced");
+    CHECK(operation_trace_read(reader, &operation) && operation.type == TRACED_PUT_BYTES &&
+        operation.key_size == 6 && memcmp(operation.key_bytes, "banana", 6) == 0 &&
+        operation.value_size == sizeof(value_bytes),
+        "the byte tree put of an overflowing value was not traced");
+    CHECK(operation_trace_read(reader, &operation) && operation.type == TRACED_GET_BYTES &&
+        operation.key_size == 5 && memcmp(operation.key_bytes, "apple", 5) == 0, "the byte tree get was not traced");
+    CHECK(operation_trace_read(reader, &operation) && operation.type == TRACED_DELETE_BYTES &&
+        operation.key_size == 5 && memcmp(operation.key_bytes, "apple", 5) == 0,
+        "the byte tree delete was not traced");
+    CHECK(operation_trace_read(reader, &operation) && operation.type == TRACED_SCAN_BYTES &&
+        operation.key_size == 1 && memcmp(operation.key_bytes, "b", 1) == 0 && operation.num_next == 1,
+        "the byte tree scan was not traced");
+    CHECK(!operation_trace_read(reader, &operation), "the trace has operations that did not happen");
+    operation_trace_reader_close(reader);
+    unlink(trace_filename);
+    printf("ok operation trace\n");
+}
+
+/**
+ * @brief This method builds the key of entry i of the byte tree model, which is between 5 and 55 bytes long
+ */
+uint32_t make_bytes_key(uint32_t i, char* key) {
+    return sprintf(key, "key-%0*u", 1 + i % 51, i);
+}
+
+void fill_bytes_value(uint32_t seed, uint32_t size, uint8_t* value) {
+    for (uint32_t j = 0; j < size; j++) {
+        value[j] = (uint8_t)(seed * 31 + j);
+    }
+}
+
+/**
+ * @brief This method checks every entry of the byte tree model with a lookup, and a full scan for the order of
+ * the keys
+ *
+ * @param pager
+ * @param value_sizes The size of the value of every entry, or -1 for an entry that is not in the tree
+ * @param value_seeds
+ * @param num_entries
+ */
+void check_bytes_match_model(Pager* pager, const int64_t* value_sizes, const uint32_t* value_seeds,
+    uint32_t num_entries) {
+    char key[64];
+    uint8_t* value = malloc(8192);
+    uint8_t* expected_value = malloc(8192);
+    uint32_t value_size;
+    uint32_t num_live = 0;
+    for (uint32_t i = 0; i < num_entries; i++) {
+        uint32_t key_size = make_bytes_key(i, key);
+        int result = bt_get_bytes(pager, key, key_size, value, 8192, &value_size);
+        if (value_sizes[i] == -1) {
+            CHECK(result == -1, "byte key %s was found after it was deleted", key);
+            continue;
+        }
+        num_live++;
+        CHECK(result == 1 && value_size == value_sizes[i], "byte key %s has a value of %u bytes, expected %ld", key,
+            value_size, (long)value_sizes[i]);
+        fill_bytes_value(value_seeds[i], value_size, expected_value);
+        CHECK(memcmp(value, expected_value, value_size) == 0, "byte key %s has the wrong value", key);
+        CHECK(bt_get_bytes(pager, key, key_size, NULL, 0, &value_size) == 1 && value_size == value_sizes[i],
+            "byte key %s has the wrong value size", key);
+    }
+
+    char previous_key[64] = "";
+    uint32_t previous_key_size = 0;
+    const void* scan_key;
+    uint32_t scan_key_size;
+    uint32_t num_scanned = 0;
+    BytesCursor* cursor = bytes_cursor_open(pager, "", 0);
+    while (bytes_cursor_next(cursor, &scan_key, &scan_key_size, value, 8192, &value_size)) {
+        CHECK(num_scanned == 0 || compare_bytes(previous_key, previous_key_size, scan_key, scan_key_size) < 0,
+            "byte scan is out of order after %.*s", (int)previous_key_size, previous_key);
+        memcpy(previous_key, scan_key, scan_key_size);
+        previous_key[scan_key_size] = '\0';
+        previous_key_size = scan_key_size;
+        uint32_t i;
+        CHECK(sscanf(previous_key, "key-%u", &i) == 1 && i < num_entries && value_sizes[i] == value_size,
+            "byte scan returned %s", previous_key);
+        num_scanned++;
+    }
+    bytes_cursor_close(cursor);
+    CHECK(num_scanned == num_live, "byte scan returned %u entries, expected %u", num_scanned, num_live);
+    free(value);
+    free(expected_value);
+}
+
+/**
+ * @brief This method puts and deletes byte string keys with values of every size, some of them on overflow pages,
+ * against a model, checks the tree again after reopening the file and then deletes every key
+ */
+void test_bytes_operations_match_model() {
+    const uint32_t num_entries = 3000;
+    Pager* pager = open_fresh_database();
+    int64_t* value_sizes = malloc(num_entries * sizeof(int64_t));
+    uint32_t* value_seeds = malloc(num_entries * sizeof(uint32_t));
+    uint8_t* value = malloc(8192);
+    char key[64];
+    for (uint32_t i = 0; i < num_entries; i++) {
+        value_sizes[i] = -1;
+    }
+    CHECK(bt_delete_bytes(pager, "missing", 7) == -1, "deleted a key from an empty byte tree");
+
+    srand(22);
+    for (uint32_t round = 0; round < 4 * num_entries; round++) {
+        uint32_t i = rand() % num_entries;
+        uint32_t key_size = make_bytes_key(i, key);
+        if (rand() % 4 == 0) {
+            int result = bt_delete_bytes(pager, key, key_size);
+            CHECK(result == (value_sizes[i] == -1 ? -1 : 1), "delete of byte key %s returned %d", key, result);
+            value_sizes[i] = -1;
+            continue;
+        }
+        //  Mostly small values, and every tenth one spills onto overflow pages
+        uint32_t value_size = rand() % 10 == 0 ? 600 + rand() % 5000 : rand() % 200;
+        fill_bytes_value(round, value_size, value);
+        int result = bt_put_bytes(pager, key, key_size, value, value_size);
+        CHECK(result == (value_sizes[i] == -1), "put of byte key %s returned %d", key, result);
+        value_sizes[i] = value_size;
+        value_seeds[i] = round;
+    }
+    check_bytes_match_model(pager, value_sizes, value_seeds, num_entries);
+    check_no_pinned_frames(pager);
+    close_database_file(pager);
+
+    pager = open_database_file_with_options(database_filename, &options);
+    check_bytes_match_model(pager, value_sizes, value_seeds, num_entries);
+    uint32_t num_pages = pager->num_pages;
+    for (uint32_t i = 0; i < num_entries; i++) {
+        uint32_t key_size = make_bytes_key(i, key);
+        if (value_sizes[i] != -1) {
+            CHECK(bt_delete_bytes(pager, key, key_size) == 1, "byte key %s could not be deleted", key);
+            value_sizes[i] = -1;
+        }
+    }
+    check_bytes_match_model(pager, value_sizes, value_seeds, num_entries);
+
+    //  Every page of the byte tree went back to the free list, so filling it again does not grow the file
+    for (uint32_t i = 0; i < num_entries / 2; i++) {
+        uint32_t key_size = make_bytes_key(i, key);
+        fill_bytes_value(i, 100, value);
+        bt_put_bytes(pager, key, key_size, value, 100);
+        value_sizes[i] = 100;
+        value_seeds[i] = i;
+    }
+    check_bytes_match_model(pager, value_sizes, value_seeds, num_entries);
+    CHECK(pager->num_pages == num_pages, "the file grew from %u to %u pages", num_pages, pager->num_pages);
+    check_no_pinned_frames(pager);
+    close_database_file(pager);
+    free(value_sizes);
+    free(value_seeds);
+    free(value);
+    printf("ok bytes operations\n");
+}
+
+/**
+ * @brief This method puts values that span many more overflow pages than the buffer pool has frames, replaces and
+ * deletes them, and checks that their pages are reused
+ */
+void test_bytes_large_values() {
+    const uint32_t value_size = 4 << 20;
+    Pager* pager = open_fresh_database();
+    uint8_t* value = malloc(value_size);
+    uint8_t* expected = malloc(value_size);
+    uint32_t found_size;
+    fill_bytes_value(1, value_size, expected);
+    CHECK(bt_put_bytes(pager, "large", 5, expected, value_size) == 1, "the large value was not inserted");
+    CHECK(bt_get_bytes(pager, "large", 5, value, value_size, &found_size) == 1 && found_size == value_size &&
+        memcmp(value, expected, value_size) == 0, "the large value did not read back");
+    uint32_t num_pages = pager->num_pages;
+
+    //  The old chain is freed after the new one is written, so the file grows by one value and then stays
+    fill_bytes_value(2, value_size, expected);
+    CHECK(bt_put_bytes(pager, "large", 5, expected, value_size) == 0, "the large value was not replaced");
+    fill_bytes_value(3, value_size, expected);
+    CHECK(bt_put_bytes(pager, "large", 5, expected, value_size) == 0, "the large value was not replaced");
+    CHECK(bt_get_bytes(pager, "large", 5, value, value_size, &found_size) == 1 && found_size == value_size &&
+        memcmp(value, expected, value_size) == 0, "the replaced value did not read back");
+    CHECK(pager->num_pages < 2 * num_pages, "the file grew from %u to %u pages", num_pages, pager->num_pages);
+    check_no_pinned_frames(pager);
+    close_database_file(pager);
+
+    pager = open_database_file_with_options(database_filename, &options);
+    CHECK(bt_get_bytes(pager, "large", 5, value, value_size, &found_size) == 1 && found_size == value_size &&
+        memcmp(value, expected, value_size) == 0, "the large value did not survive reopening");
+    num_pages = pager->num_pages;
+    CHECK(bt_delete_bytes(pager, "large", 5) == 1, "the large value was not deleted");
+    CHECK(bt_put_bytes(pager, "large", 5, expected, value_size) == 1, "the large value was not inserted again");
+    CHECK(pager->num_pages == num_pages, "the file grew from %u to %u pages", num_pages, pager->num_pages);
+    check_no_pinned_frames(pager);
+    close_database_file(pager);
+    free(value);
+    free(expected);
+    printf("ok bytes large values\n");
+}
+
+/**
+ * @brief This method kills a process right after it wrote the overflow chain of a value, before the value was put
+ * into its leaf, and checks that recovery gives the pages of the chain back
+ */
+void test_bytes_recovery_after_crash() {
+    if (!options.wal_enabled) {
+        return;
+    }
+    const uint32_t value_size = 256 << 10;
+    uint8_t* value = malloc(value_size);
+    uint8_t* expected = malloc(value_size);
+    fill_bytes_value(1, value_size, expected);
+    Pager* pager = open_fresh_database();
+    CHECK(bt_put_bytes(pager, "large", 5, expected, value_size) == 1, "the large value was not inserted");
+    close_database_file(pager);
+    pid_t child = fork();
+    CHECK(child != -1, "fork");
+    if (child == 0) {
+        PagerOptions child_options = options;
+        child_options.synchronous_commit = 1;
+        pager = open_database_file_with_options(database_filename, &child_options);
+        pthread_mutex_lock(&pager->overflow_mutex);
+        bytes_write_overflow_chain(pager, expected, value_size);
+        pthread_mutex_unlock(&pager->overflow_mutex);
+        //  Waiting for the commit of any later operation makes the chain durable
+        bt_upsert(pager, 1, 1);
+        kill(getpid(), SIGKILL);
+    }
+    waitpid(child, NULL, 0);
+
+    pager = open_database_file_with_options(database_filename, &options);
+    CHECK(pager->unlinked_overflow_page_num == INVALID_PAGE_NUM, "the unlinked chain was not freed");
+    uint32_t found_size;
+    CHECK(bt_get_bytes(pager, "large", 5, value, value_size, &found_size) == 1 && found_size == value_size &&
+        memcmp(value, expected, value_size) == 0, "the large value did not survive the crash");
+    //  The freed chain is as long as the new value, so replacing it fits in the file
+    uint32_t num_pages = pager->num_pages;
+    fill_bytes_value(2, value_size, expected);
+    CHECK(bt_put_bytes(pager, "large", 5, expected, value_size) == 0, "the large value was not replaced");
+    CHECK(pager->num_pages == num_pages, "the file grew from %u to %u pages", num_pages, pager->num_pages);
+    check_no_pinned_frames(pager);
+    close_database_file(pager);
+    free(value);
+    free(expected);
+    printf("ok bytes recovery after crash\n");
+}
+
+int compare_bytes_reversed(const void* a, uint32_t a_size, const void* b, uint32_t b_size) {
+    return compare_bytes(b, b_size, a, a_size);
+}
+
+/**
+ * @brief This method checks that a byte tree whose keys share long prefixes takes fewer pages than its keys would
+ * fill without prefix compression, and that a tree with another comparator keeps its order
+ */
+void test_bytes_prefix_compression() {
+    const uint32_t num_tenants = 20;
+    const uint32_t num_timestamps = 2000;
+    const uint32_t value_size = 8;
+    Pager* pager = open_fresh_database();
+    char key[64];
+    uint8_t value[8] = { 0 };
+    uint32_t key_size = 0;
+    for (uint32_t t = 0; t < num_timestamps; t++) {
+        for (uint32_t tenant = 0; tenant < num_tenants; tenant++) {
+            key_size = sprintf(key, "tenant-%06u|%012u", tenant, 1700000000u + 7 * t);
+            memcpy(value, &t, sizeof(t));
+            bt_put_bytes(pager, key, key_size, value, value_size);
+        }
+    }
+    //  Without a prefix a leaf cell takes its header, key, value and offset
+    uint32_t uncompressed_pages = num_tenants * num_timestamps * (6 + key_size + value_size + 2) / 4096;
+    CHECK(pager->num_pages < uncompressed_pages, "%u pages, more than %u full pages of uncompressed cells",
+        pager->num_pages, uncompressed_pages);
+
+    const void* scan_key;
+    uint32_t scan_key_size;
+    uint32_t scan_value_size;
+    uint32_t num_scanned = 0;
+    BytesCursor* cursor = bytes_cursor_open(pager, "tenant-000007|", 14);
+    while (bytes_cursor_next(cursor, &scan_key, &scan_key_size, value, value_size, &scan_value_size) &&
+        num_scanned < num_timestamps) {
+        uint32_t t;
+        memcpy(&t, value, sizeof(t));
+        key_size = sprintf(key, "tenant-%06u|%012u", 7, 1700000000u + 7 * num_scanned);
+        CHECK(scan_key_size == key_size && memcmp(scan_key, key, key_size) == 0 && t == num_scanned,
+            "scan of tenant 7 returned %.*s at %u", (int)scan_key_size, (const char*)scan_key, num_scanned);
+        num_scanned++;
+    }
+    bytes_cursor_close(cursor);
+    CHECK(num_scanned == num_timestamps, "scan of tenant 7 returned %u keys", num_scanned);
+    check_no_pinned_frames(pager);
+    close_database_file(pager);
+
+    options.key_comparator = compare_bytes_reversed;
+    pager = open_fresh_database();
+    for (uint32_t i = 0; i < 5000; i++) {
+        key_size = sprintf(key, "tenant-%06u|%u", i % 7, i);
+        bt_put_bytes(pager, key, key_size, value, value_size);
+    }
+    char previous_key[64];
+    uint32_t previous_key_size = 0;
+    num_scanned = 0;
+    cursor = bytes_cursor_open(pager, "\xff", 1);
+    while (bytes_cursor_next(cursor, &scan_key, &scan_key_size, NULL, 0, &scan_value_size)) {
+        CHECK(num_scanned == 0 || compare_bytes(scan_key, scan_key_size, previous_key, previous_key_size) < 0,
+            "reversed scan returned %.*s after %.*s", (int)scan_key_size, (const char*)scan_key,
+            (int)previous_key_size, previous_key);
+        memcpy(previous_key, scan_key, scan_key_size);
+        previous_key_size = scan_key_size;
+        num_scanned++;
+    }
+    bytes_cursor_close(cursor);
+    CHECK(num_scanned == 5000, "reversed scan returned %u keys", num_scanned);
+    close_database_file(pager);
+    options.key_comparator = NULL;
+    printf("ok bytes prefix compression\n");
+}
+
+/**
+ * @brief This method checks that a scan and lookups of a snapshot return exactly the keys of a model
+ *
+ * @param snapshot
+ * @param model The value of every key, or -1 for a key that is not in the snapshot
+ * @param num_keys
+ * @return uint32_t The number of mismatches
+ */
+uint32_t check_snapshot_matches_model(Snapshot* snapshot, const int64_t* model, uint32_t num_keys) {
+    uint32_t failures = 0;
+    uint32_t expected_key = 0;
+    uint32_t key;
+    uint32_t value;
+    SnapshotCursor* cursor = snapshot_cursor_open(snapshot, 0);
+    while (snapshot_cursor_next(cursor, &key, &value)) {
+        while (expected_key < num_keys && model[expected_key] == -1) {
+            expected_key++;
+        }
+        failures += key != expected_key || value != model[key];
+        expected_key = key + 1;
+    }
+    snapshot_cursor_close(cursor);
+    while (expected_key < num_keys && model[expected_key] == -1) {
+        expected_key++;
+    }
+    failures += expected_key != num_keys;
+    for (uint32_t i = 0; i < num_keys; i += 7) {
+        int found = snapshot_get(snapshot, i, &value) == 1;
+        failures += found != (model[i] != -1) || (found && value != model[i]);
+    }
+    return failures;
+}
+
+typedef struct {
+    Snapshot* snapshot;
+    const int64_t* model;
+    uint32_t num_keys;
+    volatile int* stop;
+    uint32_t failures;
+    uint32_t num_scans;
+} SnapshotReaderContext;
+
+void* snapshot_reader_main(void* argument) {
+    SnapshotReaderContext* context = argument;
+    while (!*context->stop || context->num_scans == 0) {
+        context->failures += check_snapshot_matches_model(context->snapshot, context->model, context->num_keys);
+        context->num_scans++;
+    }
+    return NULL;
+}
+
+/**
+ * @brief This method scans a snapshot over and over while a writer reshapes the tree under it, and checks that
+ * the snapshot keeps returning the tree it was opened on and that its page versions are freed when it closes
+ */
+void test_snapshots() {
+    const uint32_t num_keys = 20000;
+    Pager* pager = open_fresh_database();
+    int64_t* model = malloc(2 * num_keys * sizeof(int64_t));
+    for (uint32_t i = 0; i < 2 * num_keys; i++) {
+        model[i] = i < num_keys ? (int64_t)i : -1;
+    }
+    for (uint32_t i = 0; i < num_keys; i++) {
+        bt_upsert(pager, i, i);
+    }
+    reset_tree_stats(pager);
+    Snapshot* first_snapshot = snapshot_open(pager);
+
+    volatile int stop = 0;
+    SnapshotReaderContext context = {first_snapshot, model, 2 * num_keys, &stop, 0, 0};
+    pthread_t thread;
+    pthread_create(&thread, NULL, snapshot_reader_main, &context);
+    for (uint32_t i = 0; i < num_keys; i += 2) {
+        bt_delete(pager, i);
+    }
+    for (uint32_t i = num_keys; i < 2 * num_keys; i++) {
+        bt_upsert(pager, i, i + 1);
+    }
+
+    int64_t* second_model = malloc(2 * num_keys * sizeof(int64_t));
+    for (uint32_t i = 0; i < 2 * num_keys; i++) {
+        second_model[i] = i >= num_keys ? (int64_t)i + 1 : i % 2 == 1 ? (int64_t)i : -1;
+    }
+    Snapshot* second_snapshot = snapshot_open(pager);
+    for (uint32_t i = 0; i < 2 * num_keys; i++) {
+        if (i % 3 == 0) {
+            bt_delete(pager, i);
+        } else {
+            bt_upsert(pager, i, 7);
+        }
+    }
+    stop = 1;
+    pthread_join(thread, NULL);
+    CHECK(context.failures == 0, "the first snapshot returned %u wrong results in %u scans", context.failures,
+        context.num_scans);
+    CHECK(check_snapshot_matches_model(first_snapshot, model, 2 * num_keys) == 0, "the first snapshot changed");
+    CHECK(check_snapshot_matches_model(second_snapshot, second_model, 2 * num_keys) == 0, "the second snapshot changed");
+
+    TreeStats stats = get_tree_stats(pager);
+    CHECK(stats.page_versions > 0 && pager->num_page_versions > 0, "no page versions were saved");
+    snapshot_close(first_snapshot);
+    CHECK(pager->num_page_versions > 0, "the versions of the second snapshot were freed");
+    CHECK(check_snapshot_matches_model(second_snapshot, second_model, 2 * num_keys) == 0,
+        "the second snapshot changed when the first one closed");
+    snapshot_close(second_snapshot);
+    CHECK(pager->num_page_versions == 0, "%u page versions were not freed", pager->num_page_versions);
+
+    //  Without open snapshots writers do not save versions
+    bt_upsert(pager, 1, 1);
+    CHECK(pager->num_page_versions == 0, "a write saved a version without a snapshot");
+    check_no_pinned_frames(pager);
+    close_database_file(pager);
+    free(model);
+    free(second_model);
+    printf("ok snapshots\n");
+}
+
+/**
+ * @brief This method looks up a few hot keys over and over with the adaptive hash index on, and checks that they
+ * end up bypassing the descent, and that splits, merges and deletes under them never return a stale value
+ */
+void test_hash_index() {
+    const uint32_t num_keys = 20000;
+    const uint32_t num_hot_keys = 64;
+    options.hash_index_size = 64 << 10;
+    Pager* pager = open_fresh_database();
+    CHECK(pager->hash_index != NULL && (pager->hash_index_mask + 1) * sizeof(HashIndexEntry) <= options.hash_index_size,
+        "the hash index does not fit in %lu bytes", (unsigned long)options.hash_index_size);
+    for (uint32_t i = 0; i < num_keys; i++) {
+        bt_upsert(pager, i * 4, i);
+    }
+    reset_tree_stats(pager);
+    uint32_t value;
+    for (uint32_t round = 0; round < 100; round++) {
+        for (uint32_t i = 0; i < num_hot_keys; i++) {
+            uint32_t key = i * 301 % num_keys;
+            CHECK(bt_get(pager, key * 4, &value) == 1 && value == key, "hot key %u returned %u", key * 4, value);
+        }
+    }
+    TreeStats stats = get_tree_stats(pager);
+    CHECK(stats.hash_index_hits + stats.hash_index_misses == 100 * num_hot_keys, "%lu lookups went through the index",
+        stats.hash_index_hits + stats.hash_index_misses);
+    CHECK(stats.hash_index_hits > 80 * num_hot_keys, "only %lu of %u lookups hit the index", stats.hash_index_hits,
+        100 * num_hot_keys);
+
+    //  Fill the gaps to split the leaves of the hot keys, then delete around them to merge them, and change the
+    //  values of the hot keys on the way
+    for (uint32_t step = 1; step < 4; step++) {
+        for (uint32_t i = 0; i < num_keys; i++) {
+            bt_upsert(pager, i * 4 + step, i);
+        }
+        for (uint32_t i = 0; i < num_hot_keys; i++) {
+            uint32_t key = i * 301 % num_keys;
+            bt_upsert(pager, key * 4, key + step);
+            CHECK(bt_get(pager, key * 4, &value) == 1 && value == key + step, "hot key %u returned %u after splits",
+                key * 4, value);
+        }
+    }
+    for (uint32_t i = 0; i < 4 * num_keys; i++) {
+        if (i % 4 != 0 || (i / 4) % 2 == 1) {
+            bt_delete(pager, i);
+        }
+    }
+    for (uint32_t i = 0; i < num_hot_keys; i++) {
+        uint32_t key = i * 301 % num_keys;
+        int expected = key % 2 == 0;
+        CHECK(bt_get(pager, key * 4, &value) == (expected ? 1 : -1) && (!expected || value == key + 3),
+            "hot key %u returned %u after merges", key * 4, value);
+    }
+    for (uint32_t i = 0; i < num_keys; i += 2) {
+        bt_delete(pager, i * 4);
+    }
+    for (uint32_t i = 0; i < num_hot_keys; i++) {
+        CHECK(bt_get(pager, i * 301 % num_keys * 4, &value) == -1, "deleted hot key %u was found",
+            i * 301 % num_keys * 4);
+    }
+    close_database_file(pager);
+    options.hash_index_size = 0;
+    printf("ok hash index\n");
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s pool|swizzle|mmap|no-wal\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    configure_pager(argv[1]);
+    test_operations_match_model();
+    test_delete_everything();
+    test_cursor_bounds();
+    test_bulk_load();
+    test_multi_get();
+    test_concurrent_readers();
+    test_recovery_after_crash();
+    test_stats();
+    test_sorted_append();
+    test_operation_trace();
+    test_bytes_operations_match_model();
+    test_bytes_large_values();
+    test_bytes_recovery_after_crash();
+    test_bytes_prefix_compression();
+    test_snapshots();
+    test_hash_index();
+    return 0;
+}